@@ -0,0 +1,173 @@
+// Measures the cost of going through libmegado's public API, compared to the
+// frames it drives.
+//
+// Usage: abi-bench ROM [FRAMES]
+//
+// The accessors hand out pointers into the instance: their cost must not grow
+// with the size of what they give access to. A copy of the same data is timed
+// as a reference.
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "megado/megado.h"
+
+#define DEFAULT_FRAMES 600
+#define CALLS 1000000
+
+typedef struct Timing
+{
+    double min, max, total;
+    int count;
+} Timing;
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static void timing_add(Timing* t, double start)
+{
+    double time = now() - start;
+
+    if (t->count == 0 || time < t->min)
+        t->min = time;
+    if (time > t->max)
+        t->max = time;
+
+    t->total += time;
+    ++t->count;
+}
+
+static void timing_print(const char* name, Timing* t)
+{
+    printf("%-28s avg %8.1fus  min %8.1fus  max %8.1fus\n",
+        name, t->total / t->count * 1e6, t->min * 1e6, t->max * 1e6);
+}
+
+// Per-call cost of a function too short to be timed alone
+static void calls_print(const char* name, double start, int calls)
+{
+    printf("%-28s %8.1fns per call\n", name, (now() - start) / calls * 1e9);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: abi-bench ROM [FRAMES]\n");
+        return 1;
+    }
+
+    int frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+
+    printf("libmegado ABI version %u\n", megado_abi_version());
+
+    if (megado_create(MEGADO_ABI_VERSION + 1) != NULL)
+    {
+        printf("A mismatching ABI version was accepted\n");
+        return 1;
+    }
+
+    Megado* m = megado_create(MEGADO_ABI_VERSION);
+    if (m == NULL || !megado_load_rom(m, argv[1]))
+        return 1;
+
+    // Frames, pressing Start now and then to get past the title screens
+    Timing frame = { 0 };
+    uint32_t samples = 0;
+    for (int i = 0; i < frames; ++i)
+    {
+        megado_set_input(m, 0, i % 60 < 5 ? MEGADO_BUTTON_START : 0);
+
+        double start = now();
+        if (!megado_run_frame(m))
+        {
+            printf("The emulation stopped at frame %d\n", i);
+            return 1;
+        }
+        timing_add(&frame, start);
+
+        uint32_t count;
+        megado_audio(m, &count, NULL);
+        samples += count;
+    }
+
+    uint32_t width, height, pitch, ram_size, vram_size, sample_rate;
+    const uint8_t* pixels = megado_framebuffer(m, &width, &height, &pitch);
+    const uint8_t* ram = megado_work_ram(m, &ram_size);
+    const uint8_t* vram = megado_vram(m, &vram_size);
+    megado_audio(m, NULL, &sample_rate);
+
+    printf("%d frames, %ux%u, %u samples at %uHz\n\n", frames, width, height, samples, sample_rate);
+    timing_print("Run frame", &frame);
+
+    // State
+    Timing snapshot = { 0 }, restore = { 0 };
+    MegadoSnapshot* s = megado_snapshot(m);
+    for (int i = 0; i < 500; ++i)
+    {
+        double start = now();
+        MegadoSnapshot* t = megado_snapshot(m);
+        timing_add(&snapshot, start);
+        megado_snapshot_free(t);
+
+        start = now();
+        megado_restore(m, s);
+        timing_add(&restore, start);
+    }
+    megado_snapshot_free(s);
+
+    timing_print("Snapshot", &snapshot);
+    timing_print("Restore", &restore);
+    printf("\n");
+
+    // Accessors, against copies of what they give access to. The checksum
+    // keeps the compiler from dropping the loops
+    uint32_t checksum = 0;
+    double start = now();
+    for (int i = 0; i < CALLS; ++i)
+        checksum += megado_framebuffer(m, &width, &height, &pitch)[i & 0xff];
+    calls_print("Framebuffer", start, CALLS);
+
+    start = now();
+    for (int i = 0; i < CALLS; ++i)
+        checksum += megado_work_ram(m, &ram_size)[i & 0xffff];
+    calls_print("Work RAM", start, CALLS);
+
+    start = now();
+    for (int i = 0; i < CALLS; ++i)
+        checksum += megado_vram(m, &vram_size)[i & 0xffff];
+    calls_print("VRAM", start, CALLS);
+
+    start = now();
+    for (int i = 0; i < CALLS; ++i)
+        checksum += megado_audio(m, &samples, NULL)[0];
+    calls_print("Audio", start, CALLS);
+
+    start = now();
+    for (int i = 0; i < CALLS; ++i)
+        megado_set_input(m, 1, i & 0xff);
+    calls_print("Set input", start, CALLS);
+
+    uint8_t* copy = malloc(pitch * height + ram_size + vram_size);
+    int copies = CALLS / 100;
+    start = now();
+    for (int i = 0; i < copies; ++i)
+    {
+        memcpy(copy, pixels, pitch * height);
+        memcpy(copy + pitch * height, ram, ram_size);
+        memcpy(copy + pitch * height + ram_size, vram, vram_size);
+        checksum += copy[i & 0xff];
+    }
+    calls_print("Copy (reference)", start, copies);
+    free(copy);
+
+    printf("\nChecksum %08x\n", checksum);
+
+    megado_destroy(m);
+
+    return 0;
+}
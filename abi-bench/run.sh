@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch abi-bench (see ../tools.sh)
+
+exec ../tools.sh abi-bench 'ROM [FRAMES]' "$@"
@@ -0,0 +1,100 @@
+// Measures the throughput of batched stepping across thread counts.
+//
+// Usage: batch-bench ROM [INSTANCES] [STEPS] [FRAMESKIP]
+//
+// Every run gets the same random actions, so the observations must be the same
+// whatever the number of threads.
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "megado/genesis_batch.h"
+#include "megado/m68k/m68k.h"
+#include "megado/serializer.h"
+
+#define DEFAULT_INSTANCES 32
+#define DEFAULT_STEPS 100
+#define DEFAULT_FRAMESKIP 4
+
+typedef struct Result
+{
+    double frames_per_second;
+    uint32_t checksum; // Of all the observations
+} Result;
+
+static Result bench(const char* rom, int instances, int steps, int frameskip, int threads, BatchObservationModes mode)
+{
+    GenesisBatch* b = genesis_batch_make(rom, instances, frameskip, threads);
+
+    size_t observation_size = genesis_batch_observation_size(mode);
+    uint8_t* actions = calloc(instances * GENESIS_BATCH_BUTTONS, sizeof(uint8_t));
+    uint8_t* observations = calloc(instances, observation_size);
+
+    srand(1);
+
+    Result result = { 0, 0 };
+    double time = 0;
+
+    for (int step = 0; step < steps; ++step)
+    {
+        for (int i = 0; i < instances * GENESIS_BATCH_BUTTONS; ++i)
+            actions[i] = rand() % 4 == 0;
+
+        genesis_batch_step(b, actions, observations, mode);
+        time += b->step_time;
+
+        result.checksum = checksum(observations, instances * observation_size) ^ (result.checksum * 31);
+    }
+
+    result.frames_per_second = (double)instances * steps * frameskip / time;
+
+    free(observations);
+    free(actions);
+    genesis_batch_free(b);
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: batch-bench ROM [INSTANCES] [STEPS] [FRAMESKIP]\n");
+        return 1;
+    }
+
+    const char* rom = argv[1];
+    int instances = argc > 2 ? atoi(argv[2]) : DEFAULT_INSTANCES;
+    int steps = argc > 3 ? atoi(argv[3]) : DEFAULT_STEPS;
+    int frameskip = argc > 4 ? atoi(argv[4]) : DEFAULT_FRAMESKIP;
+
+    m68k_generate_opcode_table();
+
+    int cores = SDL_GetCPUCount();
+    bool ok = true;
+
+    for (int mode = BatchObservation_RGB; mode <= BatchObservation_Indexed; ++mode)
+    {
+        printf("\n%d instances, %d steps of %d frames, %s observations (%zu bytes)\n", instances, steps, frameskip,
+            mode == BatchObservation_RGB ? "RGB" : "indexed", genesis_batch_observation_size(mode));
+
+        Result reference = { 0, 0 };
+        for (int threads = 1; threads <= cores * 2; threads *= 2)
+        {
+            Result result = bench(rom, instances, steps, frameskip, threads, mode);
+            if (threads == 1)
+                reference = result;
+
+            bool same = result.checksum == reference.checksum;
+            ok = ok && same;
+
+            printf("%3d threads: %9.1f frames/s  x%.2f  %s\n", threads, result.frames_per_second,
+                result.frames_per_second / reference.frames_per_second, same ? "" : "(observations differ!)");
+        }
+    }
+
+    m68k_free_opcode_table();
+
+    return ok ? 0 : 1;
+}
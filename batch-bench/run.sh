@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch batch-bench (see ../tools.sh)
+
+exec ../tools.sh batch-bench 'ROM [INSTANCES] [STEPS] [FRAMESKIP]' "$@"
@@ -0,0 +1,555 @@
+// Runs a corpus of ROMs headless, in parallel, and reports how fast each runs.
+//
+// Usage: corpus-bench [-j JOBS] [-n FRAMES] [-p FRAMES] [-b BASELINE] [-t PERCENT] [-o REPORT]... ROM|FOLDER...
+//
+// Each ROM runs for FRAMES frames (default 600) in its own process, JOBS at a
+// time (one per core by default): a game that crashes the emulator does not
+// stop the others, and the peak memory of each is known. The report has the
+// frames and M68k instructions per second, the peak RSS and the time spent in
+// each subsystem. It is written as JSON or CSV, depending on the extension of
+// REPORT (several can be given).
+//
+// Profiling reads the clock a few times per line, so the speed is measured
+// with it off. The time spent in each subsystem comes from a second run of the
+// game from power on, profiled, over the first -p frames (all by default, 0
+// skips it).
+//
+// A JSON report from a previous run can be the baseline: the ROMs running
+// more than PERCENT slower (default 5%) are flagged, and the exit code is 1.
+
+#include <SDL.h>
+#include <dirent.h>
+#include <json.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "megado/genesis.h"
+#include "megado/m68k/m68k.h"
+#include "megado/settings.h"
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_THRESHOLD 5
+#define MAX_REPORTS 4
+
+static const char* const ROM_EXTENSIONS[] = { ".bin", ".md", ".gen" };
+
+static const char* const SUBSYSTEM_NAMES[SUBSYSTEM_COUNT] = { "m68k", "z80", "vdp", "sound" };
+
+typedef struct Result
+{
+    // Sent back by the process that ran the ROM
+    char game[49];
+    bool ok; // All the frames ran
+    uint32_t frames;
+    double time; // Wall time of the frames (s)
+    uint64_t instructions; // M68k
+    uint32_t profiled_frames; // Of the second run, where the subsystem times come from
+    double profiled_time; // Wall time of these frames (s)
+    double subsystem_time[SUBSYSTEM_COUNT];
+
+    // From the resource usage of that process
+    long peak_rss; // KB
+    double cpu_time; // User and system (s)
+
+    double baseline_fps; // 0 if the ROM is not in the baseline
+    bool regressed;
+} Result;
+
+typedef struct Job
+{
+    pid_t pid;
+    int pipe; // Read end, the result comes through it
+    int rom;
+} Job;
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static double fps(Result* r)
+{
+    return r->time > 0 ? r->frames / r->time : 0;
+}
+
+static double other_time(Result* r)
+{
+    double time = r->profiled_time;
+    for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+        time -= r->subsystem_time[s];
+
+    return time;
+}
+
+// Share of the profiled run (%)
+static double share(Result* r, double time)
+{
+    return r->profiled_time > 0 ? time / r->profiled_time * 100 : 0;
+}
+
+// ROMs
+
+static bool is_rom(const char* name)
+{
+    const char* extension = strrchr(name, '.');
+    if (extension == NULL)
+        return false;
+
+    for (size_t i = 0; i < sizeof(ROM_EXTENSIONS) / sizeof(ROM_EXTENSIONS[0]); ++i)
+        if (strcasecmp(extension, ROM_EXTENSIONS[i]) == 0)
+            return true;
+
+    return false;
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Adds the ROM, or the ROMs of the folder (sorted, for the reports to be comparable)
+static void add_roms(const char* path, char*** roms, int* count)
+{
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+    {
+        *roms = realloc(*roms, (*count + 1) * sizeof(char*));
+        (*roms)[(*count)++] = strdup(path);
+        return;
+    }
+
+    int first = *count;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!is_rom(entry->d_name))
+            continue;
+
+        char* rom = malloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(rom, "%s/%s", path, entry->d_name);
+
+        *roms = realloc(*roms, (*count + 1) * sizeof(char*));
+        (*roms)[(*count)++] = rom;
+    }
+
+    closedir(dir);
+
+    qsort(*roms + first, *count - first, sizeof(char*), compare_paths);
+}
+
+static Genesis* load_rom(const char* path, bool profiling)
+{
+    Genesis* g = genesis_make_headless();
+    g->settings->rewinding_enabled = false; // Not part of what is measured
+    g->profiling = profiling;
+
+    genesis_load_rom_file(g, path);
+
+    return g;
+}
+
+// Runs the frames, returns how many did before the emulator stopped
+static uint32_t run_frames(Genesis* g, uint32_t frames, double* time)
+{
+    uint32_t count = 0;
+
+    double start = now();
+    while (count < frames && g->status == Status_Running)
+    {
+        genesis_run_frame(g);
+        ++count;
+    }
+    *time = now() - start;
+
+    return count;
+}
+
+// Runs in the child process
+static void run_rom(const char* path, uint32_t frames, uint32_t profiled_frames, Result* r)
+{
+    Genesis* g = load_rom(path, false);
+    genesis_get_rom_name(g, r->game);
+
+    r->frames = run_frames(g, frames, &r->time);
+    r->ok = r->frames == frames;
+    r->instructions = g->m68k->instruction_count;
+
+    genesis_free(g);
+
+    // The same frames again, the emulation is deterministic
+    if (!r->ok || profiled_frames == 0)
+        return;
+
+    g = load_rom(path, true);
+
+    r->profiled_frames = run_frames(g, profiled_frames, &r->profiled_time);
+    memcpy(r->subsystem_time, g->subsystem_time, sizeof(r->subsystem_time));
+
+    genesis_free(g);
+}
+
+static Job start_job(const char* path, int rom, uint32_t frames, uint32_t profiled_frames)
+{
+    Job job = { -1, -1, rom };
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return job;
+    }
+
+    // Or the child would write what is left in the buffer again
+    fflush(stdout);
+
+    job.pid = fork();
+    if (job.pid == 0)
+    {
+        close(fds[0]);
+
+        // The header of hundreds of ROMs is not needed, the errors are
+        if (freopen("/dev/null", "w", stdout) == NULL)
+            _exit(1);
+
+        Result r = { 0 };
+        run_rom(path, frames, profiled_frames, &r);
+
+        bool ok = write(fds[1], &r, sizeof(r)) == sizeof(r);
+        _exit(ok ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    if (job.pid < 0)
+    {
+        perror("fork");
+        close(fds[0]);
+        job.pipe = -1;
+        return job;
+    }
+
+    job.pipe = fds[0];
+    return job;
+}
+
+static void finish_job(Job* job, Result* r, int status, struct rusage* usage)
+{
+    // The result is small enough to be in the pipe in one piece
+    if (read(job->pipe, r, sizeof(Result)) != sizeof(Result))
+        memset(r, 0, sizeof(Result));
+    close(job->pipe);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        r->ok = false;
+
+    r->peak_rss = usage->ru_maxrss;
+    r->cpu_time = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6
+        + usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+}
+
+static void run_corpus(char** roms, Result* results, int count, int jobs, uint32_t frames, uint32_t profiled_frames)
+{
+    Job* running = calloc(jobs, sizeof(Job));
+    int running_count = 0, next = 0, done = 0;
+
+    while (done < count)
+    {
+        while (running_count < jobs && next < count)
+        {
+            Job job = start_job(roms[next], next, frames, profiled_frames);
+            if (job.pid > 0)
+                running[running_count++] = job;
+            else
+                ++done; // Reported as failed
+            ++next;
+        }
+
+        if (running_count == 0)
+            continue;
+
+        int status;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0)
+        {
+            perror("wait4");
+            break;
+        }
+
+        for (int i = 0; i < running_count; ++i)
+        {
+            if (running[i].pid != pid)
+                continue;
+
+            int rom = running[i].rom;
+            Result* r = &results[rom];
+            finish_job(&running[i], r, status, &usage);
+            running[i] = running[--running_count];
+            ++done;
+
+            printf("[%d/%d] %-40s %s %8.1f frames/s\n", done, count, roms[rom], r->ok ? "    " : "FAIL", fps(r));
+            break;
+        }
+    }
+
+    free(running);
+}
+
+// Baseline
+
+// Returns the ROMs of a JSON report, NULL if it cannot be read
+static json_object* read_baseline(const char* path, json_object** baseline)
+{
+    *baseline = json_object_from_file(path);
+    json_object* baseline_roms = *baseline != NULL ? json_object_object_get(*baseline, "roms") : NULL;
+    if (baseline_roms == NULL || !json_object_is_type(baseline_roms, json_type_array))
+    {
+        printf("Cannot read the baseline \"%s\"\n", path);
+        json_object_put(*baseline);
+        *baseline = NULL;
+        return NULL;
+    }
+
+    return baseline_roms;
+}
+
+static void compare_to_baseline(json_object* baseline_roms, char** roms, Result* results, int count, double threshold)
+{
+    size_t length = json_object_array_length(baseline_roms);
+    for (size_t i = 0; i < length; ++i)
+    {
+        json_object* rom = json_object_array_get_idx(baseline_roms, i);
+        const char* rom_path = json_object_get_string(json_object_object_get(rom, "rom"));
+        if (rom_path == NULL)
+            continue;
+
+        for (int j = 0; j < count; ++j)
+        {
+            if (strcmp(roms[j], rom_path) != 0)
+                continue;
+
+            Result* r = &results[j];
+            r->baseline_fps = json_object_get_double(json_object_object_get(rom, "fps"));
+            r->regressed = r->ok && r->baseline_fps > 0 && fps(r) < r->baseline_fps * (1 - threshold / 100);
+        }
+    }
+}
+
+// Reports
+
+static bool write_json(const char* path, char** roms, Result* results, int count, uint32_t frames, int jobs)
+{
+    json_object* json = json_object_new_object();
+    json_object_object_add(json, "frames", json_object_new_int(frames));
+    json_object_object_add(json, "jobs", json_object_new_int(jobs));
+
+    json_object* json_roms = json_object_new_array();
+    for (int i = 0; i < count; ++i)
+    {
+        Result* r = &results[i];
+        json_object* json_rom = json_object_new_object();
+
+        json_object_object_add(json_rom, "rom", json_object_new_string(roms[i]));
+        json_object_object_add(json_rom, "game", json_object_new_string(r->game));
+        json_object_object_add(json_rom, "ok", json_object_new_boolean(r->ok));
+        json_object_object_add(json_rom, "frames", json_object_new_int(r->frames));
+        json_object_object_add(json_rom, "fps", json_object_new_double(fps(r)));
+        json_object_object_add(json_rom, "m68k_instructions_per_second",
+            json_object_new_double(r->time > 0 ? r->instructions / r->time : 0));
+        json_object_object_add(json_rom, "peak_rss_kb", json_object_new_int64(r->peak_rss));
+        json_object_object_add(json_rom, "cpu_time", json_object_new_double(r->cpu_time));
+        json_object_object_add(json_rom, "profiled_frames", json_object_new_int(r->profiled_frames));
+
+        json_object* json_time = json_object_new_object();
+        for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+            json_object_object_add(json_time, SUBSYSTEM_NAMES[s], json_object_new_double(r->subsystem_time[s]));
+        json_object_object_add(json_time, "other", json_object_new_double(other_time(r)));
+        json_object_object_add(json_rom, "time", json_time);
+
+        if (r->baseline_fps > 0)
+            json_object_object_add(json_rom, "baseline_fps", json_object_new_double(r->baseline_fps));
+        json_object_object_add(json_rom, "regressed", json_object_new_boolean(r->regressed));
+
+        json_object_array_add(json_roms, json_rom);
+    }
+    json_object_object_add(json, "roms", json_roms);
+
+    bool ok = json_object_to_file_ext(path, json, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_SPACED) == 0;
+    json_object_put(json);
+
+    return ok;
+}
+
+static bool write_csv(const char* path, char** roms, Result* results, int count)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "rom,game,ok,frames,fps,m68k_instructions_per_second,peak_rss_kb,cpu_time,profiled_frames");
+    for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+        fprintf(file, ",%s_time", SUBSYSTEM_NAMES[s]);
+    fprintf(file, ",other_time,baseline_fps,regressed\n");
+
+    for (int i = 0; i < count; ++i)
+    {
+        Result* r = &results[i];
+
+        // The names come from the ROM headers, quotes are doubled
+        fprintf(file, "\"%s\",\"", roms[i]);
+        for (const char* c = r->game; *c != '\0'; ++c)
+            fprintf(file, *c == '"' ? "\"\"" : "%c", *c);
+
+        fprintf(file, "\",%d,%u,%.2f,%.0f,%ld,%.3f,%u", r->ok, r->frames, fps(r),
+            r->time > 0 ? r->instructions / r->time : 0, r->peak_rss, r->cpu_time, r->profiled_frames);
+        for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+            fprintf(file, ",%.4f", r->subsystem_time[s]);
+        fprintf(file, ",%.4f,%.2f,%d\n", other_time(r), r->baseline_fps, r->regressed);
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static void print_summary(char** roms, Result* results, int count)
+{
+    printf("\n%-40s %10s %8s %8s", "ROM", "frames/s", "MIPS", "RSS MB");
+    for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+        printf(" %6s", SUBSYSTEM_NAMES[s]);
+    printf(" %6s %9s\n", "other", "baseline");
+
+    for (int i = 0; i < count; ++i)
+    {
+        Result* r = &results[i];
+
+        const char* name = strrchr(roms[i], '/') != NULL ? strrchr(roms[i], '/') + 1 : roms[i];
+        printf("%-40.40s ", name);
+
+        if (!r->ok)
+        {
+            printf("%10s\n", "FAILED");
+            continue;
+        }
+
+        printf("%10.1f %8.2f %8.1f", fps(r), r->instructions / r->time / 1e6, r->peak_rss / 1024.0);
+        if (r->profiled_frames > 0)
+        {
+            for (int s = 0; s < SUBSYSTEM_COUNT; ++s)
+                printf(" %5.1f%%", share(r, r->subsystem_time[s]));
+            printf(" %5.1f%%", share(r, other_time(r)));
+        }
+        else
+        {
+            for (int s = 0; s <= SUBSYSTEM_COUNT; ++s)
+                printf(" %6s", "-");
+        }
+
+        if (r->baseline_fps > 0)
+            printf(" %+8.1f%%%s", (fps(r) / r->baseline_fps - 1) * 100, r->regressed ? " REGRESSED" : "");
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int jobs = SDL_GetCPUCount();
+    uint32_t frames = DEFAULT_FRAMES;
+    int profiled = -1; // All the frames
+    const char* baseline_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* reports[MAX_REPORTS];
+    int report_count = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:n:p:b:t:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j': jobs = atoi(optarg); break;
+        case 'n': frames = atoi(optarg); break;
+        case 'p': profiled = atoi(optarg); break;
+        case 'b': baseline_path = optarg; break;
+        case 't': threshold = atof(optarg); break;
+        case 'o':
+            if (report_count < MAX_REPORTS)
+                reports[report_count++] = optarg;
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    char** roms = NULL;
+    int count = 0;
+    for (int i = optind; i < argc; ++i)
+        add_roms(argv[i], &roms, &count);
+
+    if (count == 0 || jobs < 1)
+    {
+        printf("Usage: corpus-bench [-j JOBS] [-n FRAMES] [-p FRAMES] [-b BASELINE] [-t PERCENT] [-o REPORT]... ROM|FOLDER...\n");
+        return 1;
+    }
+
+    uint32_t profiled_frames = profiled < 0 || (uint32_t)profiled > frames ? frames : (uint32_t)profiled;
+
+    // Read first, not to find out it cannot be after the whole run
+    json_object* baseline = NULL;
+    json_object* baseline_roms = NULL;
+    if (baseline_path != NULL && (baseline_roms = read_baseline(baseline_path, &baseline)) == NULL)
+        return 1;
+
+    // Before forking: the processes share the M68k instruction table
+    m68k_generate_opcode_table();
+
+    printf("%d ROMs, %u frames each (%u profiled), %d at a time\n\n", count, frames, profiled_frames, jobs);
+
+    Result* results = calloc(count, sizeof(Result));
+    double start = now();
+    run_corpus(roms, results, count, jobs, frames, profiled_frames);
+    double time = now() - start;
+
+    if (baseline_roms != NULL)
+        compare_to_baseline(baseline_roms, roms, results, count, threshold);
+
+    print_summary(roms, results, count);
+
+    int failures = 0, regressions = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        failures += !results[i].ok;
+        regressions += results[i].regressed;
+    }
+
+    printf("\n%d ROMs in %.1fs, %d failed", count, time, failures);
+    if (baseline != NULL)
+        printf(", %d more than %.1f%% slower than the baseline", regressions, threshold);
+    printf("\n");
+
+    for (int i = 0; i < report_count; ++i)
+    {
+        const char* extension = strrchr(reports[i], '.');
+        bool json = extension != NULL && strcmp(extension, ".json") == 0;
+
+        bool ok = json ? write_json(reports[i], roms, results, count, frames, jobs) : write_csv(reports[i], roms, results, count);
+        if (!ok)
+            printf("Cannot write the report \"%s\"\n", reports[i]);
+    }
+
+    for (int i = 0; i < count; ++i)
+        free(roms[i]);
+    free(roms);
+    free(results);
+    json_object_put(baseline);
+
+    m68k_free_opcode_table();
+
+    return failures == 0 && regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch corpus-bench (see ../tools.sh)
+
+exec ../tools.sh corpus-bench '[-j JOBS] [-n FRAMES] [-p FRAMES] [-b BASELINE] [-t PERCENT] [-o REPORT]... ROM|FOLDER...' "$@"
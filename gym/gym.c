@@ -28,16 +28,20 @@ void gym_play(struct GYM gym) {
   gym_ym2612 = &ym;
   gym_psg = &psg;
 
+  // The writes are queued with their time and the audio is rendered once per frame
+  Sound* sound = sound_make(&psg, &ym, (double)NTSC_MASTER_FREQUENCY / SAMPLE_RATE);
+  int16_t samples[SOUND_BLOCK_LENGTH * 2];
+
   uint8_t dac_buffer[1024];
   uint16_t dac_count = 0;
 
-  double remaining_time = 0;
-  double time_slice = (double)1 / SAMPLE_RATE;
-  uint32_t slice_cycles = time_slice * NTSC_MASTER_FREQUENCY;
+  double remaining_cycles = 0;
 
   uint64_t pc = 0;
   uint8_t opcode;
 
+  AudioRing* ring = audio_ring_make();
+
   SDL_AudioSpec want, have;
 
   SDL_memset(&want, 0, sizeof(want));
@@ -45,7 +49,8 @@ void gym_play(struct GYM gym) {
   want.format = AUDIO_S16;
   want.channels = 2;
   want.samples = 512;
-  want.callback = NULL; // Use SDL_QueueAudio instead
+  want.callback = audio_ring_callback;
+  want.userdata = ring;
 
   SDL_AudioDeviceID audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
 
@@ -68,39 +73,28 @@ void gym_play(struct GYM gym) {
     case 0x00: {
       // Compute number of master cycles for the sleep period
       double sleep_period = (double)1/60;
-      remaining_time += sleep_period;
-
-      int dac_index = 0;
-
-      int audio_samples_count = SAMPLE_RATE / 60;
-      double samples_per_dac = (double)dac_count / audio_samples_count;
-      double samples_this_dac = 0;
-
-      // Emulate for that duration in slice of audio samples
-      while (remaining_time > 0) {
-
-        // If we have some DAC samples, we need to feed them to the YM2612
-        if (dac_count > 0 && dac_index < dac_count) {
-          // Write the DAC samples evenly throughout the frame
-          samples_this_dac += samples_per_dac;
-          if (samples_this_dac > 1) {
-            ym2612_write_register(&ym, 0x2a, dac_buffer[dac_index++], PART_I);
-            samples_this_dac -= 1;
-          }
-        }
+      remaining_cycles += sleep_period * NTSC_MASTER_FREQUENCY;
+      uint32_t frame_cycles = remaining_cycles;
+      remaining_cycles -= frame_cycles;
+
+      // Write the DAC samples evenly throughout the frame
+      for (int i = 0; i < dac_count; ++i) {
+        uint32_t at = (uint64_t)frame_cycles * i / dac_count;
+        sound_write(sound, at, SoundChip_YM2612, 0, 0x2a);
+        sound_write(sound, at, SoundChip_YM2612, 1, dac_buffer[i]);
+      }
 
-        ym2612_run_cycles(&ym, slice_cycles);
-        psg_run_cycles(&psg, slice_cycles);
+      sound_advance(sound, frame_cycles);
+      sound_render(sound);
 
-        // Sample the audio units
-        // @Temporary: use left channel for PSG and right channel for YM2612
-        int16_t sample[2] = {psg_mix(&psg), ym2612_mix(&ym)};
-        // Queue samples to audio device
-        if (SDL_QueueAudio(audio_device, sample, 2 * sizeof(int16_t)) != 0) {
-          fprintf(stderr, "Failed to queue audio: %s", SDL_GetError());
+      // @Temporary: use left channel for PSG and right channel for YM2612
+      uint32_t count;
+      while ((count = sound_read(sound, samples, SOUND_BLOCK_LENGTH)) > 0) {
+        // Emulation is faster than playback: wait for the device to make room
+        while (g_playing && audio_ring_room(ring) < count) {
+          SDL_Delay(1);
         }
-
-        remaining_time -= time_slice;
+        audio_ring_write(ring, samples, count);
       }
 
       // All DAC samples should have been flushed this frame, so reset
@@ -124,7 +118,8 @@ void gym_play(struct GYM gym) {
           dac_buffer[dac_count++] = value;
         }
       } else {
-        ym2612_write_register(&ym, reg, value, PART_I);
+        sound_write(sound, 0, SoundChip_YM2612, 0, reg);
+        sound_write(sound, 0, SoundChip_YM2612, 1, value);
       }
 
     } break;
@@ -133,13 +128,14 @@ void gym_play(struct GYM gym) {
     case 0x02: {
       uint8_t reg = gym.data[pc++];
       uint8_t value = gym.data[pc++];
-      ym2612_write_register(&ym, reg, value, PART_II);
+      sound_write(sound, 0, SoundChip_YM2612, 2, reg);
+      sound_write(sound, 0, SoundChip_YM2612, 3, value);
     } break;
 
       // Write to PSG
     case 0x03: {
       uint8_t value = gym.data[pc++];
-      psg_write(&psg, value);
+      sound_write(sound, 0, SoundChip_PSG, 0, value);
     } break;
 
     default:
@@ -150,12 +146,14 @@ void gym_play(struct GYM gym) {
   printf("Emulation done.  Playing remaining audio\n");
 
   // Wait for the audio queue to empty before exiting
-  while (g_playing && SDL_GetQueuedAudioSize(audio_device) > 0) {
+  while (g_playing && audio_ring_fill(ring) > 0) {
     usleep(100);
   }
 
   // Destroy SDL
   SDL_CloseAudioDevice(audio_device);
+  audio_ring_free(ring);
+  sound_free(sound);
 
   // Release pointers
   gym_ym2612 = NULL;
@@ -4,7 +4,9 @@
 #include <stdio.h>
 
 #include "../megado/ym2612.h"
+#include "../megado/audio_ring.h"
 #include "../megado/psg.h"
+#include "../megado/sound.h"
 
 extern YM2612 *gym_ym2612;
 extern PSG *gym_psg;
@@ -2,15 +2,22 @@
 #include <stdio.h>
 
 #include "audio.h"
-#include "genesis.h"
 
-const uint32_t SAMPLE_RATE = 44100;
+// Samples buffered for the device, as a duration (s)
+static const double TARGET_LATENCY = 0.03;
 
-Audio* audio_make(Genesis* g) {
+// Largest change of the sample rate, well under an audible pitch shift
+static const double MAX_RATE_DELTA = 0.005;
+
+Audio* audio_make(void) {
     Audio* a = calloc(1, sizeof(Audio));
-    a->genesis = g;
+    a->ring = audio_ring_make();
 
-    SDL_Init(SDL_INIT_AUDIO);
+    // SDL is set up by the host, once for the whole process
+    if (!SDL_WasInit(SDL_INIT_AUDIO)) {
+        fprintf(stderr, "SDL audio is not initialized, continuing with audio disabled\n");
+        return a;
+    }
 
     SDL_AudioSpec want, have;
 
@@ -19,7 +26,8 @@ Audio* audio_make(Genesis* g) {
     want.format = AUDIO_S16;
     want.channels = 2;
     want.samples = 512;
-    want.callback = NULL; // Use SDL_QueueAudio instead
+    want.callback = audio_ring_callback;
+    want.userdata = a->ring;
 
     a->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
 
@@ -32,30 +40,64 @@ Audio* audio_make(Genesis* g) {
 }
 
 void audio_free(Audio* a) {
+    if (a == NULL)
+        return;
+
     if (a->device > 0) {
         SDL_CloseAudioDevice(a->device);
     }
-    SDL_Quit();
 
+    audio_ring_free(a->ring);
     free(a);
 }
 
-void audio_initialize(Audio* a) {
+void audio_queue(Audio* a, const int16_t* samples, uint32_t count) {
     if (a->device > 0) {
-        SDL_ClearQueuedAudio(a->device);
+        audio_ring_write(a->ring, samples, count);
     }
+}
+
+double audio_rate_control(Audio* a) {
+    if (a->device == 0) {
+        return 1;
+    }
+
+    double target = TARGET_LATENCY * SAMPLE_RATE;
+    double error = (audio_ring_fill(a->ring) - target) / target;
+    if (error > 1)
+        error = 1;
+
+    return 1 + MAX_RATE_DELTA * error;
+}
+
+// Audio sink
 
-    a->remaining_time = 0;
+static void sink_queue(void* a, const int16_t* samples, uint32_t count) {
+    audio_queue(a, samples, count);
 }
 
-void audio_update(Audio* a) {
-    if (a->genesis->status == Status_Running) {
-        if (a->device > 0) {
-            SDL_PauseAudioDevice(a->device, 0);
-        }
-    } else {
-        if (a->device > 0) {
-            SDL_PauseAudioDevice(a->device, 1);
-        }
+static double sink_rate_control(void* a) {
+    return audio_rate_control(a);
+}
+
+static void sink_set_playing(void* context, bool playing) {
+    Audio* a = context;
+    if (a->device > 0) {
+        SDL_PauseAudioDevice(a->device, playing ? 0 : 1);
+    }
+}
+
+static void sink_clear(void* context) {
+    Audio* a = context;
+
+    // The callback does not run while the device is locked
+    if (a->device > 0) {
+        SDL_LockAudioDevice(a->device);
+        audio_ring_clear(a->ring);
+        SDL_UnlockAudioDevice(a->device);
     }
 }
+
+AudioSink audio_sink(Audio* a) {
+    return (AudioSink) { sink_queue, sink_rate_control, sink_set_playing, sink_clear, a };
+}
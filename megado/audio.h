@@ -2,17 +2,23 @@
 
 #include <SDL.h>
 
-extern const uint32_t SAMPLE_RATE;
-
-struct Genesis;
+#include "audio_ring.h"
+#include "host.h"
 
 typedef struct Audio {
-    struct Genesis* genesis;
-    SDL_AudioDeviceID device;
-    double remaining_time;
+    SDL_AudioDeviceID device; // 0 when the device cannot be opened, the samples are then dropped
+    AudioRing* ring; // Drained by the device callback
 } Audio;
 
-Audio* audio_make(struct Genesis*);
+Audio* audio_make(void);
 void audio_free(Audio*);
-void audio_initialize(Audio*);
-void audio_update(Audio*);
+
+// The audio device as the emulation's audio sink
+AudioSink audio_sink(Audio*);
+
+void audio_queue(Audio*, const int16_t* samples, uint32_t count); // Interleaved left and right channels
+
+// Factor for the master cycles per sample, within a fraction of a percent of 1:
+// more than 1 when the device buffer is over its target fill, so that fewer
+// samples are produced, and less than 1 when it is under
+double audio_rate_control(Audio*);
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_ring.h"
+
+#define RING_MASK (AUDIO_RING_LENGTH - 1)
+
+AudioRing* audio_ring_make(void)
+{
+    AudioRing* r = calloc(1, sizeof(AudioRing));
+    r->samples = calloc(AUDIO_RING_LENGTH * 2, sizeof(int16_t));
+    return r;
+}
+
+void audio_ring_free(AudioRing* r)
+{
+    if (r == NULL)
+        return;
+
+    free(r->samples);
+    free(r);
+}
+
+void audio_ring_clear(AudioRing* r)
+{
+    SDL_AtomicSet(&r->tail, SDL_AtomicGet(&r->head));
+    r->last[0] = r->last[1] = 0;
+}
+
+uint32_t audio_ring_fill(AudioRing* r)
+{
+    return (uint32_t)SDL_AtomicGet(&r->head) - (uint32_t)SDL_AtomicGet(&r->tail);
+}
+
+uint32_t audio_ring_room(AudioRing* r)
+{
+    return AUDIO_RING_LENGTH - audio_ring_fill(r);
+}
+
+// Stereo samples from `index` to the end of the ring, the rest wraps around to the start
+static uint32_t first_part(uint32_t index, uint32_t count)
+{
+    uint32_t until_end = AUDIO_RING_LENGTH - (index & RING_MASK);
+    return count < until_end ? count : until_end;
+}
+
+uint32_t audio_ring_write(AudioRing* r, const int16_t* samples, uint32_t count)
+{
+    uint32_t head = (uint32_t)SDL_AtomicGet(&r->head);
+    uint32_t room = AUDIO_RING_LENGTH - (head - (uint32_t)SDL_AtomicGet(&r->tail));
+
+    if (count > room)
+    {
+        SDL_AtomicAdd(&r->overruns, 1);
+        SDL_AtomicAdd(&r->dropped_samples, count - room);
+        count = room;
+    }
+
+    uint32_t first = first_part(head, count);
+    memcpy(r->samples + (head & RING_MASK) * 2, samples, first * 2 * sizeof(int16_t));
+    memcpy(r->samples, samples + first * 2, (count - first) * 2 * sizeof(int16_t));
+
+    // Publish the samples once they are in place
+    SDL_AtomicSet(&r->head, head + count);
+
+    return count;
+}
+
+void audio_ring_read(AudioRing* r, int16_t* samples, uint32_t count)
+{
+    uint32_t tail = (uint32_t)SDL_AtomicGet(&r->tail);
+    uint32_t available = (uint32_t)SDL_AtomicGet(&r->head) - tail;
+    uint32_t taken = count < available ? count : available;
+
+    uint32_t first = first_part(tail, taken);
+    memcpy(samples, r->samples + (tail & RING_MASK) * 2, first * 2 * sizeof(int16_t));
+    memcpy(samples + first * 2, r->samples, (taken - first) * 2 * sizeof(int16_t));
+    SDL_AtomicSet(&r->tail, tail + taken);
+
+    if (taken > 0)
+    {
+        r->last[0] = samples[taken * 2 - 2];
+        r->last[1] = samples[taken * 2 - 1];
+    }
+
+    // Hold the last level rather than going to zero, which would click
+    if (taken < count)
+    {
+        SDL_AtomicAdd(&r->underruns, 1);
+        for (uint32_t i = taken; i < count; ++i)
+        {
+            samples[i * 2] = r->last[0];
+            samples[i * 2 + 1] = r->last[1];
+        }
+    }
+}
+
+void audio_ring_callback(void* ring, Uint8* stream, int length)
+{
+    audio_ring_read(ring, (int16_t*)stream, length / (2 * sizeof(int16_t)));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdint.h>
+
+// Stereo samples buffered between the emulation and the audio device, must be a power of two
+#define AUDIO_RING_LENGTH 8192
+
+// Lock-free single-producer/single-consumer queue of stereo samples
+//
+// The emulation thread writes the samples in blocks as it renders them, and
+// the SDL audio callback reads them when the device needs more. Neither side
+// waits: when the ring is full the newest samples are dropped (overrun), and
+// when it is empty the device gets the last sample again (underrun).
+typedef struct AudioRing
+{
+    int16_t* samples; // Interleaved left and right channels
+
+    // Stereo samples written and read since the start, the indices wrap around
+    SDL_atomic_t head; // Written by the producer
+    SDL_atomic_t tail; // Written by the consumer
+
+    // Metrics
+    SDL_atomic_t underruns; // Device callbacks that could not be filled
+    SDL_atomic_t overruns; // Writes that did not fit
+    SDL_atomic_t dropped_samples;
+
+    // Consumer
+    int16_t last[2];
+} AudioRing;
+
+AudioRing* audio_ring_make(void);
+void audio_ring_free(AudioRing*);
+
+// Drop the buffered samples, only when the consumer is not running
+// (e.g. with the audio device locked)
+void audio_ring_clear(AudioRing*);
+
+// Producer: queue `count` stereo samples, returns how many fit
+uint32_t audio_ring_write(AudioRing*, const int16_t* samples, uint32_t count);
+
+// Producer: stereo samples that can be written without dropping any
+uint32_t audio_ring_room(AudioRing*);
+
+// Consumer: take `count` stereo samples, repeating the last one if there are not enough
+void audio_ring_read(AudioRing*, int16_t* samples, uint32_t count);
+
+// Stereo samples waiting to be played
+uint32_t audio_ring_fill(AudioRing*);
+
+// SDL audio callback, with the ring as user data (AUDIO_S16 format, 2 channels)
+void audio_ring_callback(void* ring, Uint8* stream, int length);
@@ -0,0 +1,126 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blep.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Same filter as the resampler's
+static const double CUTOFF = 0.45;
+static const double KAISER_BETA = 8;
+
+// Fixed point of the kernel, every interpolated row sums to exactly one
+#define BLEP_SHIFT 20
+#define BLEP_UNIT (1 << BLEP_SHIFT)
+
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void build_kernel(Blep* b)
+{
+    for (int phase = 0; phase <= BLEP_PHASES; ++phase)
+    {
+        double fraction = (double)phase / BLEP_PHASES;
+        double row[BLEP_WIDTH];
+        double sum = 0;
+
+        // Coefficient k is for the sample k + 1 - fraction after the step,
+        // taken in the middle of the interval since the previous sample
+        for (int k = 0; k < BLEP_WIDTH; ++k)
+        {
+            double distance = k + 0.5 - fraction;
+            double x = distance - BLEP_WIDTH / 2.0;
+            double sinc = x == 0 ? 2 * CUTOFF : sin(2 * M_PI * CUTOFF * x) / (M_PI * x);
+            double w = 2 * distance / BLEP_WIDTH - 1;
+            double window = w * w < 1 ? bessel_i0(KAISER_BETA * sqrt(1 - w * w)) / bessel_i0(KAISER_BETA) : 0;
+
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+
+        for (int k = 0; k < BLEP_WIDTH; ++k)
+            b->kernel[phase][k] = (int32_t)lround(row[k] / sum * BLEP_UNIT);
+    }
+}
+
+Blep* blep_make(uint32_t length)
+{
+    Blep* b = calloc(1, sizeof(Blep));
+    build_kernel(b);
+    b->length = length;
+    b->deltas = calloc(length + BLEP_WIDTH + 1, sizeof(int64_t));
+    return b;
+}
+
+void blep_free(Blep* b)
+{
+    if (b == NULL)
+        return;
+
+    free(b->deltas);
+    free(b);
+}
+
+void blep_clear(Blep* b)
+{
+    b->level = 0;
+    b->sum = 0;
+    memset(b->deltas, 0, (b->length + BLEP_WIDTH + 1) * sizeof(int64_t));
+}
+
+void blep_set_level(Blep* b, double time, int32_t level)
+{
+    int32_t delta = level - b->level;
+    if (delta == 0)
+        return;
+
+    b->level = level;
+
+    double base = floor(time);
+    double phase = (time - base) * BLEP_PHASES;
+    int row = (int)phase;
+    int32_t weight = (int32_t)((phase - row) * 256);
+
+    // The first sample after the step
+    int64_t* out = b->deltas + (int32_t)base + 1;
+    const int32_t* k0 = b->kernel[row];
+    const int32_t* k1 = b->kernel[row + 1];
+
+    // Interpolate between the two phases, keeping the exact sum for the
+    // level to be reached without any drift
+    int32_t sum = 0;
+    for (int k = 0; k < BLEP_WIDTH; ++k)
+    {
+        int32_t coefficient = (k0[k] * (256 - weight) + k1[k] * weight) >> 8;
+        out[k] += (int64_t)delta * coefficient;
+        sum += coefficient;
+    }
+    out[BLEP_WIDTH / 2] += (int64_t)delta * (BLEP_UNIT - sum);
+}
+
+void blep_read(Blep* b, int16_t* out, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        b->sum += b->deltas[i];
+
+        int64_t sample = (b->sum + BLEP_UNIT / 2) >> BLEP_SHIFT;
+        out[i] = sample > 32767 ? 32767 : sample < -32768 ? -32768 : (int16_t)sample;
+    }
+
+    // Shift the tails of the last steps
+    uint32_t pending = b->length + BLEP_WIDTH + 1 - count;
+    memmove(b->deltas, b->deltas + count, pending * sizeof(int64_t));
+    memset(b->deltas + pending, 0, count * sizeof(int64_t));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// Kernel length of a step, in output samples.
+// Same as the resampler's, for both to have the same delay.
+#define BLEP_WIDTH 40
+
+// Fractional positions the kernel is tabulated for, the ones in between are interpolated
+#define BLEP_PHASES 64
+
+// Output of a signal made of steps, synthesized directly at the output rate
+// from its level changes (band-limited steps)
+//
+// Each change is spread over the following BLEP_WIDTH samples, and is
+// centered BLEP_WIDTH / 2 samples after it happened.
+typedef struct Blep
+{
+    // Differences of a band-limited step between consecutive samples, in fixed point
+    int32_t kernel[BLEP_PHASES + 1][BLEP_WIDTH];
+
+    int32_t level; // Last level set
+    int64_t sum; // Of the deltas of the samples read
+
+    // Level changes of the next samples, in fixed point
+    int64_t* deltas;
+    uint32_t length;
+} Blep;
+
+// `length` is the maximum number of samples read at once
+Blep* blep_make(uint32_t length);
+void blep_free(Blep*);
+
+// Back to a zero level, with no pending changes
+void blep_clear(Blep*);
+
+// Change the level at `time`, in samples from the next one to be read
+// (more than -1, and less than the length)
+void blep_set_level(Blep*, double time, int32_t level);
+
+// Take the next `count` samples
+void blep_read(Blep*, int16_t* out, uint32_t count);
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug_view.h"
+#include "m68k/bit_utils.h"
+
+#define PATTERNS_COUNT 0x800
+
+// Past this share of dirty tiles, the texture is uploaded in one go
+#define FULL_UPLOAD_RATIO 4
+
+DebugView* debug_view_make(uint16_t width, uint16_t height)
+{
+    DebugView* d = calloc(1, sizeof(DebugView));
+    d->width = width;
+    d->height = height;
+    d->pixels = calloc(width * height * 3, sizeof(uint8_t));
+    d->dirty_tiles = calloc((width / 8) * (height / 8), sizeof(bool));
+
+    glGenTextures(1, &d->texture);
+    glBindTexture(GL_TEXTURE_2D, d->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    return d;
+}
+
+void debug_view_free(DebugView* d)
+{
+    if (d == NULL)
+        return;
+
+    glDeleteTextures(1, &d->texture);
+    free(d->pixels);
+    free(d->dirty_tiles);
+    free(d);
+}
+
+static uint32_t tile_count(DebugView* d)
+{
+    return (d->width / 8) * (d->height / 8);
+}
+
+static void mark_tile(DebugView* d, uint32_t tile)
+{
+    if (!d->dirty_tiles[tile])
+    {
+        d->dirty_tiles[tile] = true;
+        ++d->dirty_count;
+    }
+}
+
+static void mark_all_tiles(DebugView* d)
+{
+    memset(d->dirty_tiles, true, tile_count(d) * sizeof(bool));
+    d->dirty_count = tile_count(d);
+}
+
+static void clear_tile(DebugView* d, uint32_t x, uint32_t y)
+{
+    for (uint32_t py = 0; py < 8; ++py)
+        memset(d->pixels + ((y + py) * d->width + x) * 3, 0, 8 * 3);
+}
+
+// Patterns whose pixels differ from the ones the image was drawn from
+static void find_changed_patterns(DebugView* d, Vdp* v, bool* changed)
+{
+    for (int pattern = 0; pattern < PATTERNS_COUNT; ++pattern)
+        changed[pattern] = memcmp(d->vram + pattern * 32, v->vram + pattern * 32, 32) != 0;
+}
+
+static bool palette_changed(Color* drawn, Color* current)
+{
+    return memcmp(drawn, current, 16 * sizeof(Color)) != 0;
+}
+
+// A new layout makes every tile stale
+static void set_layout(DebugView* d, uint64_t layout)
+{
+    if (!d->drawn || d->layout != layout)
+    {
+        d->layout = layout;
+        memset(d->pixels, 0, d->width * d->height * 3);
+        mark_all_tiles(d);
+    }
+}
+
+static void upload(DebugView* d)
+{
+    glBindTexture(GL_TEXTURE_2D, d->texture);
+
+    if (!d->drawn || d->dirty_count > tile_count(d) / FULL_UPLOAD_RATIO)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, d->width, d->height, 0, GL_RGB, GL_UNSIGNED_BYTE, d->pixels);
+    }
+    else if (d->dirty_count > 0)
+    {
+        // The tiles are read in place from the image
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, d->width);
+
+        uint16_t columns = d->width / 8;
+        for (uint32_t tile = 0; tile < tile_count(d); ++tile)
+        {
+            if (!d->dirty_tiles[tile])
+                continue;
+
+            uint32_t x = tile % columns * 8;
+            uint32_t y = tile / columns * 8;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, 8, 8, GL_RGB, GL_UNSIGNED_BYTE, d->pixels + (y * d->width + x) * 3);
+        }
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+
+    memset(d->dirty_tiles, 0, tile_count(d) * sizeof(bool));
+    d->dirty_count = 0;
+    d->drawn = true;
+}
+
+void debug_view_update_patterns(DebugView* d, Vdp* v, Color* palette)
+{
+    uint16_t columns = d->width / 8;
+
+    set_layout(d, 0);
+    if (palette_changed(d->cram, palette))
+        mark_all_tiles(d);
+
+    bool changed[PATTERNS_COUNT];
+    find_changed_patterns(d, v, changed);
+
+    for (uint32_t pattern = 0; pattern < PATTERNS_COUNT && pattern < tile_count(d); ++pattern)
+    {
+        if (!changed[pattern] && !d->dirty_tiles[pattern])
+            continue;
+
+        uint32_t x = pattern % columns * 8;
+        uint32_t y = pattern / columns * 8;
+        clear_tile(d, x, y);
+        vdp_draw_pattern(v, pattern, palette, d->pixels, d->width, x, y, false, false);
+        mark_tile(d, pattern);
+    }
+
+    memcpy(d->vram, v->vram, sizeof(d->vram));
+    memcpy(d->cram, palette, 16 * sizeof(Color));
+    upload(d);
+}
+
+void debug_view_update_plane(DebugView* d, Vdp* v, Planes plane)
+{
+    uint32_t nametable;
+    uint16_t plane_width, plane_height;
+    vdp_get_plane_layout(v, plane, &nametable, &plane_width, &plane_height);
+
+    set_layout(d, (uint64_t)plane | (uint64_t)nametable << 8 | (uint64_t)plane_width << 32 | (uint64_t)plane_height << 48);
+
+    bool changed[PATTERNS_COUNT];
+    find_changed_patterns(d, v, changed);
+
+    bool palettes_changed[4];
+    for (int palette = 0; palette < 4; ++palette)
+        palettes_changed[palette] = palette_changed(d->cram + palette * 16, v->cram + palette * 16);
+
+    // The cells that do not fit in the image are left out
+    uint16_t columns = d->width / 8;
+    uint16_t rows = d->height / 8;
+
+    for (int cy = 0; cy < plane_height && cy < rows; ++cy)
+        for (int cx = 0; cx < plane_width && cx < columns; ++cx)
+        {
+            uint16_t cell = cy * plane_width + cx;
+            uint32_t tile = cy * columns + cx;
+
+            uint16_t pattern, palette;
+            bool priority, horizontal_flip, vertical_flip;
+            vdp_get_plane_cell_data(v, plane, cell, &pattern, &palette, &priority, &horizontal_flip, &vertical_flip);
+
+            uint16_t entry_address = (nametable + cell * 2) & 0xFFFF;
+            bool entry_changed = memcmp(d->vram + entry_address, v->vram + entry_address, 2) != 0;
+
+            if (!entry_changed && !changed[pattern] && !palettes_changed[palette] && !d->dirty_tiles[tile])
+                continue;
+
+            clear_tile(d, cx * 8, cy * 8);
+            vdp_draw_pattern(v, pattern, v->cram + palette * 16, d->pixels, d->width, cx * 8, cy * 8, horizontal_flip, vertical_flip);
+            mark_tile(d, tile);
+        }
+
+    memcpy(d->vram, v->vram, sizeof(d->vram));
+    memcpy(d->cram, v->cram, sizeof(d->cram));
+    upload(d);
+}
+
+// Whether any sprite in the list, or what it is drawn from, changed
+static bool sprites_changed(DebugView* d, Vdp* v)
+{
+    if (memcmp(d->cram, v->cram, sizeof(d->cram)) != 0)
+        return true;
+
+    bool changed[PATTERNS_COUNT];
+    find_changed_patterns(d, v, changed);
+
+    // Same walk as vdp_draw_sprites: when the attributes of every sprite it
+    // reaches are unchanged, the previous walk reached the same ones
+    uint8_t sprite = 0;
+    uint8_t sprite_counter = 0;
+    do
+    {
+        uint16_t address = (v->sprites_attribute_table + sprite * 8) & 0xFFFF;
+        if (memcmp(d->vram + address, v->vram + address, 8) != 0)
+            return true;
+
+        uint8_t* attributes = v->vram + address;
+        uint8_t width = FRAGMENT(attributes[2], 3, 2) + 1;
+        uint8_t height = FRAGMENT(attributes[2], 1, 0) + 1;
+        uint16_t pattern_index = (attributes[4] & 7) << 8 | attributes[5];
+
+        for (int pattern = 0; pattern < width * height; ++pattern)
+            if (changed[(pattern_index + pattern) & (PATTERNS_COUNT - 1)])
+                return true;
+
+        ++sprite_counter;
+        sprite = attributes[3] & 0x7F;
+
+    } while (sprite != 0 && sprite_counter < 64);
+
+    return false;
+}
+
+void debug_view_update_sprites(DebugView* d, Vdp* v)
+{
+    set_layout(d, v->sprites_attribute_table);
+
+    // Sprites overlap and are framed, there is no telling which tiles
+    // one covers without drawing them all
+    if (d->dirty_count > 0 || sprites_changed(d, v))
+    {
+        memset(d->pixels, 0, d->width * d->height * 3);
+        vdp_draw_sprites(v, d->pixels, d->width);
+        mark_all_tiles(d);
+
+        memcpy(d->vram, v->vram, sizeof(d->vram));
+        memcpy(d->cram, v->cram, sizeof(d->cram));
+    }
+
+    upload(d);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdp.h"
+
+// Image of a VDP debug window (patterns, planes or sprites)
+//
+// Drawing a whole image and uploading it every frame costs about as much as
+// emulating the frame, while the VRAM and CRAM it is drawn from seldom change
+// much from one frame to the next. The view keeps the contents it was last
+// drawn from: only the 8x8 tiles depending on what changed since are drawn
+// again, and only those are uploaded to the texture.
+typedef struct DebugView
+{
+    GLuint texture;
+    uint16_t width, height; // Pixels, multiples of 8
+    uint8_t* pixels; // RGB
+
+    // Contents the image was last drawn from
+    uint8_t vram[0x10000];
+    Color cram[0x40]; // The patterns view keeps its palette in the first 16 entries
+    uint64_t layout; // Where the tiles are read from (e.g. nametable and plane size)
+    bool drawn;
+
+    bool* dirty_tiles;
+    uint32_t dirty_count;
+} DebugView;
+
+// Needs a current OpenGL context
+DebugView* debug_view_make(uint16_t width, uint16_t height);
+void debug_view_free(DebugView*);
+
+// Bring the image and its texture up to date with the VDP
+
+// Every pattern in VRAM, one per tile, with the given 16 colors
+void debug_view_update_patterns(DebugView*, Vdp*, Color* palette);
+
+// The cells of a plane, one per tile
+void debug_view_update_plane(DebugView*, Vdp*, Planes);
+
+// The sprites at their raw coordinates (the screen starts at 128, 128),
+// redrawn as a whole when one of them changes
+void debug_view_update_sprites(DebugView*, Vdp*);
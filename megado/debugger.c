@@ -1,4 +1,3 @@
-#include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +6,8 @@
 #include "debugger.h"
 #include "m68k/bit_utils.h"
 #include "m68k/m68k.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
 #include "settings.h"
 #include "snapshot.h"
 
@@ -14,15 +15,13 @@ Debugger* debugger_make(Genesis* g)
 {
     Debugger* d = calloc(1, sizeof(Debugger));
     d->genesis = g;
+    d->rewind = rewind_buffer_make();
     return d;
 }
 
 void debugger_free(Debugger* d)
 {
-    for (int i=0; i < REWIND_BUFFER_LENGTH; ++i) {
-        free(d->rewinding_snapshots[i]);
-    }
-
+    rewind_buffer_free(d->rewind);
     free(d);
 }
 
@@ -36,6 +35,8 @@ void debugger_initialize(Debugger *d)
 
     memset(d->z80_log_instrs, 0, Z80_LOG_LENGTH * sizeof(d->z80_log_instrs[0]));
     d->z80_log_cursor = 0;
+
+    rewind_buffer_clear(d->rewind);
 }
 
 void debugger_preload(Debugger* d)
@@ -65,23 +66,14 @@ void debugger_post_z80(Debugger *d, const char* mnemonics, uint16_t address) {
 
 void debugger_post_frame(Debugger* d)
 {
-    // Regularly take snapshots
-    if (d->genesis->settings->rewinding_enabled)
-    {
-        double now = glfwGetTime();
-        if (now - d->rewinding_last_save >= REWIND_SAVE_INTERVAL)
-        {
-            d->rewinding_cursor = (d->rewinding_cursor + 1) % REWIND_BUFFER_LENGTH;
-
-            // Deallocate overwritten snapshots
-            if (d->rewinding_snapshots[d->rewinding_cursor] != NULL)
-                free(d->rewinding_snapshots[d->rewinding_cursor]);
+    // Frames emulated ahead are not part of the history
+    if (d->genesis->run_ahead->running)
+        return;
 
-            d->rewinding_snapshots[d->rewinding_cursor] = snapshot_take(d->genesis);
-
-            d->rewinding_last_save = now;
-        }
-    }
+    if (d->genesis->settings->rewinding_enabled)
+        rewind_buffer_push(d->rewind, d->genesis);
+    else
+        rewind_buffer_release(d->rewind);
 }
 
 void debugger_toggle_breakpoint(Debugger* d, uint32_t address)
@@ -117,24 +109,9 @@ Breakpoint* debugger_get_breakpoint(Debugger* d, uint32_t address)
 
 bool debugger_rewind(Debugger* d)
 {
-    double now = glfwGetTime();
-    if (now - d->rewinding_last_restore >= REWIND_PLAY_INTERVAL)
-    {
-        d->rewinding_cursor = UMOD(d->rewinding_cursor, REWIND_BUFFER_LENGTH);
-
-        Snapshot* snapshot = d->rewinding_snapshots[d->rewinding_cursor];
-        if (snapshot == NULL)
+    for (int i = 0; i < REWIND_PLAY_SPEED; ++i)
+        if (!rewind_buffer_pop(d->rewind, d->genesis))
             return false;
 
-        snapshot_restore(d->genesis, snapshot);
-
-        // Deallocate restored snapshots
-        free(snapshot);
-        d->rewinding_snapshots[d->rewinding_cursor] = NULL;
-
-        d->rewinding_last_restore = now;
-        d->rewinding_cursor--;
-    }
-
     return true;
 }
@@ -8,14 +8,13 @@
 
 #define BREAKPOINTS_COUNT 3
 
-#define REWIND_BUFFER_LENGTH 100
-#define REWIND_SAVE_INTERVAL 0.1
-#define REWIND_PLAY_INTERVAL 0.05
+// Number of frames stepped back per frame while rewinding
+#define REWIND_PLAY_SPEED 2
 
 struct DecodedInstruction;
 struct FullyDecodedZ80Instruction;
 struct Genesis;
-struct Snapshot;
+struct RewindBuffer;
 
 typedef struct Breakpoint
 {
@@ -58,11 +57,8 @@ typedef struct Debugger
     // Watchpoints
     // TODO
 
-    // Rewinding
-    struct Snapshot* rewinding_snapshots[REWIND_BUFFER_LENGTH];
-    int rewinding_cursor;
-    double rewinding_last_save;
-    double rewinding_last_restore;
+    // Rewinding (one state per frame)
+    struct RewindBuffer* rewind;
 
 } Debugger;
 
@@ -79,6 +75,6 @@ void debugger_post_frame(Debugger*);
 void debugger_toggle_breakpoint(Debugger*, uint32_t address);
 Breakpoint* debugger_get_breakpoint(Debugger*, uint32_t address);
 
-// Restores the most recent rewinding snapshot.
-// Returns false if there is no more snapshot no restore.
+// Steps back in the rewinding history.
+// Returns false if there is no more state to restore.
 bool debugger_rewind(Debugger* d);
@@ -0,0 +1,39 @@
+#include "audio.h"
+#include "desktop.h"
+#include "emulation_thread.h"
+#include "renderer.h"
+#include "settings.h"
+
+Genesis* desktop_make()
+{
+    Genesis* g = genesis_make_headless();
+    g->renderer = renderer_make(g);
+    g->audio = audio_make();
+    g->audio_sink = audio_sink(g->audio);
+    g->emulation = emulation_thread_make(g);
+
+    return g;
+}
+
+void desktop_free(Genesis* g)
+{
+    if (g == NULL)
+        return;
+
+    // Save the settings when quitting
+    settings_save(g->settings);
+
+    // Before anything it uses
+    emulation_thread_free(g->emulation);
+    g->emulation = NULL;
+
+    renderer_free(g->renderer);
+    audio_free(g->audio);
+
+    genesis_free(g);
+}
+
+void desktop_update(Genesis* g)
+{
+    renderer_render(g->renderer);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "genesis.h"
+
+// Desktop front-end
+//
+// A GLFW window with the debugger UI, an SDL audio device and the emulation
+// thread, plugged into a Genesis through its host services. Everything else
+// in megado/ is the core, which runs without them (see genesis_make_headless).
+
+// SDL audio must be initialized by the host beforehand
+Genesis* desktop_make();
+void desktop_free(Genesis*);
+
+// Present the last emulated frame and the UI, on the host thread
+void desktop_update(Genesis*);
@@ -0,0 +1,379 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulation_thread.h"
+#include "joypad.h"
+#include "m68k/m68k.h"
+#include "movie.h"
+#include "parallel_renderer.h"
+#include "render_pipeline.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
+#include "settings.h"
+#include "utils.h"
+#include "ym2612.h"
+#include "z80.h"
+
+#define QUEUE_MASK (COMMAND_QUEUE_LENGTH - 1)
+
+// Set in the triple buffer's middle index when it holds a view that was not picked up yet
+#define FRESH_VIEW 4
+
+// Emulation thread
+
+static void execute(EmulationThread* t, Command* c)
+{
+    Genesis* g = t->genesis;
+
+    switch (c->type)
+    {
+    case Command_TogglePause:
+        if (g->status == Status_Running)
+            g->status = Status_Pause;
+        else if (g->status == Status_Pause)
+            g->status = Status_Running;
+        break;
+
+    case Command_Step:
+        if (g->status == Status_Pause)
+            genesis_step(g);
+        break;
+
+    case Command_Reset:
+        movie_interrupt(g->movie, "reset");
+        genesis_initialize(g);
+        break;
+
+    case Command_StartRewinding:
+        if (g->settings->rewinding_enabled && g->status == Status_Running)
+        {
+            movie_interrupt(g->movie, "rewind");
+            g->status = Status_Rewinding;
+        }
+        break;
+
+    case Command_StopRewinding:
+        if (g->status == Status_Rewinding)
+            g->status = Status_Running;
+        break;
+
+    case Command_SaveSnapshot:
+        snapshot_metadata_free(t->snapshots[c->index]);
+        t->snapshots[c->index] = snapshot_save(g, c->index);
+        break;
+
+    case Command_LoadSnapshot:
+        movie_interrupt(g->movie, "snapshot load");
+        snapshot_load(g, c->index);
+        break;
+
+    case Command_ToggleBreakpoint:
+        debugger_toggle_breakpoint(g->debugger, c->address);
+        break;
+
+    case Command_SetBreakpoint:
+        g->debugger->breakpoints[c->index].enabled = c->enabled;
+        g->debugger->breakpoints[c->index].address = c->address;
+        break;
+
+    case Command_PressButton:
+        joypad_press(c->index == 0 ? g->joypad1 : g->joypad2, c->value);
+        break;
+
+    case Command_ReleaseButton:
+        joypad_release(c->index == 0 ? g->joypad1 : g->joypad2, c->value);
+        break;
+
+    case Command_MuteChannel:
+        g->ym2612->channels[c->index].muted = c->enabled;
+        break;
+
+    case Command_SetFrameskipInterval:
+        g->vdp->frameskip.mode = FrameSkipMode_Interval;
+        g->vdp->frameskip.interval = c->value;
+        break;
+
+    case Command_SetIncrementalRendering:
+        g->vdp->line_cache->enabled = c->enabled;
+        break;
+
+    case Command_SetRenderThreads:
+        vdp_set_render_threads(g->vdp, c->value);
+        break;
+
+    case Command_SetPipelinedRendering:
+        vdp_set_pipelined_rendering(g->vdp, c->enabled);
+        break;
+
+    case Command_Quit:
+        g->status = Status_Quitting;
+        break;
+    }
+}
+
+static void execute_commands(EmulationThread* t)
+{
+    int tail = SDL_AtomicGet(&t->tail);
+    int head = SDL_AtomicGet(&t->head);
+
+    while (tail != head)
+    {
+        execute(t, &t->queue[tail]);
+        tail = (tail + 1) & QUEUE_MASK;
+    }
+
+    SDL_AtomicSet(&t->tail, tail);
+}
+
+static void disassemble_m68k(Genesis* g, uint32_t address, DisassembledInstruction* out)
+{
+    out->address = address;
+    out->length = 0;
+    out->breakpoint = debugger_get_breakpoint(g->debugger, address) != NULL;
+
+    DecodedInstruction* instr = m68k_decode(g->m68k, address);
+    if (instr == NULL)
+        return;
+
+    out->length = instr->length < sizeof(out->bytes) ? instr->length : sizeof(out->bytes);
+    for (int i = 0; i < out->length; ++i)
+        out->bytes[i] = m68k_read_b(g->m68k, address + i);
+    snprintf(out->mnemonics, sizeof(out->mnemonics), "%s", instr->mnemonics);
+
+    decoded_instruction_free(instr);
+}
+
+static void disassemble_z80(Genesis* g, uint16_t address, DisassembledInstruction* out)
+{
+    out->address = address;
+    out->length = 0;
+    out->breakpoint = false;
+
+    FullyDecodedZ80Instruction* instr = z80_decode(g->z80, address);
+    if (instr == NULL)
+        return;
+
+    out->length = instr->length < sizeof(out->bytes) ? instr->length : sizeof(out->bytes);
+    for (int i = 0; i < out->length; ++i)
+        out->bytes[i] = z80_read(g->z80, address + i);
+    snprintf(out->mnemonics, sizeof(out->mnemonics), "%s", instr->mnemonics);
+
+    fully_decoded_z80_instruction_free(instr);
+}
+
+// Decode what the open debugger windows show
+static void fill_debugger(EmulationThread* t, EmulationView* v)
+{
+    Genesis* g = t->genesis;
+    Debugger* d = g->debugger;
+    Settings* settings = g->settings;
+
+    if (settings->show_m68k_disassembly)
+    {
+        uint32_t address = g->m68k->pc;
+        for (int i = 0; i < DISASSEMBLY_LENGTH; ++i)
+        {
+            disassemble_m68k(g, address, &v->m68k_disassembly[i]);
+            address += v->m68k_disassembly[i].length;
+        }
+    }
+
+    if (settings->show_m68k_log)
+    {
+        for (int i = 0; i < M68K_LOG_LENGTH; ++i)
+            disassemble_m68k(g, d->m68k_log_addresses[(d->m68k_log_cursor + 1 + i) % M68K_LOG_LENGTH], &v->m68k_log[i]);
+    }
+
+    if (settings->show_z80_disassembly)
+    {
+        uint16_t address = g->z80->pc;
+        for (int i = 0; i < DISASSEMBLY_LENGTH; ++i)
+        {
+            disassemble_z80(g, address, &v->z80_disassembly[i]);
+            address += v->z80_disassembly[i].length;
+        }
+    }
+
+    if (settings->show_z80_log)
+    {
+        for (int i = 0; i < Z80_LOG_LENGTH; ++i)
+            v->z80_log[i] = d->z80_log_instrs[(d->z80_log_cursor + 1 + i) % Z80_LOG_LENGTH];
+    }
+
+    memcpy(v->breakpoints, d->breakpoints, sizeof(v->breakpoints));
+}
+
+static void publish_view(EmulationThread* t, double emulation_time)
+{
+    Genesis* g = t->genesis;
+    EmulationView* v = t->views[t->back];
+
+    // The frame is already in, from the video sink
+    v->status = g->status;
+    snapshot_capture(g, &v->state);
+
+    // The breakpoints are only known once a game is loaded
+    if (g->status != Status_NoGameLoaded)
+        fill_debugger(t, v);
+
+    for (int i = 0; i < SNAPSHOT_SLOTS; ++i)
+        v->snapshot_dates[i] = t->snapshots[i] != NULL ? t->snapshots[i]->date : 0;
+
+    v->emulation_time = emulation_time;
+    v->audio_rate = g->audio_rate;
+    v->audio_remaining_time = g->remaining_time;
+
+    LineCache* line_cache = g->vdp->line_cache;
+    v->incremental_rendering = line_cache->enabled;
+    v->line_cache_hits = line_cache->hits;
+    v->line_cache_misses = line_cache->misses;
+
+    ParallelRenderer* parallel = g->vdp->parallel;
+    v->render_threads = parallel != NULL ? parallel->worker_count : 0;
+    if (parallel != NULL)
+    {
+        v->parallel_frame_time = parallel->frame_time;
+        v->parallel_log_length = parallel->frame_log_length;
+    }
+
+    RenderPipeline* pipeline = g->vdp->pipeline;
+    v->pipelined = pipeline != NULL;
+    if (pipeline != NULL)
+    {
+        v->render_queue_depth = render_pipeline_queue_depth(pipeline);
+        v->render_latency = pipeline->latency;
+        v->render_time_saved = pipeline->frame_render_time - pipeline->frame_stall_time;
+    }
+
+    RunAhead* run_ahead = g->run_ahead;
+    v->run_ahead_frame_time = run_ahead->frame_time;
+    v->run_ahead_capture_time = run_ahead->capture_time;
+    v->run_ahead_restore_time = run_ahead->restore_time;
+
+    RewindBuffer* rewind = g->debugger->rewind;
+    v->rewind_frame_count = rewind->frame_count;
+    v->rewind_used_bytes = rewind->used_bytes;
+    v->rewind_capture_time = rewind->capture_time;
+
+    t->back = SDL_AtomicSet(&t->middle, t->back | FRESH_VIEW) & 3;
+}
+
+static int emulation_thread_run(void* data)
+{
+    EmulationThread* t = data;
+
+    while (!SDL_AtomicGet(&t->stopping))
+    {
+        execute_commands(t);
+
+        uint64_t start = SDL_GetPerformanceCounter();
+        double wait = genesis_emulate(t->genesis);
+        double emulation_time = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+        publish_view(t, emulation_time);
+
+        // Sleep until the next frame is due, the requests that came in the
+        // meantime are applied right before it. When running late, carry on
+        // right away
+        if (wait > 0)
+            SDL_Delay((Uint32)ceil(wait * 1000));
+    }
+
+    return 0;
+}
+
+// Video sink: genesis_emulate hands over the frame right before the view is published
+static void present(void* context, const uint8_t* pixels, uint16_t width, uint16_t height)
+{
+    EmulationThread* t = context;
+    EmulationView* v = t->views[t->back];
+
+    memcpy(v->output_buffer, pixels, BUFFER_SIZE);
+    v->output_width = width;
+    v->output_height = height;
+}
+
+EmulationThread* emulation_thread_make(Genesis* g)
+{
+    EmulationThread* t = calloc(1, sizeof(EmulationThread));
+    t->genesis = g;
+
+    for (int i = 0; i < 3; ++i)
+        t->views[i] = calloc(1, sizeof(EmulationView));
+
+    t->back = 0;
+    t->front = 2;
+    SDL_AtomicSet(&t->middle, 1);
+
+    g->video = (VideoSink) { present, t };
+
+    emulation_thread_start(t);
+
+    return t;
+}
+
+void emulation_thread_free(EmulationThread* t)
+{
+    if (t == NULL)
+        return;
+
+    emulation_thread_stop(t);
+
+    for (int i = 0; i < 3; ++i)
+        free(t->views[i]);
+
+    for (int i = 0; i < SNAPSHOT_SLOTS; ++i)
+        snapshot_metadata_free(t->snapshots[i]);
+
+    free(t);
+}
+
+void emulation_thread_stop(EmulationThread* t)
+{
+    if (t->thread == NULL)
+        return;
+
+    SDL_AtomicSet(&t->stopping, 1);
+    SDL_WaitThread(t->thread, NULL);
+    t->thread = NULL;
+}
+
+void emulation_thread_start(EmulationThread* t)
+{
+    if (t->thread != NULL)
+        return;
+
+    SDL_AtomicSet(&t->stopping, 0);
+    t->thread = SDL_CreateThread(emulation_thread_run, "emulation", t);
+    if (t->thread == NULL)
+        FATAL("Cannot create emulation thread: %s", SDL_GetError());
+}
+
+// UI thread
+
+void emulation_thread_send(EmulationThread* t, Command c)
+{
+    int head = SDL_AtomicGet(&t->head);
+    int next = (head + 1) & QUEUE_MASK;
+
+    // The UI never waits for the emulation
+    if (next == SDL_AtomicGet(&t->tail))
+    {
+        printf("Warning, the command queue is full, dropping command %d\n", c.type);
+        return;
+    }
+
+    t->queue[head] = c;
+    SDL_AtomicSet(&t->head, next);
+}
+
+EmulationView* emulation_thread_view(EmulationThread* t)
+{
+    // Pick up the last view published by the emulation thread, if any
+    if (SDL_AtomicGet(&t->middle) & FRESH_VIEW)
+        t->front = SDL_AtomicSet(&t->middle, t->front) & 3;
+
+    return t->views[t->front];
+}
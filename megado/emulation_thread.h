@@ -0,0 +1,141 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "debugger.h"
+#include "genesis.h"
+#include "snapshot.h"
+#include "vdp.h"
+
+// Must be a power of two
+#define COMMAND_QUEUE_LENGTH 64
+
+// Instructions disassembled from the program counter
+#define DISASSEMBLY_LENGTH 10
+
+// Requests from the UI, applied by the emulation thread between frames
+typedef enum
+{
+    Command_TogglePause,
+    Command_Step,
+    Command_Reset,
+    Command_StartRewinding,
+    Command_StopRewinding,
+    Command_SaveSnapshot, // index: slot
+    Command_LoadSnapshot, // index: slot
+    Command_ToggleBreakpoint, // address
+    Command_SetBreakpoint, // index: breakpoint, enabled, address
+    Command_PressButton, // index: joypad (0 or 1), value: JoypadButton
+    Command_ReleaseButton, // index: joypad (0 or 1), value: JoypadButton
+    Command_MuteChannel, // index: YM2612 channel, enabled: muted
+    Command_SetFrameskipInterval, // value
+    Command_SetIncrementalRendering, // enabled
+    Command_SetRenderThreads, // value
+    Command_SetPipelinedRendering, // enabled
+    Command_Quit
+} CommandType;
+
+typedef struct Command
+{
+    CommandType type;
+    int index;
+    int value;
+    uint32_t address;
+    bool enabled;
+} Command;
+
+typedef struct DisassembledInstruction
+{
+    uint32_t address;
+    uint8_t length; // 0 when the memory does not hold a valid opcode
+    uint8_t bytes[10];
+    char mnemonics[50];
+    bool breakpoint;
+} DisassembledInstruction;
+
+// State of the emulator as of the end of a frame, for the UI to display.
+// The debugger lists are only filled while their window is open.
+typedef struct EmulationView
+{
+    Status status;
+
+    // Components, by value: their pointers are not to be followed, apart
+    // from the VDP's genesis (see vdp_get_resolution)
+    Snapshot state;
+
+    uint8_t output_buffer[BUFFER_SIZE];
+    uint16_t output_width, output_height;
+
+    // Debugger
+    DisassembledInstruction m68k_disassembly[DISASSEMBLY_LENGTH];
+    DisassembledInstruction m68k_log[M68K_LOG_LENGTH]; // Oldest first
+    DisassembledInstruction z80_disassembly[DISASSEMBLY_LENGTH];
+    LoggedZ80Instruction z80_log[Z80_LOG_LENGTH]; // Oldest first
+    Breakpoint breakpoints[BREAKPOINTS_COUNT];
+    time_t snapshot_dates[SNAPSHOT_SLOTS]; // 0 for the empty slots
+
+    // Metrics
+    double emulation_time; // Spent in the last update (s)
+    double audio_rate;
+    double audio_remaining_time;
+    bool incremental_rendering;
+    uint64_t line_cache_hits, line_cache_misses;
+    int render_threads; // 0 without parallel rendering
+    double parallel_frame_time;
+    uint32_t parallel_log_length;
+    bool pipelined;
+    uint32_t render_queue_depth;
+    double render_latency, render_time_saved;
+    double run_ahead_frame_time, run_ahead_capture_time, run_ahead_restore_time;
+    uint32_t rewind_frame_count, rewind_used_bytes;
+    double rewind_capture_time;
+} EmulationView;
+
+// Emulation thread
+//
+// The game runs on its own thread, paced by the host clock, so that building
+// and drawing the UI never takes time from it. The UI thread only sees the
+// views published at the end of each update, through a triple buffer, and
+// sends its requests through a lock-free single-producer/single-consumer
+// queue. Neither thread waits for the other.
+//
+// The settings are the exception: the UI changes them in place and the
+// emulation picks them up at its next update.
+typedef struct EmulationThread
+{
+    Genesis* genesis;
+
+    SDL_Thread* thread;
+    SDL_atomic_t stopping;
+
+    // UI thread -> emulation thread
+    Command queue[COMMAND_QUEUE_LENGTH];
+    SDL_atomic_t head; // Written by the UI thread
+    SDL_atomic_t tail; // Written by the emulation thread
+
+    // Triple buffer: the emulation thread owns `back`, the UI thread owns
+    // `front` and `middle` holds the last published view
+    EmulationView* views[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+
+    // Emulation thread
+    SnapshotMetadata* snapshots[SNAPSHOT_SLOTS];
+} EmulationThread;
+
+// The thread starts right away, and becomes the instance's video sink
+EmulationThread* emulation_thread_make(Genesis*);
+void emulation_thread_free(EmulationThread*);
+
+// Wait for the thread to finish its update and leave the emulator to the
+// caller (e.g. to load a game), until emulation_thread_start
+void emulation_thread_stop(EmulationThread*);
+void emulation_thread_start(EmulationThread*);
+
+// UI thread
+void emulation_thread_send(EmulationThread*, Command);
+EmulationView* emulation_thread_view(EmulationThread*); // The last view published
@@ -0,0 +1,129 @@
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define FRAME_HASH_SSE
+#endif
+
+// The vector loads read the words in the host order, the scalar path in little-endian order
+#if (defined(__AVX2__) || defined(FRAME_HASH_SSE)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The SIMD frame hash expects a little-endian host"
+#endif
+
+#include "frame_hash.h"
+#include "genesis.h"
+#include "vdp.h"
+
+// The data is hashed in blocks of 32 words, one per lane. The lanes are
+// independent so that they fill the vector units, and only folded together at
+// the end.
+#define LANES 32
+#define BLOCK_SIZE (LANES * 4)
+
+static const uint32_t PRIME32 = 0x9E3779B1;
+static const uint64_t PRIME64 = 0x9E3779B97F4A7C15;
+
+#define ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+static const char* const COMPONENT_NAMES[FRAME_HASH_COMPONENTS] = { "output", "work RAM", "VRAM" };
+
+// Lane step: h = rotl((h ^ word) * PRIME32, 15)
+static void hash_blocks(uint32_t* lanes, const uint8_t* data, uint32_t blocks)
+{
+#if defined(__AVX2__)
+    const __m256i prime = _mm256_set1_epi32(PRIME32);
+    __m256i h[LANES / 8];
+    for (int i = 0; i < LANES / 8; ++i)
+        h[i] = _mm256_loadu_si256((const __m256i*)(lanes + i * 8));
+
+    for (uint32_t b = 0; b < blocks; ++b, data += BLOCK_SIZE)
+    {
+        for (int i = 0; i < LANES / 8; ++i)
+        {
+            __m256i x = _mm256_mullo_epi32(_mm256_xor_si256(h[i], _mm256_loadu_si256((const __m256i*)(data + i * 32))), prime);
+            h[i] = _mm256_or_si256(_mm256_slli_epi32(x, 15), _mm256_srli_epi32(x, 17));
+        }
+    }
+
+    for (int i = 0; i < LANES / 8; ++i)
+        _mm256_storeu_si256((__m256i*)(lanes + i * 8), h[i]);
+#elif defined(FRAME_HASH_SSE)
+    const __m128i prime = _mm_set1_epi32(PRIME32);
+    __m128i h[LANES / 4];
+    for (int i = 0; i < LANES / 4; ++i)
+        h[i] = _mm_loadu_si128((const __m128i*)(lanes + i * 4));
+
+    for (uint32_t b = 0; b < blocks; ++b, data += BLOCK_SIZE)
+    {
+        for (int i = 0; i < LANES / 4; ++i)
+        {
+            __m128i x = _mm_mullo_epi32(_mm_xor_si128(h[i], _mm_loadu_si128((const __m128i*)(data + i * 16))), prime);
+            h[i] = _mm_or_si128(_mm_slli_epi32(x, 15), _mm_srli_epi32(x, 17));
+        }
+    }
+
+    for (int i = 0; i < LANES / 4; ++i)
+        _mm_storeu_si128((__m128i*)(lanes + i * 4), h[i]);
+#else
+    for (uint32_t b = 0; b < blocks; ++b, data += BLOCK_SIZE)
+    {
+        for (int i = 0; i < LANES; ++i)
+        {
+            // Little-endian words, as the vector loads above
+            const uint8_t* w = data + i * 4;
+            uint32_t x = (lanes[i] ^ (w[0] | w[1] << 8 | w[2] << 16 | (uint32_t)w[3] << 24)) * PRIME32;
+            lanes[i] = ROTL32(x, 15);
+        }
+    }
+#endif
+}
+
+uint64_t frame_hash_bytes(const uint8_t* data, uint32_t length)
+{
+    uint32_t lanes[LANES];
+    for (int i = 0; i < LANES; ++i)
+        lanes[i] = PRIME32 * (i + 1);
+
+    uint32_t blocks = length / BLOCK_SIZE;
+    hash_blocks(lanes, data, blocks);
+
+    // The rest is padded with zeros into a last block, the length tells
+    // the padding apart from the data
+    uint32_t rest = length - blocks * BLOCK_SIZE;
+    if (rest > 0)
+    {
+        uint8_t last[BLOCK_SIZE] = { 0 };
+        memcpy(last, data + blocks * BLOCK_SIZE, rest);
+        hash_blocks(lanes, last, 1);
+    }
+
+    uint64_t h = length * PRIME64;
+    for (int i = 0; i < LANES; ++i)
+    {
+        h = (h ^ lanes[i]) * PRIME64;
+        h ^= h >> 29;
+    }
+
+    // Final avalanche (splitmix64)
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EB;
+    h ^= h >> 31;
+
+    return h;
+}
+
+void frame_hash(Genesis* g, FrameHash* hash)
+{
+    hash->components[FrameHash_Output] = frame_hash_bytes(g->vdp->output_buffer, BUFFER_SIZE);
+    hash->components[FrameHash_WorkRam] = frame_hash_bytes(g->ram, 0x10000);
+    hash->components[FrameHash_Vram] = frame_hash_bytes(g->vdp->vram, sizeof(g->vdp->vram));
+}
+
+const char* frame_hash_component_name(FrameHashComponents component)
+{
+    return COMPONENT_NAMES[component];
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+struct Genesis;
+
+// Per-frame hashes
+//
+// Tell whether a change to the emulator alters what the games do, frame by
+// frame: the hashes of a run are compared to golden ones (see regression/).
+// The hash is not cryptographic, it is meant to be fast enough to run after
+// every frame. It gives the same values with or without SIMD, on any little
+// or big-endian host.
+
+typedef enum
+{
+    FrameHash_Output, // The frame, as drawn into the VDP's output buffer
+    FrameHash_WorkRam,
+    FrameHash_Vram,
+    FRAME_HASH_COMPONENTS
+} FrameHashComponents;
+
+typedef struct FrameHash
+{
+    uint64_t components[FRAME_HASH_COMPONENTS];
+} FrameHash;
+
+uint64_t frame_hash_bytes(const uint8_t* data, uint32_t length);
+
+void frame_hash(struct Genesis*, FrameHash*);
+
+const char* frame_hash_component_name(FrameHashComponents);
@@ -1,17 +1,27 @@
-#include <GLFW/glfw3.h>
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "audio.h"
 #include "debugger.h"
+#include "emulation_thread.h"
 #include "genesis.h"
 #include "joypad.h"
 #include "m68k/m68k.h"
 #include "m68k/instruction.h"
-#include "renderer.h"
+#include "movie.h"
+#include "run_ahead.h"
 #include "settings.h"
 #include "snapshot.h"
+#include "sound.h"
 #include "vdp.h"
 #include "psg.h"
 #include "utils.h"
@@ -20,49 +30,155 @@
 static const uint32_t NTSC_MASTER_FREQUENCY = 53693175;
 static const uint32_t PAL_MASTER_FREQUENCY  = 53203424;
 
-Genesis* genesis_make()
+static const uint32_t MASTER_CYCLES_PER_LINE = 3420;
+static const uint32_t NTSC_LINES_PER_FRAME = 262;
+static const uint32_t PAL_LINES_PER_FRAME = 312;
+
+// Host frames this close to the emulated frame duration run exactly one
+// frame, the audio rate control absorbs the difference
+static const double FRAME_LOCK_TOLERANCE = 0.02;
+
+// Emulation that cannot keep up is not caught up beyond that many frames
+static const double MAX_LATE_FRAMES = 4;
+
+static const uint32_t ROM_WINDOW_SIZE = 0x400000;
+static const uint32_t ROM_HEADER_END = 0x200;
+
+Genesis* genesis_make_headless()
 {
     Genesis* g = calloc(1, sizeof(Genesis));
     g->settings = settings_make();
-    g->rom = calloc(0x400000, sizeof(uint8_t));
     g->ram = calloc(0x10000, sizeof(uint8_t));
     g->m68k = m68k_make(g);
     g->z80 = z80_make(g);
     g->vdp = vdp_make(g);
     g->psg = psg_make(g);
     g->ym2612 = ym2612_make(g);
+    g->sound = sound_make(g->psg, g->ym2612, (double)NTSC_MASTER_FREQUENCY / SAMPLE_RATE);
     g->joypad1 = joypad_make();
     g->joypad2 = joypad_make();
-    g->renderer = renderer_make(g);
-    g->audio = audio_make(g);
+    g->movie = movie_make();
     g->debugger = debugger_make(g);
+    g->run_ahead = run_ahead_make();
     g->status = Status_NoGameLoaded;
 
+    g->clock = system_clock;
+    g->video = null_video_sink;
+    g->audio_sink = null_audio_sink;
+    g->audio_rate = 1;
+
     return g;
 }
 
+static void release_rom(Genesis* g)
+{
+    if (g->rom_mapped)
+    {
+#ifndef _WIN32
+        munmap(g->rom, g->rom_size);
+#endif
+    }
+    else if (!g->rom_shared)
+        free(g->rom);
+
+    g->rom = NULL;
+    g->rom_size = 0;
+    g->rom_mask = 0;
+    g->rom_shared = false;
+    g->rom_mapped = false;
+}
+
+static void set_rom_size(Genesis* g, uint32_t size)
+{
+    g->rom_size = size;
+
+    // Cartridges do not decode the address lines above their size
+    // so the ROM shows up again every power of two
+    uint32_t mirror = 1;
+    while (mirror < size && mirror < ROM_WINDOW_SIZE)
+        mirror <<= 1;
+
+    g->rom_mask = mirror - 1;
+}
+
+// Map the ROM file read-only: all the instances running the same game,
+// in this process or in others, share the same physical pages
+static bool map_rom(Genesis* g, const char* path)
+{
+#ifdef _WIN32
+    return false;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat stats;
+    if (fstat(fd, &stats) != 0 || stats.st_size < ROM_HEADER_END)
+    {
+        close(fd);
+        return false;
+    }
+
+    uint32_t size = stats.st_size < ROM_WINDOW_SIZE ? stats.st_size : ROM_WINDOW_SIZE;
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    g->rom = data;
+    g->rom_mapped = true;
+    set_rom_size(g, size);
+
+    return true;
+#endif
+}
+
+// Copy the ROM file into memory, when it cannot be mapped
+static void read_rom(Genesis* g, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        FATAL("Cannot read file \"%s\"", path);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint32_t size = file_length < ROM_WINDOW_SIZE ? file_length : ROM_WINDOW_SIZE;
+
+    // Tiny images are padded so that the header can always be read
+    g->rom = calloc(size > ROM_HEADER_END ? size : ROM_HEADER_END, sizeof(uint8_t));
+    fread(g->rom, sizeof(uint8_t), size, file);
+    fclose(file);
+
+    set_rom_size(g, size > ROM_HEADER_END ? size : ROM_HEADER_END);
+}
+
 void genesis_free(Genesis* g)
 {
     if (g == NULL)
         return;
 
-    // Save the settings when quitting
-    // TODO not the best place to that, should rather be in quit() or deinit() or something
-    settings_save(g->settings);
+    // Before anything it uses
+    emulation_thread_free(g->emulation);
 
     m68k_free(g->m68k);
     z80_free(g->z80);
     vdp_free(g->vdp);
     psg_free(g->psg);
     ym2612_free(g->ym2612);
+    sound_free(g->sound);
     joypad_free(g->joypad1);
     joypad_free(g->joypad2);
+    movie_free(g->movie);
     settings_free(g->settings);
-    renderer_free(g->renderer);
-    audio_free(g->audio);
     debugger_free(g->debugger);
+    run_ahead_free(g->run_ahead);
 
-    free(g->rom);
+    release_rom(g);
     free(g->ram);
     free(g->sram);
     free(g);
@@ -78,39 +194,15 @@ static void print_header_info(char* label, uint8_t* data, uint8_t length)
     free(string);
 }
 
-void genesis_load_rom_file(Genesis* g, const char* path)
+// Set up the system for the ROM that was just loaded
+static void start_game(Genesis* g)
 {
-    printf("Opening %s...\n", path);
-
-    FILE* file = fopen(path, "rb");
-    if (!file)
-    {
-        FATAL("Cannot read file \"%s\"", path);
-    }
-
-    // Load the ROM into memory
-    fseek(file, 0, SEEK_END);
-    int file_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    fread(g->rom, sizeof(uint8_t), file_length, file);
-    fclose(file);
-
     genesis_initialize(g);
-
-    // Display info from the ROM header
-    printf("----------------\n");
-    print_header_info("", g->rom + 0x100, 16);
-    print_header_info("", g->rom + 0x110, 16);
-    print_header_info("[Domestic title]", g->rom + 0x120, 48);
-    print_header_info("[International title]", g->rom + 0x150, 48);
-    print_header_info("[Serial number]", g->rom + 0x180, 14);
-    print_header_info("[Country]", g->rom + 0x1F0, 8);
-    printf("%06x - %06x                                  [ROM]\n", 0, g->rom_end);
-    printf("%06x - %06x                                  [SRAM]\n", g->sram_start, g->sram_end);
-    printf("----------------\n");
+    movie_stop(g->movie);
 
     // Look for snapshots/breakpoints for this game
-    snapshots_preload(g, g->renderer->snapshots);
+    if (g->emulation != NULL)
+        snapshots_preload(g, g->emulation->snapshots);
     debugger_preload(g->debugger);
 
     // Set the system region depending on the country code of the game
@@ -143,9 +235,53 @@ void genesis_load_rom_file(Genesis* g, const char* path)
     }
     }
 
+    g->sound->cycles_per_sample = (double)genesis_master_frequency(g) / SAMPLE_RATE;
+
     g->status = Status_Running;
 }
 
+void genesis_load_rom_file(Genesis* g, const char* path)
+{
+    printf("Opening %s...\n", path);
+
+    // The emulation thread must not run while the game changes
+    if (g->emulation != NULL)
+        emulation_thread_stop(g->emulation);
+
+    release_rom(g);
+    if (!map_rom(g, path))
+        read_rom(g, path);
+
+    start_game(g);
+
+    // Display info from the ROM header
+    printf("----------------\n");
+    print_header_info("", g->rom + 0x100, 16);
+    print_header_info("", g->rom + 0x110, 16);
+    print_header_info("[Domestic title]", g->rom + 0x120, 48);
+    print_header_info("[International title]", g->rom + 0x150, 48);
+    print_header_info("[Serial number]", g->rom + 0x180, 14);
+    print_header_info("[Country]", g->rom + 0x1F0, 8);
+    printf("%06x - %06x                                  [ROM]\n", 0, g->rom_end);
+    if (g->sram != NULL)
+        printf("%06x - %06x                                  [SRAM]\n", g->sram_start, g->sram_end);
+    printf("----------------\n");
+
+    if (g->emulation != NULL)
+        emulation_thread_start(g->emulation);
+}
+
+void genesis_share_rom(Genesis* g, Genesis* source)
+{
+    release_rom(g);
+
+    g->rom = source->rom;
+    g->rom_shared = true;
+    set_rom_size(g, source->rom_size);
+
+    start_game(g);
+}
+
 struct DecodedInstruction* genesis_decode(Genesis* g, uint32_t pc)
 {
     printf(".%p %p.\n", g, g->m68k);
@@ -171,16 +307,40 @@ void genesis_initialize(Genesis* g)
     vdp_initialize(g->vdp);
     psg_initialize(g->psg);
     ym2612_initialize(g->ym2612);
+    sound_clear(g->sound);
     debugger_initialize(g->debugger);
-    audio_initialize(g->audio);
 
-    g->sram = calloc(g->sram_end - g->sram_start, sizeof(uint8_t));
+    g->remaining_time = 0;
+    g->audio_rate = 1;
+    g->audio_sink.clear(g->audio_sink.context);
+
+    // Only cartridges declaring "RA" have battery-backed RAM,
+    // otherwise the fields can hold anything (e.g. the work RAM range)
+    free(g->sram);
+    g->sram = NULL;
+
+    if (g->rom[0x1b0] == 'R' && g->rom[0x1b1] == 'A' && g->sram_end > g->sram_start)
+    {
+        g->sram = calloc(g->sram_end - g->sram_start, sizeof(uint8_t));
+    }
+    else
+    {
+        // Empty range, never matched by the memory accesses
+        g->sram_start = 0xFFFFFFFF;
+        g->sram_end = 0;
+    }
 }
 
 uint32_t genesis_master_frequency(Genesis* g) {
     return g->region == Region_Europe ? PAL_MASTER_FREQUENCY : NTSC_MASTER_FREQUENCY;
 }
 
+uint32_t genesis_slice_cycles(Genesis* g) {
+    // The M68k runs its slice first, then the Z80 runs the same one:
+    // only one of them is inside its slice at a time
+    return g->m68k->slice_cycles + g->z80->slice_cycles;
+}
+
 void genesis_step(Genesis* g)
 {
     // Run for one instruction
@@ -200,8 +360,30 @@ void genesis_step(Genesis* g)
     // Let other systems catch up
     uint32_t master_cycles = cycles * 7;
     z80_run_cycles(g->z80, master_cycles);
-    psg_run_cycles(g->psg, master_cycles);
-    ym2612_run_cycles(g->ym2612, master_cycles);
+    sound_advance(g->sound, master_cycles);
+}
+
+// Same as the loop below, timing each subsystem
+static uint32_t run_subsystems_profiled(Genesis* g, double cycles) {
+    HostClock* clock = &g->clock;
+    double* time = g->subsystem_time;
+
+    double start = clock->now(clock->context);
+    uint32_t actual_cycles = m68k_run_cycles(g->m68k, cycles);
+    double m68k_end = clock->now(clock->context);
+    z80_run_cycles(g->z80, actual_cycles);
+    double z80_end = clock->now(clock->context);
+    sound_advance(g->sound, actual_cycles);
+    double sound_end = clock->now(clock->context);
+    vdp_run_cycles(g->vdp, actual_cycles);
+    double vdp_end = clock->now(clock->context);
+
+    time[Subsystem_M68k] += m68k_end - start;
+    time[Subsystem_Z80] += z80_end - m68k_end;
+    time[Subsystem_Sound] += sound_end - z80_end;
+    time[Subsystem_Vdp] += vdp_end - sound_end;
+
+    return actual_cycles;
 }
 
 // Run for a given number of master cycles
@@ -211,14 +393,20 @@ static void genesis_run_cycles(Genesis* g, double cycles) {
     g->remaining_cycles += cycles;
 
     while (g->remaining_cycles > 0) {
-        // The m68k can halt prematurely due to breakpoint
-        uint32_t actual_cycles = m68k_run_cycles(g->m68k, cycles);
+        uint32_t actual_cycles;
 
-        // Let the other systems catch up
-        z80_run_cycles(g->z80, actual_cycles);
-        psg_run_cycles(g->psg, actual_cycles);
-        ym2612_run_cycles(g->ym2612, actual_cycles);
-        vdp_run_cycles(g->vdp, actual_cycles);
+        if (g->profiling) {
+            actual_cycles = run_subsystems_profiled(g, cycles);
+        }
+        else {
+            // The m68k can halt prematurely due to breakpoint
+            actual_cycles = m68k_run_cycles(g->m68k, cycles);
+
+            // Let the other systems catch up
+            z80_run_cycles(g->z80, actual_cycles);
+            sound_advance(g->sound, actual_cycles); // The sound chips run when the samples are rendered
+            vdp_run_cycles(g->vdp, actual_cycles);
+        }
 
         g->remaining_cycles -= actual_cycles;
 
@@ -229,42 +417,81 @@ static void genesis_run_cycles(Genesis* g, double cycles) {
     }
 }
 
-void genesis_update(Genesis* g)
+void genesis_run_frame(Genesis* g)
+{
+    FrameSkip* f = &g->vdp->frameskip;
+    uint64_t frame = f->rendered_frames + f->skipped_frames;
+
+    // Only the real frames, not the ones run ahead, take the movie's inputs
+    if (!g->run_ahead->running)
+        movie_frame(g->movie, g);
+
+    // One line at a time, until the last visible line is drawn: the output
+    // buffer then holds the whole frame, and nothing of the next one
+    while (f->rendered_frames + f->skipped_frames == frame && g->status == Status_Running)
+        genesis_run_cycles(g, MASTER_CYCLES_PER_LINE);
+
+    // The frames run ahead are undone: they only queue their writes,
+    // rendering them would take the output streams ahead too
+    if (g->run_ahead->running)
+        return;
+
+    // The samples are kept until read with sound_read
+    if (g->profiling) {
+        double start = g->clock.now(g->clock.context);
+        sound_render(g->sound);
+        g->subsystem_time[Subsystem_Sound] += g->clock.now(g->clock.context) - start;
+    }
+    else
+        sound_render(g->sound);
+}
+
+// Wall time of an emulated frame, at the current speed (s)
+static double frame_duration(Genesis* g)
+{
+    uint32_t lines = g->region == Region_Europe ? PAL_LINES_PER_FRAME : NTSC_LINES_PER_FRAME;
+    return (double)lines * MASTER_CYCLES_PER_LINE / genesis_master_frequency(g) / g->settings->emulation_speed;
+}
+
+double genesis_emulate(Genesis* g)
 {
     // dt is wall time in seconds elapsed since last update
-    static double last_update = 0;
-    double now = glfwGetTime();
-    double dt = now - last_update;
-    last_update = now;
+    double now = g->clock.now(g->clock.context);
+    double dt = g->last_update > 0 ? now - g->last_update : 0;
+    g->last_update = now;
 
     // Schedule the end of this frame from the previous frame time
     // (with some slack for overhead)
     double max_time = now + dt - (dt / 10);
 
+    // Lock to the display when it refreshes at about the emulated rate,
+    // for every host frame to show a new emulated one
+    double frame = frame_duration(g);
+    if (fabs(dt - frame) < frame * FRAME_LOCK_TOLERANCE)
+        dt = frame;
+
+    // Only the displayed frames are drawn when running ahead
+    int run_ahead_frames = g->status == Status_Running ? g->settings->run_ahead_frames : 0;
+    if (run_ahead_frames > 0)
+        run_ahead_begin_frame(g->run_ahead, g);
+
     if (g->status == Status_Running)
     {
-        // Emulate by slices of audio sample
-        g->audio->remaining_time += dt;
-        double time_slice = (double)1 / SAMPLE_RATE;
-
-        // How many Genesis seconds we need to emulate, depending on speed factor
-        double dt_genesis = time_slice * g->settings->emulation_speed;
-        // Convert the duration to master cycles
-        double d_cycles = dt_genesis * genesis_master_frequency(g);
-
-        while (g->audio->remaining_time > 0) {
-            // Emulate enough for one audio sample
-            genesis_run_cycles(g, d_cycles);
-
-            // Sample the audio units
-            // @Temporary: use left channel for PSG and right channel for YM2612
-            int16_t sample[2] = {psg_mix(g->psg), ym2612_mix(g->ym2612)};
-            // Queue samples to audio device
-            if (g->audio->device > 0 && SDL_QueueAudio(g->audio->device, sample, 2 * sizeof(int16_t)) != 0) {
-                fprintf(stderr, "Failed to queue audio: %s", SDL_GetError());
-            }
+        // Emulate by whole frames
+        g->remaining_time += dt;
+        if (g->remaining_time > frame * MAX_LATE_FRAMES)
+            g->remaining_time = frame * MAX_LATE_FRAMES;
+
+        // Master cycles per audio sample, depending on speed factor, and
+        // slightly off to keep the audio sink at its target fill
+        g->audio_rate = g->audio_sink.rate_control(g->audio_sink.context);
+        g->sound->cycles_per_sample = (double)genesis_master_frequency(g) * g->settings->emulation_speed / SAMPLE_RATE
+            * g->audio_rate;
 
-            g->audio->remaining_time -= time_slice;
+        while (g->remaining_time > 0) {
+            genesis_run_frame(g);
+
+            g->remaining_time -= frame;
 
             // Exit early on breakpoint
             if (g->status != Status_Running) {
@@ -272,10 +499,16 @@ void genesis_update(Genesis* g)
             }
 
             // If we are taking longer than the allocated time, abort
-            if (glfwGetTime() > max_time) {
+            if (g->clock.now(g->clock.context) > max_time) {
                 break;
             }
         }
+
+        // genesis_run_frame renders the audio of each frame
+        int16_t samples[SOUND_BLOCK_LENGTH * 2];
+        uint32_t count;
+        while ((count = sound_read(g->sound, samples, SOUND_BLOCK_LENGTH)) > 0)
+            g->audio_sink.queue(g->audio_sink.context, samples, count);
     }
     else if (g->status == Status_Rewinding)
     {
@@ -286,12 +519,28 @@ void genesis_update(Genesis* g)
         vdp_draw_screen(g->vdp);
     }
 
-    renderer_render(g->renderer);
-    audio_update(g->audio);
+    // Display a frame from the future
+    if (run_ahead_frames > 0)
+        run_ahead_end_frame(g->run_ahead, g, run_ahead_frames);
+
+    g->audio_sink.set_playing(g->audio_sink.context, g->status == Status_Running);
+
+    uint16_t width, height;
+    vdp_get_resolution(g->vdp, &width, &height);
+    g->video.present(g->video.context, g->vdp->output_buffer, width, height);
+
+    // Rewinding and pausing go at the pace of the frames too
+    return g->status == Status_Running ? -g->remaining_time : frame;
 }
 
 void genesis_get_rom_name(Genesis* g, char* name)
 {
+    if (g->rom == NULL)
+    {
+        name[0] = '\0';
+        return;
+    }
+
     // Get the international title from the header
     strncpy(name, (char*)(g->rom + 0x150), 48);
 
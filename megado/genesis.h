@@ -3,12 +3,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "host.h"
+
 struct Debugger;
 struct DecodedInstruction;
+struct EmulationThread;
 struct Joypad;
 struct M68k;
+struct Movie;
 struct Z80;
 struct Renderer;
+struct RunAhead;
 struct Audio;
 struct Settings;
 struct Vdp;
@@ -29,11 +34,32 @@ typedef enum {
     Region_USA
 } Regions;
 
+// Parts of the emulation timed when profiling
+typedef enum {
+    Subsystem_M68k,
+    Subsystem_Z80,
+    Subsystem_Vdp,
+    Subsystem_Sound,
+    SUBSYSTEM_COUNT
+} Subsystems;
+
 typedef struct Genesis
 {
     double remaining_cycles;
+    double last_update; // Host time of the previous update (s)
+    double remaining_time; // Host time left to emulate, frames run while it is positive (s)
+    double audio_rate; // Last factor from the audio sink's rate control
+
+    // Host time spent in each subsystem (s), from the clock. Only measured
+    // when profiling is set, since it reads the clock a few times per line
+    bool profiling;
+    double subsystem_time[SUBSYSTEM_COUNT];
 
     uint8_t* rom; // Typically 0x000000 - 0x3FFFFF
+    uint32_t rom_size; // Bytes of the image, mirrored over the 4MB window
+    uint32_t rom_mask; // Mirroring period - 1
+    bool rom_mapped; // The ROM is the read-only mapping of the file
+    bool rom_shared; // The ROM belongs to another instance (see genesis_share_rom)
     uint8_t* ram; // Typically 0xFF0000 - 0xFFFFFF
     uint8_t* sram;
 
@@ -42,13 +68,23 @@ typedef struct Genesis
     struct Vdp* vdp;
     struct Joypad* joypad1;
     struct Joypad* joypad2;
+    struct Movie* movie; // Records or plays back the joypads (see movie.h)
     struct PSG* psg;
     struct YM2612* ym2612;
+    struct Sound* sound;
+
+    // Host services (see host.h)
+    HostClock clock;
+    VideoSink video;
+    AudioSink audio_sink;
 
+    // Desktop front-end (see desktop.h), not set on headless instances
     struct Renderer* renderer;
     struct Audio*    audio;
+    struct EmulationThread* emulation; // Runs genesis_emulate
     struct Settings* settings;
     struct Debugger* debugger;
+    struct RunAhead* run_ahead;
 
     Status status;
     Regions region;
@@ -57,19 +93,40 @@ typedef struct Genesis
     uint32_t rom_end, sram_start, sram_end;
 } Genesis;
 
-Genesis* genesis_make();
+// Everything is kept in the instance (the M68k instruction table aside,
+// see m68k_generate_opcode_table) so that several instances can run on
+// different threads.
+//
+// The instance starts with the system clock and the null sinks: it needs
+// no display nor sound device. It is driven by genesis_run_frame, or paced
+// by genesis_emulate once the front-end plugs in its own sinks.
+Genesis* genesis_make_headless();
 void genesis_free(Genesis*);
 
 void genesis_load_rom_file(Genesis* g, const char* path);
+
+// Run the game loaded in another instance, without copying the ROM
+// (the source instance must be freed last)
+void genesis_share_rom(Genesis* g, Genesis* source);
 void genesis_initialize(Genesis* g);
 
 struct DecodedInstruction* genesis_decode(Genesis* g, uint32_t pc);
 
-void genesis_update(Genesis* g);
+// Emulate up to the current host time, and hand the last frame and the new
+// samples to the sinks. Returns the host time until the next frame is due (s)
+double genesis_emulate(Genesis* g);
+
 void genesis_step(Genesis* g);
 
+// Run until the last visible line of the next frame is drawn (or a breakpoint is hit)
+void genesis_run_frame(Genesis* g);
+
 uint32_t genesis_master_frequency(Genesis*);
 
+// Where the CPU running is in the slice being emulated (see genesis_run_cycles),
+// for its writes to the sound chips to happen at the right time
+uint32_t genesis_slice_cycles(Genesis*);
+
 // Return the name of the game currently being executed as
 // stored in the ROM header. The international name is looked
 // for first and the domestic name is used as a fallback.
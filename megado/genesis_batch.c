@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "genesis.h"
+#include "genesis_batch.h"
+#include "joypad.h"
+#include "settings.h"
+#include "utils.h"
+#include "vdp.h"
+
+#define RAM_SIZE 0x10000
+
+// Work queues: [first, end[ packed in 32 bits
+#define QUEUE(first, end) ((int)((uint32_t)(first) | (uint32_t)(end) << 16))
+#define QUEUE_FIRST(queue) ((uint32_t)(queue) & 0xFFFF)
+#define QUEUE_END(queue) ((uint32_t)(queue) >> 16)
+
+static const JoypadButton action_buttons[GENESIS_BATCH_BUTTONS] = {
+    Up, Down, Left, Right, ButtonA, ButtonB, ButtonC, Start
+};
+
+// Take an instance from the front or the back of a worker's queue
+static bool pop(BatchWorker* w, bool front, int* instance)
+{
+    while (true)
+    {
+        int queue = SDL_AtomicGet(&w->queue);
+        uint32_t first = QUEUE_FIRST(queue);
+        uint32_t end = QUEUE_END(queue);
+
+        if (first >= end)
+            return false;
+
+        int next = front ? QUEUE(first + 1, end) : QUEUE(first, end - 1);
+        if (SDL_AtomicCAS(&w->queue, queue, next))
+        {
+            *instance = front ? first : end - 1;
+            return true;
+        }
+    }
+}
+
+// Run one frame, drawing it only if it is the last one of a step
+static void run_frame(GenesisBatch* b, Genesis* g, int frame)
+{
+    if (frame == b->frames - 1)
+        vdp_request_frame(g->vdp);
+
+    genesis_run_frame(g);
+}
+
+static void step_instance(GenesisBatch* b, int instance)
+{
+    Genesis* g = b->instances[instance];
+
+    const uint8_t* action = b->actions + instance * GENESIS_BATCH_BUTTONS;
+    for (int i = 0; i < GENESIS_BATCH_BUTTONS; ++i)
+    {
+        if (action[i])
+            joypad_press(g->joypad1, action_buttons[i]);
+        else
+            joypad_release(g->joypad1, action_buttons[i]);
+    }
+
+    // The indices are recorded as the pixels are drawn, from the first step that needs them
+    if (b->mode == BatchObservation_Indexed)
+        vdp_record_indices(g->vdp, true);
+
+    for (int frame = 0; frame < b->frames && g->status == Status_Running; ++frame)
+        run_frame(b, g, frame);
+
+    uint8_t* observation = b->observations + instance * genesis_batch_observation_size(b->mode);
+    if (b->mode == BatchObservation_RGB)
+    {
+        memcpy(observation, g->vdp->output_buffer, BUFFER_SIZE);
+        observation += BUFFER_SIZE;
+    }
+    else
+    {
+        memcpy(observation, g->vdp->index_buffer, BUFFER_WIDTH * BUFFER_HEIGHT);
+        observation += BUFFER_WIDTH * BUFFER_HEIGHT;
+    }
+
+    memcpy(observation, g->ram, RAM_SIZE);
+}
+
+static int worker_run(void* data)
+{
+    BatchWorker* w = data;
+    GenesisBatch* b = w->batch;
+
+    while (true)
+    {
+        SDL_SemWait(w->start);
+
+        if (b->quit)
+            break;
+
+        int instance;
+        while (pop(w, true, &instance))
+            step_instance(b, instance);
+
+        // Help the workers that are not done yet
+        w->stolen = 0;
+        int index = (int)(w - b->workers);
+        for (int i = 1; i < b->worker_count; ++i)
+        {
+            BatchWorker* victim = &b->workers[(index + i) % b->worker_count];
+            while (pop(victim, false, &instance))
+            {
+                step_instance(b, instance);
+                ++w->stolen;
+            }
+        }
+
+        SDL_SemPost(b->done);
+    }
+
+    return 0;
+}
+
+GenesisBatch* genesis_batch_make(const char* rom_path, int count, int frames, int threads)
+{
+    if (count < 1 || count > 0xFFFF)
+        FATAL("Invalid number of instances: %d", count);
+
+    GenesisBatch* b = calloc(1, sizeof(GenesisBatch));
+    b->count = count;
+    b->frames = frames > 0 ? frames : 1;
+
+    // All the instances run the ROM loaded by the first one
+    b->instances = calloc(count, sizeof(Genesis*));
+    for (int i = 0; i < count; ++i)
+    {
+        Genesis* g = genesis_make_headless();
+        g->settings->rewinding_enabled = false; // Would take a lot of memory with many instances
+        g->vdp->frameskip.mode = FrameSkipMode_OnDemand;
+
+        if (i == 0)
+            genesis_load_rom_file(g, rom_path);
+        else
+            genesis_share_rom(g, b->instances[0]);
+
+        b->instances[i] = g;
+    }
+
+    b->worker_count = threads > 0 ? threads : SDL_GetCPUCount();
+    if (b->worker_count > count)
+        b->worker_count = count;
+
+    b->done = SDL_CreateSemaphore(0);
+    b->workers = calloc(b->worker_count, sizeof(BatchWorker));
+    for (int i = 0; i < b->worker_count; ++i)
+    {
+        BatchWorker* w = &b->workers[i];
+        w->batch = b;
+        w->start = SDL_CreateSemaphore(0);
+        w->thread = SDL_CreateThread(worker_run, "genesis-batch", w);
+
+        if (w->thread == NULL)
+            FATAL("Cannot create batch thread: %s", SDL_GetError());
+    }
+
+    return b;
+}
+
+void genesis_batch_free(GenesisBatch* b)
+{
+    if (b == NULL)
+        return;
+
+    b->quit = true;
+    for (int i = 0; i < b->worker_count; ++i)
+        SDL_SemPost(b->workers[i].start);
+
+    for (int i = 0; i < b->worker_count; ++i)
+    {
+        SDL_WaitThread(b->workers[i].thread, NULL);
+        SDL_DestroySemaphore(b->workers[i].start);
+    }
+
+    // The first instance owns the ROM
+    for (int i = b->count - 1; i >= 0; --i)
+        genesis_free(b->instances[i]);
+
+    SDL_DestroySemaphore(b->done);
+    free(b->workers);
+    free(b->instances);
+    free(b);
+}
+
+void genesis_batch_reset(GenesisBatch* b, int instance)
+{
+    Genesis* g = b->instances[instance];
+
+    genesis_initialize(g);
+    g->status = Status_Running;
+}
+
+size_t genesis_batch_observation_size(BatchObservationModes mode)
+{
+    size_t frame = mode == BatchObservation_RGB ? BUFFER_SIZE : BUFFER_WIDTH * BUFFER_HEIGHT;
+    return frame + RAM_SIZE;
+}
+
+void genesis_batch_step(GenesisBatch* b, const uint8_t* actions, uint8_t* observations, BatchObservationModes mode)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    b->actions = actions;
+    b->observations = observations;
+    b->mode = mode;
+
+    // Even split, the workers balance the load by stealing from each other
+    for (int i = 0; i < b->worker_count; ++i)
+        SDL_AtomicSet(&b->workers[i].queue, QUEUE(b->count * i / b->worker_count, b->count * (i + 1) / b->worker_count));
+
+    for (int i = 0; i < b->worker_count; ++i)
+        SDL_SemPost(b->workers[i].start);
+
+    for (int i = 0; i < b->worker_count; ++i)
+        SDL_SemWait(b->done);
+
+    b->step_time = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    b->stepped_frames += (uint64_t)b->count * b->frames;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Genesis;
+struct GenesisBatch;
+
+// Buttons of an action, in this order (non-zero means pressed)
+#define GENESIS_BATCH_BUTTONS 8 // Up, Down, Left, Right, A, B, C, Start
+
+typedef enum
+{
+    BatchObservation_RGB,    // 3 bytes per pixel
+    BatchObservation_Indexed // CRAM index per pixel, with INDEX_SHADOW/INDEX_HIGHLIGHT (see vdp.h)
+} BatchObservationModes;
+
+typedef struct BatchWorker
+{
+    struct GenesisBatch* batch;
+    SDL_Thread* thread;
+    SDL_sem* start;
+
+    // Instances left to step, first one in the low 16 bits, end in the high ones.
+    // The worker takes them from the front, the others steal from the back.
+    SDL_atomic_t queue;
+
+    uint32_t stolen; // Instances taken from the other workers, last step
+} BatchWorker;
+
+// Batch of Genesis instances
+//
+// Runs the same game on many instances for training agents. The ROM is loaded
+// once and shared. Each step applies one action per instance, runs the given
+// number of frames on all the instances in parallel and writes the last frame
+// of each instance, followed by its RAM, into one contiguous buffer.
+//
+// The instances are split evenly among the workers, which steal instances from
+// the others once they are done with their own.
+typedef struct GenesisBatch
+{
+    int count;
+    struct Genesis** instances;
+
+    int frames; // Frames emulated per step, only the last one is drawn
+
+    int worker_count;
+    BatchWorker* workers;
+    SDL_sem* done;
+    bool quit;
+
+    // Current step
+    const uint8_t* actions;
+    uint8_t* observations;
+    BatchObservationModes mode;
+
+    // Stats
+    double step_time; // s
+    uint64_t stepped_frames;
+} GenesisBatch;
+
+// `frames` is the frame skip count (1 to step one frame at a time),
+// `threads` the number of workers (0 for one per CPU core)
+GenesisBatch* genesis_batch_make(const char* rom_path, int count, int frames, int threads);
+void genesis_batch_free(GenesisBatch*);
+
+// Power the given instance off and on
+void genesis_batch_reset(GenesisBatch*, int instance);
+
+// Size of the observation of one instance
+size_t genesis_batch_observation_size(BatchObservationModes);
+
+// `actions` holds count * GENESIS_BATCH_BUTTONS values,
+// `observations` count * genesis_batch_observation_size(mode) bytes
+void genesis_batch_step(GenesisBatch*, const uint8_t* actions, uint8_t* observations, BatchObservationModes mode);
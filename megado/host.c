@@ -0,0 +1,42 @@
+#include <SDL.h>
+
+#include "host.h"
+
+const uint32_t SAMPLE_RATE = 44100;
+
+// The timer needs no SDL_Init, unlike the video and audio subsystems
+static double system_now(void* context)
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static double null_now(void* context)
+{
+    return 0;
+}
+
+static void null_present(void* context, const uint8_t* pixels, uint16_t width, uint16_t height)
+{
+}
+
+static void null_queue(void* context, const int16_t* samples, uint32_t count)
+{
+}
+
+static double null_rate_control(void* context)
+{
+    return 1;
+}
+
+static void null_set_playing(void* context, bool playing)
+{
+}
+
+static void null_clear(void* context)
+{
+}
+
+const HostClock system_clock = { system_now, NULL };
+const HostClock null_clock = { null_now, NULL };
+const VideoSink null_video_sink = { null_present, NULL };
+const AudioSink null_audio_sink = { null_queue, null_rate_control, null_set_playing, null_clear, NULL };
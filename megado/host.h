@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host services
+//
+// The emulation core does not depend on a windowing or sound library: the
+// front-end plugs in a clock to pace genesis_emulate, a sink for the frames
+// and a sink for the samples. With the null sinks, the core runs where there
+// is neither a display nor a sound device (servers, benchmarks, tests).
+
+// Rate of the samples given to the audio sink (Hz)
+extern const uint32_t SAMPLE_RATE;
+
+typedef struct HostClock
+{
+    double (*now)(void* context); // Monotonic time (s)
+    void* context;
+} HostClock;
+
+typedef struct VideoSink
+{
+    // The frame to display, at the end of each genesis_emulate
+    // (RGB, BUFFER_WIDTH pixels per row, see vdp.h)
+    void (*present)(void* context, const uint8_t* pixels, uint16_t width, uint16_t height);
+    void* context;
+} VideoSink;
+
+typedef struct AudioSink
+{
+    void (*queue)(void* context, const int16_t* samples, uint32_t count); // Interleaved left and right channels
+
+    // Factor for the master cycles per sample, slightly off 1 to keep the
+    // sink at its target fill (see audio_rate_control)
+    double (*rate_control)(void* context);
+
+    void (*set_playing)(void* context, bool playing); // Follows the emulation status
+    void (*clear)(void* context); // Drop the samples not played yet (e.g. on reset)
+    void* context;
+} AudioSink;
+
+extern const HostClock system_clock; // The host performance counter
+extern const HostClock null_clock; // Stands still, for instances only driven by genesis_run_frame
+extern const VideoSink null_video_sink; // Drops the frames
+extern const AudioSink null_audio_sink; // Drops the samples, at the nominal rate
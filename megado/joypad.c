@@ -5,10 +5,15 @@
 Joypad* joypad_make()
 {
     Joypad* j = calloc(1, sizeof(Joypad));
-    j->buttons = 0x333F; // No buttons pressed
+    joypad_initialize(j);
     return j;
 }
 
+void joypad_initialize(Joypad* joypad)
+{
+    joypad->buttons = 0x333F; // No buttons pressed
+}
+
 void joypad_free(Joypad* joypad)
 {
     free(joypad);
@@ -34,6 +34,7 @@ typedef struct Joypad {
 
 Joypad* joypad_make();
 void joypad_free(Joypad*);
+void joypad_initialize(Joypad*);
 
 uint8_t joypad_read(Joypad*);
 void joypad_write(Joypad*, uint8_t);
@@ -246,15 +246,15 @@ uint8_t movep(Instruction* i, M68k* ctx)
     {
         if (i->size == Word)
         {
-            m68k_write_b(ctx, i->dst->last_ea, (value & 0xFF00) >> 8);
-            m68k_write_b(ctx, i->dst->last_ea + 2, value & 0xFF);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx), (value & 0xFF00) >> 8);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx) + 2, value & 0xFF);
         }
         else
         {
-            m68k_write_b(ctx, i->dst->last_ea, (value & 0xFF000000) >> 24);
-            m68k_write_b(ctx, i->dst->last_ea + 2, (value & 0xFF0000) >> 16);
-            m68k_write_b(ctx, i->dst->last_ea + 4, (value & 0xFF00) >> 8);
-            m68k_write_b(ctx, i->dst->last_ea + 6, value & 0xFF);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx), (value & 0xFF000000) >> 24);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx) + 2, (value & 0xFF0000) >> 16);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx) + 4, (value & 0xFF00) >> 8);
+            m68k_write_b(ctx, LAST_EA(i->dst, ctx) + 6, value & 0xFF);
         }
     }
     else if (i->dst->type == DataRegister)
@@ -262,16 +262,16 @@ uint8_t movep(Instruction* i, M68k* ctx)
         if (i->size == Word)
         {
             ctx->data_registers[i->dst->n] =
-                m68k_read_b(ctx, i->src->last_ea) << 8 |
-                m68k_read_b(ctx, i->src->last_ea + 2);
+                m68k_read_b(ctx, LAST_EA(i->src, ctx)) << 8 |
+                m68k_read_b(ctx, LAST_EA(i->src, ctx) + 2);
         }
         else
         {
             ctx->data_registers[i->dst->n] =
-                m68k_read_b(ctx, i->src->last_ea) << 24 |
-                m68k_read_b(ctx, i->src->last_ea + 2) << 16 |
-                m68k_read_b(ctx, i->src->last_ea + 4) << 8 |
-                m68k_read_b(ctx, i->src->last_ea + 6);
+                m68k_read_b(ctx, LAST_EA(i->src, ctx)) << 24 |
+                m68k_read_b(ctx, LAST_EA(i->src, ctx) + 2) << 16 |
+                m68k_read_b(ctx, LAST_EA(i->src, ctx) + 4) << 8 |
+                m68k_read_b(ctx, LAST_EA(i->src, ctx) + 6);
         }
     }
     else
@@ -21,6 +21,21 @@ static const uint32_t MASTER_CYCLES_PER_CLOCK = 7;
 
 Instruction** opcode_table;
 
+void m68k_generate_opcode_table()
+{
+    opcode_table = calloc(0x10000, sizeof(Instruction*));
+    for (int opcode = 0; opcode < 0x10000; ++opcode)
+        opcode_table[opcode] = instruction_generate(opcode);
+}
+
+void m68k_free_opcode_table()
+{
+    for (int opcode = 0; opcode < 0x10000; ++opcode)
+        instruction_free(opcode_table[opcode]);
+    free(opcode_table);
+    opcode_table = NULL;
+}
+
 M68k* m68k_make(Genesis* g)
 {
     M68k* m68k = calloc(1, sizeof(M68k));
@@ -132,6 +147,7 @@ uint32_t m68k_run_cycles(M68k* m, uint32_t cycles)
 
     while (m->remaining_master_cycles > 0)
     {
+        m->slice_cycles = cycles_this_frame;
         int16_t c = m68k_step(m);
 
         if (c >= 0) {
@@ -153,6 +169,8 @@ uint32_t m68k_run_cycles(M68k* m, uint32_t cycles)
         }
     }
 
+    m->slice_cycles = 0;
+
     return cycles_this_frame;
 }
 
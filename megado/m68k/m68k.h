@@ -36,8 +36,14 @@ struct Genesis;
 struct M68k;
 
 // Jump table that contains all the M68000 instructions
+//
+// It is generated once per process and only read afterwards,
+// so it can be shared by CPU instances running on different threads.
 extern struct Instruction** opcode_table;
 
+void m68k_generate_opcode_table();
+void m68k_free_opcode_table();
+
 typedef enum {
     INVALID_INSTRUCTION = -1,
     STOPPED             = -2,
@@ -63,6 +69,7 @@ typedef struct M68k
     uint64_t cycles;
     bool stopped;
     int32_t remaining_master_cycles;
+    uint32_t slice_cycles; // Run so far by m68k_run_cycles (as counted in what it returns), 0 outside of it
 
     // Level of any pending interrupt (negative values means no interrupts)
     int pending_interrupt;
@@ -73,6 +80,9 @@ typedef struct M68k
     uint16_t instruction_register; // Instruction currently being decoded
     uint32_t instruction_address; // Instruction currently being decoded
 
+    // Effective addresses of the source and destination operands of the current instruction
+    uint32_t operand_ea[2];
+
     uint64_t instruction_count;
 } M68k;
 
@@ -6,7 +6,7 @@
 #include "../genesis.h"
 #include "../joypad.h"
 #include "../vdp.h"
-#include "../psg.h"
+#include "../sound.h"
 #include "../utils.h"
 
 uint32_t m68k_read(M68k* m, Size size, uint32_t address)
@@ -39,7 +39,9 @@ uint8_t m68k_read_b(M68k* m, uint32_t address)
     // ROM
     else if (address <= 0x3FFFFF)
     {
-        return m->genesis->rom[address];
+        // Past the end of images whose size is not a power of two, read 0
+        uint32_t offset = address & m->genesis->rom_mask;
+        return offset < m->genesis->rom_size ? m->genesis->rom[offset] : 0;
     }
 
     // RAM
@@ -204,7 +206,7 @@ void m68k_write_b(M68k* m, uint32_t address, uint8_t value)
     }
 
     else if (address == 0xC00011 || address == 0xC00013 || address == 0xC00015 || address == 0xC00017) {
-        psg_write(m->genesis->psg, value);
+        sound_write(m->genesis->sound, genesis_slice_cycles(m->genesis), SoundChip_PSG, 0, value);
     }
 
     else
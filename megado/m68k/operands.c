@@ -195,12 +195,12 @@ void noop(Operand* o, M68k* ctx, uint32_t value)
 
 uint32_t get_from_ea(Operand* o, M68k* ctx)
 {
-    return m68k_read(ctx, o->instruction->size, o->last_ea);
+    return m68k_read(ctx, o->instruction->size, LAST_EA(o, ctx));
 }
 
 void set_from_ea(Operand* o, M68k* ctx, uint32_t value)
 {
-    m68k_write(ctx, o->instruction->size, o->last_ea, value);
+    m68k_write(ctx, o->instruction->size, LAST_EA(o, ctx), value);
 }
 
 // Placeholder function for addressing modes that do not have effective address to compute
@@ -432,17 +432,17 @@ uint32_t immediate_long_ea(Operand* o, M68k* ctx)
 
 uint32_t immediate_byte_get(Operand* o, M68k* ctx)
 {
-    return MASK_ABOVE_INC(m68k_read_w(ctx, o->last_ea), 8);
+    return MASK_ABOVE_INC(m68k_read_w(ctx, LAST_EA(o, ctx)), 8);
 }
 
 uint32_t immediate_word_get(Operand* o, M68k* ctx)
 {
-    return m68k_read_w(ctx, o->last_ea);
+    return m68k_read_w(ctx, LAST_EA(o, ctx));
 }
 
 uint32_t immediate_long_get(Operand* o, M68k* ctx)
 {
-    return m68k_read_l(ctx, o->last_ea);
+    return m68k_read_l(ctx, LAST_EA(o, ctx));
 }
 
 Operand* operand_make_immediate_value(Size size, Instruction* instr)
@@ -655,7 +655,7 @@ uint32_t operand_fetch_ea_and_get(Operand* operand, M68k* ctx) {
         FATAL("fetch_ea_func is null (opcode: %04X, name: %s)\n",
               operand->instruction->opcode, operand->instruction->name);
     }
-    operand->last_ea = operand->fetch_ea_func(operand, ctx);
+    FETCH_EA(operand, ctx);
     if (operand->get_value_func == NULL) {
         FATAL("get_value_func is null (opcode: %04X, name: %s)\n",
               operand->instruction->opcode, operand->instruction->name);
@@ -668,7 +668,7 @@ void operand_fetch_ea_and_set(Operand* operand, M68k* ctx, uint32_t value) {
         FATAL("fetch_ea_func is null (opcode: %04X, name: %s)\n",
               operand->instruction->opcode, operand->instruction->name);
     }
-    operand->last_ea = operand->fetch_ea_func(operand, ctx);
+    FETCH_EA(operand, ctx);
     if (operand->set_value_func == NULL) {
         FATAL("set_value_func is null (opcode: %04X, name: %s)\n",
               operand->instruction->opcode, operand->instruction->name);
@@ -11,8 +11,12 @@ struct Instruction;
  * Macros to read/write operand data
  */
 
+// Last effective address computed for the operand
+// (stored in the CPU since the instructions are shared by all the CPU instances)
+#define LAST_EA(OPERAND, CTX) (CTX)->operand_ea[(OPERAND) == (OPERAND)->instruction->dst]
+
 // Fetch and store the operand's effective address
-#define FETCH_EA(OPERAND, CTX) (OPERAND)->last_ea = (OPERAND)->fetch_ea_func((OPERAND), (CTX))
+#define FETCH_EA(OPERAND, CTX) LAST_EA(OPERAND, CTX) = (OPERAND)->fetch_ea_func((OPERAND), (CTX))
 
 // Get/Set the operand's value, the stored effective address will be used
 #define GET(OPERAND, CTX) (OPERAND)->get_value_func((OPERAND), (CTX))
@@ -67,9 +71,6 @@ typedef struct Operand
 
     OperandType type;
 
-    // Last effective address computed
-    uint32_t last_ea;
-
     // Compute and store the operand's effective address
     FetchEAFunc fetch_ea_func;
 
@@ -0,0 +1,217 @@
+// Exported, not imported, on Windows (see megado.h)
+#define MEGADO_BUILD
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "genesis.h"
+#include "joypad.h"
+#include "m68k/m68k.h"
+#include "megado.h"
+#include "snapshot.h"
+#include "sound.h"
+#include "vdp.h"
+
+struct Megado
+{
+    Genesis* genesis;
+
+    // Samples of the last frame, drained from the sound buffer
+    int16_t audio[SOUND_BUFFER_LENGTH * 2];
+    uint32_t audio_count;
+};
+
+struct MegadoSnapshot
+{
+    Snapshot snapshot;
+};
+
+static const JoypadButton BUTTONS[] = { Up, Down, Left, Right, ButtonA, ButtonB, ButtonC, Start };
+
+// The M68k instruction table is shared by all the instances
+static SDL_SpinLock opcode_table_lock;
+static int opcode_table_users;
+
+uint32_t megado_abi_version(void)
+{
+    return MEGADO_ABI_VERSION;
+}
+
+Megado* megado_create(uint32_t abi_version)
+{
+    if (abi_version != MEGADO_ABI_VERSION)
+    {
+        printf("Warning, libmegado ABI version %u requested, this library provides %u\n", abi_version, MEGADO_ABI_VERSION);
+        return NULL;
+    }
+
+    SDL_AtomicLock(&opcode_table_lock);
+    if (opcode_table_users++ == 0)
+        m68k_generate_opcode_table();
+    SDL_AtomicUnlock(&opcode_table_lock);
+
+    Megado* m = calloc(1, sizeof(Megado));
+    m->genesis = genesis_make_headless();
+
+    // Frames are only run on demand
+    m->genesis->clock = null_clock;
+
+    return m;
+}
+
+void megado_destroy(Megado* m)
+{
+    if (m == NULL)
+        return;
+
+    genesis_free(m->genesis);
+    free(m);
+
+    SDL_AtomicLock(&opcode_table_lock);
+    if (--opcode_table_users == 0)
+        m68k_free_opcode_table();
+    SDL_AtomicUnlock(&opcode_table_lock);
+}
+
+bool megado_load_rom(Megado* m, const char* path)
+{
+    // genesis_load_rom_file gives up on the whole process otherwise
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return false;
+    }
+    fclose(file);
+
+    genesis_load_rom_file(m->genesis, path);
+    m->audio_count = 0;
+
+    return true;
+}
+
+void megado_reset(Megado* m)
+{
+    if (m->genesis->status == Status_NoGameLoaded)
+        return;
+
+    genesis_initialize(m->genesis);
+    m->audio_count = 0;
+}
+
+bool megado_run_frame(Megado* m)
+{
+    Genesis* g = m->genesis;
+
+    m->audio_count = 0;
+    if (g->status != Status_Running)
+        return false;
+
+    genesis_run_frame(g);
+    m->audio_count = sound_read(g->sound, m->audio, SOUND_BUFFER_LENGTH);
+
+    return g->status == Status_Running;
+}
+
+void megado_set_input(Megado* m, uint32_t joypad, uint32_t buttons)
+{
+    Joypad* j = joypad == 0 ? m->genesis->joypad1 : m->genesis->joypad2;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (buttons & (1 << i))
+            joypad_press(j, BUTTONS[i]);
+        else
+            joypad_release(j, BUTTONS[i]);
+    }
+}
+
+MegadoSnapshot* megado_snapshot(Megado* m)
+{
+    MegadoSnapshot* s = calloc(1, sizeof(MegadoSnapshot));
+    snapshot_capture(m->genesis, &s->snapshot);
+    return s;
+}
+
+void megado_restore(Megado* m, const MegadoSnapshot* s)
+{
+    snapshot_restore(m->genesis, (Snapshot*)&s->snapshot);
+    m->audio_count = 0;
+}
+
+void megado_snapshot_free(MegadoSnapshot* s)
+{
+    free(s);
+}
+
+bool megado_save_state(Megado* m, const char* path)
+{
+    SnapshotMetadata metadata = { 0 };
+    genesis_get_rom_name(m->genesis, metadata.game);
+    metadata.date = time(NULL);
+    metadata.version = SNAPSHOT_VERSION;
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return false;
+    }
+
+    bool ok = snapshot_write(m->genesis, file, &metadata, true);
+    fclose(file);
+
+    return ok;
+}
+
+bool megado_load_state(Megado* m, const char* path)
+{
+    if (!snapshot_read_file(m->genesis, path))
+        return false;
+
+    m->audio_count = 0;
+    return true;
+}
+
+const uint8_t* megado_framebuffer(Megado* m, uint32_t* width, uint32_t* height, uint32_t* pitch)
+{
+    uint16_t w, h;
+    vdp_get_resolution(m->genesis->vdp, &w, &h);
+
+    if (width != NULL)
+        *width = w;
+    if (height != NULL)
+        *height = h;
+    if (pitch != NULL)
+        *pitch = BUFFER_WIDTH * 3;
+
+    return m->genesis->vdp->output_buffer;
+}
+
+const uint8_t* megado_work_ram(Megado* m, uint32_t* size)
+{
+    if (size != NULL)
+        *size = 0x10000;
+
+    return m->genesis->ram;
+}
+
+const uint8_t* megado_vram(Megado* m, uint32_t* size)
+{
+    if (size != NULL)
+        *size = sizeof(m->genesis->vdp->vram);
+
+    return m->genesis->vdp->vram;
+}
+
+const int16_t* megado_audio(Megado* m, uint32_t* count, uint32_t* sample_rate)
+{
+    if (count != NULL)
+        *count = m->audio_count;
+    if (sample_rate != NULL)
+        *sample_rate = SAMPLE_RATE;
+
+    return m->audio;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Public API of libmegado
+//
+// A stable C ABI over the emulation core, for bindings (Python, Rust, etc)
+// and programs that load the shared library (see `make shared`). Instances
+// are opaque and only scalars and pointers cross the boundary, so the core's
+// structures can change without breaking the programs built against it.
+//
+// The memories are handed out as read-only pointers into the instance, there
+// is no copy per call. They stay valid until the instance is destroyed, and
+// are updated in place by megado_run_frame, megado_reset and megado_restore.
+
+// Bumped whenever a function or a constant below changes incompatibly
+#define MEGADO_ABI_VERSION 1
+
+#if defined(_WIN32)
+#if defined(MEGADO_BUILD)
+#define MEGADO_API __declspec(dllexport)
+#else
+#define MEGADO_API __declspec(dllimport)
+#endif
+#else
+#define MEGADO_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Megado Megado;
+typedef struct MegadoSnapshot MegadoSnapshot;
+
+// Joypad buttons, held ones are set (independent from joypad.h's masks)
+typedef enum
+{
+    MEGADO_BUTTON_UP    = 1 << 0,
+    MEGADO_BUTTON_DOWN  = 1 << 1,
+    MEGADO_BUTTON_LEFT  = 1 << 2,
+    MEGADO_BUTTON_RIGHT = 1 << 3,
+    MEGADO_BUTTON_A     = 1 << 4,
+    MEGADO_BUTTON_B     = 1 << 5,
+    MEGADO_BUTTON_C     = 1 << 6,
+    MEGADO_BUTTON_START = 1 << 7
+} MegadoButton;
+
+// Version the library was built with
+MEGADO_API uint32_t megado_abi_version(void);
+
+// Pass MEGADO_ABI_VERSION: returns NULL if the library does not match the
+// header the caller was built with
+MEGADO_API Megado* megado_create(uint32_t abi_version);
+MEGADO_API void megado_destroy(Megado*);
+
+// Returns false if the file cannot be read (the previous game keeps running)
+MEGADO_API bool megado_load_rom(Megado*, const char* path);
+MEGADO_API void megado_reset(Megado*);
+
+// Emulate one frame, as fast as possible. Returns false when nothing ran
+// (no game loaded, or a breakpoint was hit)
+MEGADO_API bool megado_run_frame(Megado*);
+
+// Buttons held on joypad 0 or 1 from now on (MegadoButton flags)
+MEGADO_API void megado_set_input(Megado*, uint32_t joypad, uint32_t buttons);
+
+// In-memory states, only valid with this build of the library
+MEGADO_API MegadoSnapshot* megado_snapshot(Megado*);
+MEGADO_API void megado_restore(Megado*, const MegadoSnapshot*);
+MEGADO_API void megado_snapshot_free(MegadoSnapshot*);
+
+// State files, in the same format as the desktop front-end's snapshots
+MEGADO_API bool megado_save_state(Megado*, const char* path);
+MEGADO_API bool megado_load_state(Megado*, const char* path);
+
+// Last frame: RGB, `pitch` bytes per row
+MEGADO_API const uint8_t* megado_framebuffer(Megado*, uint32_t* width, uint32_t* height, uint32_t* pitch);
+
+// 64KB of M68k work RAM (0xFF0000 - 0xFFFFFF)
+MEGADO_API const uint8_t* megado_work_ram(Megado*, uint32_t* size);
+
+// 64KB of VDP VRAM
+MEGADO_API const uint8_t* megado_vram(Megado*, uint32_t* size);
+
+// Samples of the last megado_run_frame: `count` stereo samples, interleaved
+// left and right channels, at `sample_rate` Hz
+MEGADO_API const int16_t* megado_audio(Megado*, uint32_t* count, uint32_t* sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "genesis.h"
+#include "joypad.h"
+#include "movie.h"
+#include "serializer.h"
+#include "snapshot.h"
+#include "z80.h"
+
+#define MOVIE_MAGIC "MGDM"
+#define MOVIE_HEADER_SIZE 64
+
+static const JoypadButton BUTTONS[] = { Up, Down, Left, Right, ButtonA, ButtonB, ButtonC, Start };
+
+Movie* movie_make()
+{
+    return calloc(1, sizeof(Movie));
+}
+
+void movie_free(Movie* m)
+{
+    if (m == NULL)
+        return;
+
+    free(m->inputs);
+    free(m->snapshot);
+    free(m);
+}
+
+static uint8_t held_buttons(Joypad* j)
+{
+    uint8_t held = 0;
+    for (int i = 0; i < 8; ++i)
+        if ((j->buttons & BUTTONS[i]) == 0)
+            held |= 1 << i;
+
+    return held;
+}
+
+static void hold_buttons(Joypad* j, uint8_t held)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        if (held & (1 << i))
+            joypad_press(j, BUTTONS[i]);
+        else
+            joypad_release(j, BUTTONS[i]);
+    }
+}
+
+// Unlike a reset, nothing is left from what ran before
+static void power_on(Genesis* g)
+{
+    memset(g->ram, 0, 0x10000);
+    memset(g->z80->ram, 0, Z80_RAM_LENGTH);
+    joypad_initialize(g->joypad1);
+    joypad_initialize(g->joypad2);
+
+    genesis_initialize(g);
+}
+
+// The start state, in the snapshot file format
+static bool take_snapshot(Movie* m, Genesis* g)
+{
+    SnapshotMetadata metadata = { 0 };
+    genesis_get_rom_name(g, metadata.game);
+    metadata.version = SNAPSHOT_VERSION;
+
+    size_t size;
+    m->snapshot = snapshot_write_memory(g, &metadata, true, &size);
+    m->snapshot_size = m->snapshot != NULL ? size : 0;
+
+    return m->snapshot != NULL;
+}
+
+bool movie_record(Movie* m, Genesis* g, bool from_power_on)
+{
+    free(m->snapshot);
+    m->snapshot = NULL;
+    m->snapshot_size = 0;
+    m->frame_count = 0;
+    m->cursor = 0;
+    m->mode = MovieMode_Idle;
+    genesis_get_rom_name(g, m->game);
+
+    if (from_power_on)
+        power_on(g);
+
+    if (!take_snapshot(m, g))
+    {
+        printf("Cannot take the movie's start snapshot\n");
+        return false;
+    }
+
+    m->mode = MovieMode_Recording;
+
+    return true;
+}
+
+bool movie_play(Movie* m, Genesis* g)
+{
+    char game[49];
+    genesis_get_rom_name(g, game);
+    if (strcmp(game, m->game) != 0)
+        printf("Warning, the movie was recorded with \"%s\", not \"%s\"\n", m->game, game);
+
+    if (!snapshot_read(g, m->snapshot, m->snapshot_size))
+    {
+        printf("Cannot restore the movie's start snapshot\n");
+        return false;
+    }
+
+    m->cursor = 0;
+    m->mode = MovieMode_Playing;
+
+    return true;
+}
+
+void movie_stop(Movie* m)
+{
+    m->mode = MovieMode_Idle;
+}
+
+void movie_interrupt(Movie* m, const char* cause)
+{
+    if (m->mode == MovieMode_Idle)
+        return;
+
+    printf("Movie %s stopped by the %s\n", m->mode == MovieMode_Recording ? "recording" : "playback", cause);
+    movie_stop(m);
+}
+
+void movie_frame(Movie* m, Genesis* g)
+{
+    if (m->mode == MovieMode_Recording)
+    {
+        if (m->frame_count == m->capacity)
+        {
+            m->capacity = m->capacity > 0 ? m->capacity * 2 : 3600;
+            m->inputs = realloc(m->inputs, m->capacity * sizeof(m->inputs[0]));
+        }
+
+        m->inputs[m->frame_count][0] = held_buttons(g->joypad1);
+        m->inputs[m->frame_count][1] = held_buttons(g->joypad2);
+        ++m->frame_count;
+    }
+    else if (m->mode == MovieMode_Playing)
+    {
+        if (m->cursor == m->frame_count)
+        {
+            m->mode = MovieMode_Idle;
+            return;
+        }
+
+        hold_buttons(g->joypad1, m->inputs[m->cursor][0]);
+        hold_buttons(g->joypad2, m->inputs[m->cursor][1]);
+        ++m->cursor;
+    }
+}
+
+bool movie_save(Movie* m, const char* path)
+{
+    uint8_t header[MOVIE_HEADER_SIZE] = { 0 };
+    uint16_t version = MOVIE_VERSION;
+    uint16_t flags = 0;
+
+    Serializer s = serializer_make(Serializer_Write, header, sizeof(header));
+    serializer_bytes(&s, MOVIE_MAGIC, 4);
+    serializer_u16(&s, &version);
+    serializer_u16(&s, &flags);
+    serializer_bytes(&s, m->game, 48);
+    serializer_u32(&s, &m->frame_count);
+    serializer_u32(&s, &m->snapshot_size);
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return false;
+    }
+
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+        fwrite(m->snapshot, 1, m->snapshot_size, file) == m->snapshot_size &&
+        (m->frame_count == 0 || fwrite(m->inputs, sizeof(m->inputs[0]), m->frame_count, file) == m->frame_count);
+    fclose(file);
+
+    if (!ok)
+        printf("Cannot write movie \"%s\"\n", path);
+
+    return ok;
+}
+
+bool movie_load(Movie* m, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    char magic[4];
+    uint16_t version, flags;
+    char game[49] = { 0 };
+    uint32_t frame_count, snapshot_size;
+
+    bool ok = fread(header, sizeof(header), 1, file) == 1;
+
+    Serializer s = serializer_make(Serializer_Read, header, sizeof(header));
+    serializer_bytes(&s, magic, 4);
+    serializer_u16(&s, &version);
+    serializer_u16(&s, &flags);
+    serializer_bytes(&s, game, 48);
+    serializer_u32(&s, &frame_count);
+    serializer_u32(&s, &snapshot_size);
+
+    if (!ok || memcmp(magic, MOVIE_MAGIC, 4) != 0 || version > MOVIE_VERSION || snapshot_size == 0)
+    {
+        printf("\"%s\" is not a movie this version can read\n", path);
+        fclose(file);
+        return false;
+    }
+
+    uint8_t* snapshot = malloc(snapshot_size);
+    uint8_t (*inputs)[2] = frame_count > 0 ? malloc(frame_count * sizeof(inputs[0])) : NULL;
+
+    ok = fread(snapshot, 1, snapshot_size, file) == snapshot_size &&
+        (frame_count == 0 || fread(inputs, sizeof(inputs[0]), frame_count, file) == frame_count);
+    fclose(file);
+
+    if (!ok)
+    {
+        printf("Movie \"%s\" is truncated\n", path);
+        free(snapshot);
+        free(inputs);
+        return false;
+    }
+
+    free(m->snapshot);
+    free(m->inputs);
+
+    m->mode = MovieMode_Idle;
+    memcpy(m->game, game, sizeof(m->game));
+    m->inputs = inputs;
+    m->frame_count = frame_count;
+    m->capacity = frame_count;
+    m->cursor = 0;
+    m->snapshot = snapshot;
+    m->snapshot_size = snapshot_size;
+
+    return true;
+}
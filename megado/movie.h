@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Genesis;
+
+// Bump that version number when changing the file format in a way older
+// versions of the emulator cannot read.
+#define MOVIE_VERSION 1
+
+// Movie file format
+//
+// All integers are little-endian.
+//
+// Header (64 bytes)
+//     char     magic[4] ("MGDM")
+//     uint16_t version
+//     uint16_t flags (unused)
+//     char     game[48] (name from the ROM header)
+//     uint32_t frame_count
+//     uint32_t snapshot_size
+// Start state (snapshot_size bytes, a snapshot file, see snapshot.h)
+// Inputs (frame_count * 2 bytes)
+//     uint8_t  joypads[2] (held buttons: Up, Down, Left, Right, A, B, C, Start from bit 0)
+
+typedef enum
+{
+    MovieMode_Idle,
+    MovieMode_Recording,
+    MovieMode_Playing
+} MovieModes;
+
+// Input movie
+//
+// The state of both joypads at the beginning of each frame, from a start
+// state: the movie is played back exactly as it was recorded, two playbacks
+// give the same frames. The start state is always stored, even from power
+// on, since a reset leaves the CPU registers and the chips as they were.
+// genesis_run_frame records or plays back one frame at a time.
+typedef struct Movie
+{
+    MovieModes mode;
+    char game[49]; // See genesis_get_rom_name
+
+    uint8_t (*inputs)[2];
+    uint32_t frame_count;
+    uint32_t capacity;
+    uint32_t cursor; // Next frame to play back
+
+    uint8_t* snapshot; // Start state, in the snapshot file format
+    uint32_t snapshot_size;
+} Movie;
+
+Movie* movie_make();
+void movie_free(Movie*);
+
+// Start a new recording, from power on or from the current state
+bool movie_record(Movie*, struct Genesis*, bool from_power_on);
+
+// Go back to the start of the movie and play it back
+bool movie_play(Movie*, struct Genesis*);
+
+// Stop recording or playing back, the inputs are kept
+void movie_stop(Movie*);
+
+// Stop recording or playing back because something else replaced the state
+// (`cause`, e.g. a reset): the inputs would not go with it anymore
+void movie_interrupt(Movie*, const char* cause);
+
+// Record the joypads, or set them from the movie, before each frame.
+// Playing back stops past the last frame, the joypads keep its inputs
+void movie_frame(Movie*, struct Genesis*);
+
+bool movie_save(Movie*, const char* path);
+bool movie_load(Movie*, const char* path);
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "parallel_renderer.h"
+#include "utils.h"
+
+#define LOG_INITIAL_CAPACITY 4096
+
+static void draw_lines(RenderWorker* w)
+{
+    ParallelRenderer* p = w->renderer;
+
+    memcpy(w->state, p->base, sizeof(Vdp));
+
+    uint32_t entry = 0;
+    for (int line = w->first_line; line < w->last_line; ++line)
+    {
+        // Apply the changes that occurred before the beam reached that line
+        for (; entry < p->log_length && p->log[entry].line <= line; ++entry)
+            vdp_apply_log_entry(w->state, &p->log[entry]);
+
+        if (p->drawn_lines[line])
+            vdp_render_scanline(w->state, line, &w->buffers);
+    }
+}
+
+static int worker_run(void* data)
+{
+    RenderWorker* w = data;
+
+    while (true)
+    {
+        SDL_SemWait(w->start);
+
+        if (w->renderer->quit)
+            break;
+
+        draw_lines(w);
+        SDL_SemPost(w->renderer->done);
+    }
+
+    return 0;
+}
+
+ParallelRenderer* parallel_renderer_make(Vdp* v, int workers)
+{
+    ParallelRenderer* p = calloc(1, sizeof(ParallelRenderer));
+    p->vdp = v;
+    p->base = calloc(1, sizeof(Vdp));
+    p->log_capacity = LOG_INITIAL_CAPACITY;
+    p->log = calloc(p->log_capacity, sizeof(VdpLogEntry));
+    p->done = SDL_CreateSemaphore(0);
+
+    p->worker_count = workers;
+    p->workers = calloc(workers, sizeof(RenderWorker));
+    for (int i = 0; i < workers; ++i)
+    {
+        RenderWorker* w = &p->workers[i];
+        w->renderer = p;
+        w->state = calloc(1, sizeof(Vdp));
+        w->start = SDL_CreateSemaphore(0);
+        w->thread = SDL_CreateThread(worker_run, "vdp-render", w);
+
+        if (w->thread == NULL)
+            FATAL("Cannot create render thread: %s", SDL_GetError());
+    }
+
+    return p;
+}
+
+void parallel_renderer_free(ParallelRenderer* p)
+{
+    if (p == NULL)
+        return;
+
+    p->quit = true;
+    for (int i = 0; i < p->worker_count; ++i)
+        SDL_SemPost(p->workers[i].start);
+
+    for (int i = 0; i < p->worker_count; ++i)
+    {
+        RenderWorker* w = &p->workers[i];
+        SDL_WaitThread(w->thread, NULL);
+        SDL_DestroySemaphore(w->start);
+        free(w->state);
+    }
+
+    SDL_DestroySemaphore(p->done);
+    free(p->workers);
+    free(p->log);
+    free(p->base);
+    free(p);
+}
+
+void parallel_renderer_begin_frame(ParallelRenderer* p)
+{
+    memcpy(p->base, p->vdp, sizeof(Vdp));
+    memset(p->drawn_lines, 0, sizeof(p->drawn_lines));
+
+    p->log_length = 0;
+    p->line = 0;
+    p->recording = true;
+}
+
+void parallel_renderer_line(ParallelRenderer* p, int line, bool drawn)
+{
+    if (!p->recording)
+        return;
+
+    p->drawn_lines[line] = drawn;
+    p->line = line + 1;
+}
+
+void parallel_renderer_log(ParallelRenderer* p, VdpLogEntryTypes type, uint16_t address, uint16_t value)
+{
+    if (!p->recording)
+        return;
+
+    if (p->log_length == p->log_capacity)
+    {
+        p->log_capacity *= 2;
+        p->log = realloc(p->log, p->log_capacity * sizeof(VdpLogEntry));
+    }
+
+    p->log[p->log_length++] = (VdpLogEntry) { type, p->line, address, value };
+}
+
+void parallel_renderer_end_frame(ParallelRenderer* p)
+{
+    if (!p->recording)
+        return;
+
+    p->recording = false;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    // Split the frame into contiguous bands
+    for (int i = 0; i < p->worker_count; ++i)
+    {
+        RenderWorker* w = &p->workers[i];
+        w->first_line = p->line * i / p->worker_count;
+        w->last_line = p->line * (i + 1) / p->worker_count;
+        SDL_SemPost(w->start);
+    }
+
+    for (int i = 0; i < p->worker_count; ++i)
+        SDL_SemWait(p->done);
+
+    p->frame_time = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    p->frame_log_length = p->log_length;
+
+    // The line signatures do not match the lines drawn by the workers
+    vdp_invalidate_line_cache(p->vdp);
+}
+
+void parallel_renderer_cancel(ParallelRenderer* p)
+{
+    p->recording = false;
+}
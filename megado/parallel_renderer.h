@@ -0,0 +1,66 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdp.h"
+
+struct ParallelRenderer;
+
+typedef struct RenderWorker
+{
+    struct ParallelRenderer* renderer;
+    SDL_Thread* thread;
+    SDL_sem* start;
+
+    // Private copy of the VDP, brought up to date with the lines being drawn
+    Vdp* state;
+    ScanlineBuffers buffers;
+
+    // Range of lines to draw (last excluded)
+    int first_line;
+    int last_line;
+} RenderWorker;
+
+// Parallel frame rendering
+//
+// During a frame, the VDP state changes that matter for rendering are logged
+// along with the line they first apply to. Once the visible lines are over,
+// the frame is split among the workers: each one starts from the state of the
+// VDP at the beginning of the frame, replays the log up to its first line and
+// draws its lines, applying the following changes as it goes. This gives the
+// same result as drawing each line when the beam reaches it.
+typedef struct ParallelRenderer
+{
+    Vdp* vdp;
+
+    // VDP state when the frame began
+    Vdp* base;
+
+    bool recording;
+    uint16_t line; // Next line reached by the beam, used to tag the log entries
+    bool drawn_lines[BUFFER_HEIGHT];
+
+    VdpLogEntry* log;
+    uint32_t log_length;
+    uint32_t log_capacity;
+
+    int worker_count;
+    RenderWorker* workers;
+    SDL_sem* done;
+    bool quit;
+
+    // Stats about the last frame
+    double frame_time; // seconds
+    uint32_t frame_log_length;
+} ParallelRenderer;
+
+ParallelRenderer* parallel_renderer_make(Vdp*, int workers);
+void parallel_renderer_free(ParallelRenderer*);
+
+void parallel_renderer_begin_frame(ParallelRenderer*);
+void parallel_renderer_line(ParallelRenderer*, int line, bool drawn); // The beam reached a line
+void parallel_renderer_log(ParallelRenderer*, VdpLogEntryTypes type, uint16_t address, uint16_t value);
+void parallel_renderer_end_frame(ParallelRenderer*); // Draw the logged lines (blocks until done)
+void parallel_renderer_cancel(ParallelRenderer*); // Drop the frame being logged
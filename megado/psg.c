@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "blep.h"
 #include "genesis.h"
 #include "psg.h"
 
@@ -9,9 +10,12 @@ void write_latch(PSG*, uint8_t);
 void write_data(PSG*, uint8_t);
 void square_clock_frequency(SquareChannel*);
 void noise_clock_frequency(PSG*);
+static void square_reload(SquareChannel*);
+static void noise_reload(PSG*);
+static void advance(PSG*, uint32_t clocks, Blep*, double time, double step);
 
 // Divisor for the master clock frequency
-static const uint8_t MASTER_CYCLES_PER_CLOCK = 240;
+static const uint8_t MASTER_CYCLES_PER_CLOCK = PSG_MASTER_CYCLES_PER_SAMPLE;
 static const uint32_t NTSC_FREQUENCY = 53693175;
 
 static const int16_t volume_table[16]= {
@@ -66,9 +70,94 @@ void psg_clock(PSG* p) {
 void psg_run_cycles(PSG* p, uint32_t cycles) {
     p->remaining_master_cycles += cycles;
 
-    while (p->remaining_master_cycles > 0) {
-        psg_clock(p);
-        p->remaining_master_cycles -= MASTER_CYCLES_PER_CLOCK;
+    if (p->remaining_master_cycles > 0) {
+        uint32_t clocks = (p->remaining_master_cycles + MASTER_CYCLES_PER_CLOCK - 1) / MASTER_CYCLES_PER_CLOCK;
+        advance(p, clocks, NULL, 0, 0);
+        p->remaining_master_cycles -= clocks * MASTER_CYCLES_PER_CLOCK;
+    }
+}
+
+// Emulate `clocks` clocks, recording the output changes in `b`.
+// `time` is the position of the first clock in `b`, and `step` the distance between two clocks.
+void psg_render(PSG* p, Blep* b, uint32_t clocks, double time, double step) {
+    // Registers written since the last clock
+    blep_set_level(b, time, psg_mix(p));
+
+    advance(p, clocks, b, time, step);
+}
+
+// For the channels whose output cannot change anymore
+static const uint32_t NEVER = UINT32_MAX;
+
+// Clocks until a channel reloads its counter, and changes its output
+static uint32_t square_next_reload(SquareChannel* s) {
+    if (s->counter > 0) {
+        return s->counter;
+    }
+    // A zero tone stays at +1, reloading changes nothing
+    if (s->tone == 0 && s->output) {
+        return NEVER;
+    }
+    return 1;
+}
+
+static uint32_t noise_next_reload(NoiseChannel* n) {
+    return n->counter > 0 ? n->counter : 1;
+}
+
+// Instead of decrementing the counters on every clock, jump from one reload
+// to the next: the cost depends on the number of output changes only
+static void advance(PSG* p, uint32_t clocks, Blep* b, double time, double step) {
+    uint32_t done = 0;
+
+    for (;;) {
+        uint32_t next[4];
+        uint32_t clocks_to_reload = NEVER;
+
+        for (int i=0; i < 3; ++i) {
+            next[i] = square_next_reload(&p->square[i]);
+        }
+        next[3] = noise_next_reload(&p->noise);
+
+        for (int i=0; i < 4; ++i) {
+            if (next[i] < clocks_to_reload) {
+                clocks_to_reload = next[i];
+            }
+        }
+
+        if (clocks_to_reload > clocks - done) {
+            break;
+        }
+        done += clocks_to_reload;
+
+        for (int i=0; i < 3; ++i) {
+            if (next[i] == clocks_to_reload) {
+                square_reload(&p->square[i]);
+            } else if (p->square[i].counter > 0) {
+                p->square[i].counter -= clocks_to_reload;
+            }
+        }
+
+        if (next[3] == clocks_to_reload) {
+            noise_reload(p);
+        } else {
+            p->noise.counter -= clocks_to_reload;
+        }
+
+        if (b != NULL) {
+            blep_set_level(b, time + (done - 1) * step, psg_mix(p));
+        }
+    }
+
+    // No reload until the end
+    uint32_t rest = clocks - done;
+    for (int i=0; i < 3; ++i) {
+        if (p->square[i].counter > 0) {
+            p->square[i].counter -= rest;
+        }
+    }
+    if (p->noise.counter > 0) {
+        p->noise.counter -= rest;
     }
 }
 
@@ -80,19 +169,22 @@ void square_clock_frequency(SquareChannel* s) {
     // Doc seems to state that reloading can happen in the same clock the
     // counter has gone to zero
     if (s->counter == 0) {
-        // Reload counter
-        s->counter = s->tone;
-
-        // If the tone register is 0, output is always +1
-        // XXX: the doc is ambiguous, as it states that a value of 1 also
-        // outputs +1, but it also states that 1 corresponds to the highest
-        // frequency that can be output.
-        if (s->tone == 0) {
-            s->output = 1;
-        } else {
-        // Otherwise flip output
-            s->output = !s->output;
-        }
+        square_reload(s);
+    }
+}
+
+static void square_reload(SquareChannel* s) {
+    s->counter = s->tone;
+
+    // If the tone register is 0, output is always +1
+    // XXX: the doc is ambiguous, as it states that a value of 1 also
+    // outputs +1, but it also states that 1 corresponds to the highest
+    // frequency that can be output.
+    if (s->tone == 0) {
+        s->output = 1;
+    } else {
+    // Otherwise flip output
+        s->output = !s->output;
     }
 }
 
@@ -119,26 +211,31 @@ void noise_clock_frequency(PSG* p) {
     }
 
     if (n->counter == 0) {
-        // Reload counter
-        switch (n->shift_rate) {
-        case 0x00: n->counter = 0x10; break;
-        case 0x01: n->counter = 0x20; break;
-        case 0x02: n->counter = 0x40; break;
-        case 0x03: n->counter = p->square[2].tone; break;
-        }
+        noise_reload(p);
+    }
+}
 
-        // Shift bit in LFSR
-        uint8_t out = n->lfsr & 1;
-        // Output bit is written back to input in periodic mode
-        uint8_t in = out;
-        if (n->mode == 1) {
-            // In white noise mode, input is XORed with bit 3
-            in ^= ((n->lfsr >> 3) & 1);
-        }
-        n->lfsr = (in << 15) | ((n->lfsr >> 1) & 0x7fff);
+static void noise_reload(PSG* p) {
+    NoiseChannel* n = &p->noise;
 
-        n->output = out;
+    switch (n->shift_rate) {
+    case 0x00: n->counter = 0x10; break;
+    case 0x01: n->counter = 0x20; break;
+    case 0x02: n->counter = 0x40; break;
+    case 0x03: n->counter = p->square[2].tone; break;
     }
+
+    // Shift bit in LFSR
+    uint8_t out = n->lfsr & 1;
+    // Output bit is written back to input in periodic mode
+    uint8_t in = out;
+    if (n->mode == 1) {
+        // In white noise mode, input is XORed with bit 3
+        in ^= ((n->lfsr >> 3) & 1);
+    }
+    n->lfsr = (in << 15) | ((n->lfsr >> 1) & 0x7fff);
+
+    n->output = out;
 }
 
 int16_t noise_output(NoiseChannel* n) {
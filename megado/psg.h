@@ -5,8 +5,12 @@
 // PSG: Programmable Sound Generator
 // see: http://www.smspower.org/Development/SN76489
 
+struct Blep;
 struct Genesis;
 
+// The PSG is clocked, and sampled, every 240 master cycles (about 224kHz)
+#define PSG_MASTER_CYCLES_PER_SAMPLE 240
+
 typedef struct SquareChannel {
     uint8_t  volume  : 4;
     uint16_t tone    : 10;
@@ -48,6 +52,7 @@ void psg_write(PSG*, uint8_t);
 void psg_clock(PSG*);
 void psg_run_cycles(PSG*, uint32_t);
 int16_t psg_mix(PSG*);
+void psg_render(PSG*, struct Blep*, uint32_t clocks, double time, double step);
 
 float square_tone_in_hertz(SquareChannel*);
 int16_t square_output(SquareChannel*);
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "render_pipeline.h"
+#include "utils.h"
+
+#define QUEUE_MASK (RENDER_QUEUE_LENGTH - 1)
+
+// Set in the triple buffer's middle index when it holds a frame that was not picked up yet
+#define FRESH_FRAME 4
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+// Render thread
+
+static void publish_frame(RenderPipeline* p, uint16_t frame)
+{
+    RenderedFrame* rendered = &p->frames[p->back];
+    rendered->frame = frame;
+    rendered->render_time = p->render_time;
+    p->render_time = 0;
+
+    int previous = p->back;
+    p->back = SDL_AtomicSet(&p->middle, p->back | FRESH_FRAME) & 3;
+
+    // Lines that are not drawn (e.g. display disabled) keep their previous content
+    memcpy(p->frames[p->back].pixels, p->frames[previous].pixels, BUFFER_SIZE);
+    p->state->output_buffer = p->frames[p->back].pixels;
+}
+
+static void process_entry(RenderPipeline* p, VdpLogEntry* entry)
+{
+    switch (entry->type)
+    {
+    case RenderJob_Line:
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+        vdp_render_scanline(p->state, entry->line, &p->buffers);
+        p->render_time += (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        break;
+    }
+
+    case RenderJob_EndFrame:
+        publish_frame(p, entry->value);
+        break;
+
+    case RenderJob_Sync:
+        break;
+
+    default:
+        vdp_apply_log_entry(p->state, entry);
+        return;
+    }
+
+    SDL_AtomicAdd(&p->completed_jobs, 1);
+}
+
+static int render_thread_run(void* data)
+{
+    RenderPipeline* p = data;
+
+    while (true)
+    {
+        SDL_SemWait(p->wake);
+
+        if (p->quit)
+            break;
+
+        // Drain the queue
+        int tail = SDL_AtomicGet(&p->tail);
+        int head = SDL_AtomicGet(&p->head);
+        while (tail != head)
+        {
+            process_entry(p, &p->queue[tail]);
+
+            tail = (tail + 1) & QUEUE_MASK;
+            SDL_AtomicSet(&p->tail, tail);
+
+            if (tail == head)
+                head = SDL_AtomicGet(&p->head);
+        }
+    }
+
+    return 0;
+}
+
+// Emulation thread
+
+static void push(RenderPipeline* p, VdpLogEntry entry)
+{
+    int head = SDL_AtomicGet(&p->head);
+    int next = (head + 1) & QUEUE_MASK;
+
+    // The queue is full: wake the render thread up and wait for some room
+    if (next == SDL_AtomicGet(&p->tail))
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+
+        SDL_SemPost(p->wake);
+        while (next == SDL_AtomicGet(&p->tail))
+            SDL_Delay(0);
+
+        p->stall_time += (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    }
+
+    p->queue[head] = entry;
+    SDL_AtomicSet(&p->head, next);
+}
+
+static void push_job(RenderPipeline* p, RenderJobTypes type, uint16_t line, uint16_t value)
+{
+    push(p, (VdpLogEntry) { type, line, 0, value });
+    ++p->pushed_jobs;
+
+    SDL_SemPost(p->wake);
+}
+
+// Copy the current state of the VDP to the render thread's copy (which must be idle)
+static void reset_state(RenderPipeline* p)
+{
+    memcpy(p->state, p->vdp, sizeof(Vdp));
+    p->state->output_buffer = p->frames[p->back].pixels;
+    p->state->index_buffer = NULL; // Would not match the frames it is drawn with
+    p->state->parallel = NULL;
+    p->state->pipeline = NULL;
+}
+
+RenderPipeline* render_pipeline_make(Vdp* v)
+{
+    RenderPipeline* p = calloc(1, sizeof(RenderPipeline));
+    p->vdp = v;
+    p->queue = calloc(RENDER_QUEUE_LENGTH, sizeof(VdpLogEntry));
+    p->wake = SDL_CreateSemaphore(0);
+    p->state = calloc(1, sizeof(Vdp));
+
+    for (int i = 0; i < 3; ++i)
+        p->frames[i].pixels = calloc(BUFFER_SIZE, sizeof(uint8_t));
+
+    p->back = 0;
+    p->front = 2;
+    SDL_AtomicSet(&p->middle, 1);
+
+    reset_state(p);
+    memcpy(p->frames[p->back].pixels, v->output_buffer, BUFFER_SIZE);
+
+    p->thread = SDL_CreateThread(render_thread_run, "vdp-pipeline", p);
+    if (p->thread == NULL)
+        FATAL("Cannot create render thread: %s", SDL_GetError());
+
+    return p;
+}
+
+void render_pipeline_free(RenderPipeline* p)
+{
+    if (p == NULL)
+        return;
+
+    p->quit = true;
+    SDL_SemPost(p->wake);
+    SDL_WaitThread(p->thread, NULL);
+
+    for (int i = 0; i < 3; ++i)
+        free(p->frames[i].pixels);
+
+    SDL_DestroySemaphore(p->wake);
+    free(p->state);
+    free(p->queue);
+    free(p);
+}
+
+void render_pipeline_push(RenderPipeline* p, VdpLogEntryTypes type, uint16_t address, uint16_t value)
+{
+    push(p, (VdpLogEntry) { type, 0, address, value });
+}
+
+void render_pipeline_draw_line(RenderPipeline* p, int line)
+{
+    push_job(p, RenderJob_Line, line, 0);
+}
+
+// Pick up the last frame published by the render thread, if any
+static void pick_up_frame(RenderPipeline* p)
+{
+    if (SDL_AtomicGet(&p->middle) & FRESH_FRAME)
+    {
+        p->front = SDL_AtomicSet(&p->middle, p->front) & 3;
+
+        RenderedFrame* rendered = &p->frames[p->front];
+        memcpy(p->vdp->output_buffer, rendered->pixels, BUFFER_SIZE);
+
+        p->latency = now() - p->frame_end_times[rendered->frame % RENDER_FRAME_HISTORY];
+        p->frame_render_time = rendered->render_time;
+        p->frame_stall_time = p->stall_time;
+        p->stall_time = 0;
+
+        // The line signatures do not match the lines drawn by the render thread
+        vdp_invalidate_line_cache(p->vdp);
+    }
+}
+
+static void wait_idle(RenderPipeline* p)
+{
+    push_job(p, RenderJob_Sync, 0, 0);
+
+    while ((uint32_t)SDL_AtomicGet(&p->completed_jobs) != p->pushed_jobs)
+        SDL_Delay(0);
+}
+
+void render_pipeline_end_frame(RenderPipeline* p)
+{
+    p->frame_end_times[p->frame % RENDER_FRAME_HISTORY] = now();
+    push_job(p, RenderJob_EndFrame, 0, p->frame);
+    ++p->frame;
+
+    pick_up_frame(p);
+}
+
+void render_pipeline_sync(RenderPipeline* p)
+{
+    wait_idle(p);
+    reset_state(p);
+}
+
+void render_pipeline_finish(RenderPipeline* p)
+{
+    wait_idle(p);
+    pick_up_frame(p);
+}
+
+uint32_t render_pipeline_queue_depth(RenderPipeline* p)
+{
+    return (SDL_AtomicGet(&p->head) - SDL_AtomicGet(&p->tail)) & QUEUE_MASK;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdp.h"
+
+// Must be a power of two
+#define RENDER_QUEUE_LENGTH (1 << 18)
+
+// Number of frames the render thread can lag behind while still measuring the latency
+#define RENDER_FRAME_HISTORY 64
+
+// Besides the VDP changes, the queue carries these jobs
+typedef enum
+{
+    RenderJob_Line = VdpLogEntry_Register + 1, // Draw a line with the current state
+    RenderJob_EndFrame, // Publish the frame
+    RenderJob_Sync // No-op, used to wait for the queue to be drained
+} RenderJobTypes;
+
+// A frame drawn by the render thread
+typedef struct RenderedFrame
+{
+    uint8_t* pixels;
+    uint16_t frame;
+    double render_time; // Time spent drawing it (s)
+} RenderedFrame;
+
+// Pipelined rendering
+//
+// The emulation thread pushes the VDP changes and the lines to draw to a
+// lock-free single-producer/single-consumer queue. The render thread keeps its
+// own copy of the VDP up to date with the changes and draws the lines as they
+// come. Finished frames are handed back through a triple buffer, so the
+// displayed frame lags the emulation by about one frame but neither thread
+// ever waits for the other (unless the queue fills up).
+typedef struct RenderPipeline
+{
+    Vdp* vdp;
+
+    // Emulation thread -> render thread
+    VdpLogEntry* queue;
+    SDL_atomic_t head; // Written by the emulation thread
+    SDL_atomic_t tail; // Written by the render thread
+    SDL_sem* wake;
+    uint32_t pushed_jobs;
+    SDL_atomic_t completed_jobs;
+
+    // Render thread
+    SDL_Thread* thread;
+    Vdp* state;
+    ScanlineBuffers buffers;
+    double render_time;
+    bool quit;
+
+    // Triple buffer: the render thread owns `back`, the emulation thread owns
+    // `front` and `middle` holds the last published frame
+    RenderedFrame frames[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+
+    // Emulation thread
+    uint16_t frame;
+    double frame_end_times[RENDER_FRAME_HISTORY]; // When the emulation thread finished the last frames
+    double stall_time; // Time spent waiting for room in the queue
+
+    // Stats about the last frame picked up
+    double latency; // s
+    double frame_render_time; // s
+    double frame_stall_time; // s
+} RenderPipeline;
+
+RenderPipeline* render_pipeline_make(Vdp*);
+void render_pipeline_free(RenderPipeline*);
+
+void render_pipeline_push(RenderPipeline*, VdpLogEntryTypes type, uint16_t address, uint16_t value);
+void render_pipeline_draw_line(RenderPipeline*, int line);
+void render_pipeline_end_frame(RenderPipeline*); // Also picks up the last frame drawn by the render thread
+
+// Wait for the render thread to be idle and restart it from the current state of the VDP
+void render_pipeline_sync(RenderPipeline*);
+
+// Wait for the render thread to draw everything pushed so far and pick up its last frame,
+// for the output buffer to hold the frame that was just emulated (e.g. to check it)
+void render_pipeline_finish(RenderPipeline*);
+
+uint32_t render_pipeline_queue_depth(RenderPipeline*);
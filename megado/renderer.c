@@ -8,16 +8,21 @@
 #include <string.h>
 
 #include "audio.h"
+#include "debug_view.h"
+#include "emulation_thread.h"
 #include "genesis.h"
 #include "joypad.h"
 #include "metric.h"
+#include "parallel_renderer.h"
 #include "psg.h"
+#include "render_pipeline.h"
 #include "renderer.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
 #include "settings.h"
 #include "utils.h"
 #include "ym2612.h"
 
-#define DISASSEMBLY_LENGTH 10
 #define MEMORY_VIEWER_COLUMNS 16
 
 #define PALETTE_ENTRY_WIDTH 16
@@ -213,11 +218,11 @@ static void init_ui_rendering(Renderer* r)
 
     ImFontAtlas_SetTexID(io->Fonts, (ImTextureID)(intptr_t)ui_font_texture);
 
-    // Setup texture for the patterns and planes debug views
-    gen_texture(&r->ui_patterns_texture);
+    // Setup the images of the patterns, planes and sprites debug views
+    r->patterns_view = debug_view_make(PATTERNS_COLUMNS * 8, PATTERNS_COUNT / PATTERNS_COLUMNS * 8);
+    r->plane_view = debug_view_make(64 * 8, 64 * 8);
+    r->sprites_view = debug_view_make(552, 552);
     gen_texture(&r->ui_magnified_pattern_texture);
-    gen_texture(&r->ui_planes_texture);
-    gen_texture(&r->ui_sprites_texture);
 
     // Setup the shaders and buffers
 
@@ -245,16 +250,16 @@ static void init_ui_rendering(Renderer* r)
     glVertexAttribPointer(shader_color_loc, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(struct ImDrawVert), (GLvoid*)(2 * sizeof(struct ImVec2)));
 }
 
-static void render_genesis(Renderer* r)
+static void render_genesis(Renderer* r, EmulationView* view)
 {
     // Update the game texture with the Genesis' output
 
-    uint16_t output_width, output_height;
-    vdp_get_resolution(r->genesis->vdp, &output_width, &output_height);
+    uint16_t output_width = view->output_width;
+    uint16_t output_height = view->output_height;
 
     glBindTexture(GL_TEXTURE_2D, r->game_texture);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, BUFFER_WIDTH); // Whatever the current width of the output, be sure to consider the buffer full width (in low resolution mode, the rightmost pixels will be skipped)
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, output_width, output_height, 0, GL_RGB, GL_UNSIGNED_BYTE, r->genesis->vdp->output_buffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, output_width, output_height, 0, GL_RGB, GL_UNSIGNED_BYTE, view->output_buffer);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
     // The Genesis' video output will be displayed on the following screen-aligned quad
@@ -379,12 +384,24 @@ static void memory_viewer(char* name, bool* opened, void* data, Size data_size,
     igEnd();
 }
 
+static void send(Renderer* r, Command command)
+{
+    emulation_thread_send(r->genesis->emulation, command);
+}
+
 static void toggle_pause(Renderer* r)
 {
-    if (r->genesis->status == Status_Running)
-        r->genesis->status = Status_Pause;
-    else if (r->genesis->status == Status_Pause)
-        r->genesis->status = Status_Running;
+    send(r, (Command) { .type = Command_TogglePause });
+}
+
+static void press(Renderer* r, int joypad, JoypadButton button)
+{
+    send(r, (Command) { .type = Command_PressButton, .index = joypad, .value = button });
+}
+
+static void release(Renderer* r, int joypad, JoypadButton button)
+{
+    send(r, (Command) { .type = Command_ReleaseButton, .index = joypad, .value = button });
 }
 
 static void toggle_full_screen(Renderer* r)
@@ -413,8 +430,7 @@ static void toggle_vsync(Renderer* r) {
 
 static void step(Renderer* r)
 {
-    if (r->genesis->status == Status_Pause)
-        genesis_step(r->genesis);
+    send(r, (Command) { .type = Command_Step });
 }
 
 // Return the cursor's position in screen space
@@ -449,7 +465,7 @@ static void text_on_off(bool state, const char* format, ...)
     igTextColored(state ? color_accent : color_dimmed, state ? "on" : "off");
 }
 
-static void build_ui(Renderer* r)
+static void build_ui(Renderer* r, EmulationView* view)
 {
     Settings* settings = r->genesis->settings;
 
@@ -469,14 +485,14 @@ static void build_ui(Renderer* r)
                     igText("Slot %d:", slot);
                     igSameLine(0, 5);
 
-                    if (r->snapshots[slot] == NULL)
+                    if (view->snapshot_dates[slot] == 0)
                     {
                         igTextColored(color_dimmed, "       empty       ");
                     }
                     else
                     {
                         char date[30];
-                        strftime(date, 30, "%Y-%m-%d %H:%M:%S", localtime(&r->snapshots[slot]->date));
+                        strftime(date, 30, "%Y-%m-%d %H:%M:%S", localtime(&view->snapshot_dates[slot]));
                         igTextColored(color_accent, "%s", date);
                     }
 
@@ -485,11 +501,11 @@ static void build_ui(Renderer* r)
                     char button_name[10];
                     sprintf(button_name, "save##%d", slot);
                     if (igButton(button_name, (struct ImVec2) { 50, 20 }))
-                        r->snapshots[slot] = snapshot_save(r->genesis, slot);
+                        send(r, (Command) { .type = Command_SaveSnapshot, .index = slot });
 
                     igSameLine(0, 3);
 
-                    if (r->snapshots[slot] == NULL)
+                    if (view->snapshot_dates[slot] == 0)
                     {
                         igPushStyleColor(ImGuiCol_Button, color_disabled);
                         igPushStyleColor(ImGuiCol_ButtonHovered, color_disabled);
@@ -502,7 +518,7 @@ static void build_ui(Renderer* r)
                     {
                         sprintf(button_name, "load##%d", slot);
                         if (igButton(button_name, (struct ImVec2) { 50, 20 }))
-                            snapshot_load(r->genesis, slot);
+                            send(r, (Command) { .type = Command_LoadSnapshot, .index = slot });
                     }
                 }
                 igEndMenu();
@@ -512,12 +528,12 @@ static void build_ui(Renderer* r)
             igSliderFloat("Speed", &settings->emulation_speed, 0.2f, 3.0f, "%f", 1.0f);
 
             if (igMenuItem("Reset", NULL, false, true))
-                genesis_initialize(r->genesis);
+                send(r, (Command) { .type = Command_Reset });
 
-            if (igMenuItem(r->genesis->status == Status_Running ? "Pause" : "Resume", glfwGetKeyName(GLFW_KEY_P, 0), false, r->genesis->status != Status_NoGameLoaded))
+            if (igMenuItem(view->status == Status_Running ? "Pause" : "Resume", glfwGetKeyName(GLFW_KEY_P, 0), false, view->status != Status_NoGameLoaded))
                 toggle_pause(r);
 
-            if (igMenuItem("Step", "Space", false, r->genesis->status == Status_Pause))
+            if (igMenuItem("Step", "Space", false, view->status == Status_Pause))
                 step(r);
 
             igSeparator();
@@ -547,6 +563,27 @@ static void build_ui(Renderer* r)
             if (igMenuItem("VSync", NULL, settings->vsync, true)) {
                 toggle_vsync(r);
             }
+
+            // Render one frame out of N
+            int frameskip_interval = view->state.vdp.frameskip.interval;
+            if (igSliderInt("Frame skip", &frameskip_interval, 1, 10, "1 in %.0f"))
+                send(r, (Command) { .type = Command_SetFrameskipInterval, .value = frameskip_interval });
+
+            bool incremental = view->incremental_rendering;
+            if (igMenuItemPtr("Incremental rendering", NULL, &incremental, true))
+                send(r, (Command) { .type = Command_SetIncrementalRendering, .enabled = incremental });
+
+            // Draw the frames on several threads
+            int render_threads = view->render_threads > 0 ? view->render_threads : 1;
+            if (igSliderInt("Render threads", &render_threads, 1, 8, "%.0f"))
+                send(r, (Command) { .type = Command_SetRenderThreads, .value = render_threads });
+
+            // Draw the frames on a dedicated thread, one frame behind
+            if (igMenuItem("Pipelined rendering", NULL, view->pipelined, settings->run_ahead_frames == 0))
+                send(r, (Command) { .type = Command_SetPipelinedRendering, .enabled = !view->pipelined });
+
+            // Display the frame N frames ahead of the emulation to hide input latency
+            igSliderInt("Run-ahead", &settings->run_ahead_frames, 0, RUN_AHEAD_MAX_FRAMES, "%.0f frames");
             igSeparator();
             igMenuItemPtr("Registers", NULL, &settings->show_vdp_registers, true);
             igMenuItemPtr("Palettes", NULL, &settings->show_vdp_palettes, true);
@@ -577,29 +614,31 @@ static void build_ui(Renderer* r)
     // M68K registers
     if (settings->show_m68k_registers)
     {
+        M68k* m = &view->state.m68k;
+
         igBegin("CPU registers", &settings->show_m68k_registers, 0);
         igColumns(2, NULL, true);
 
         for (int i = 0; i < 8; ++i)
-            igText("D%d: %08X", i, r->genesis->m68k->data_registers[i]);
+            igText("D%d: %08X", i, m->data_registers[i]);
 
         igNextColumn();
 
         for (int i = 0; i < 8; ++i)
-            igText("A%d: %08X", i, r->genesis->m68k->address_registers[i]);
+            igText("A%d: %08X", i, m->address_registers[i]);
 
         igColumns(1, NULL, false);
         igSeparator();
 
-        igText("Status: %04X", r->genesis->m68k->status);
+        igText("Status: %04X", m->status);
 
 #define STATUS_BIT(label, bit) igText(label); igCheckbox("", & bit); igNextColumn()
 
-        bool extended = EXTENDED(r->genesis->m68k);
-        bool negative = NEGATIVE(r->genesis->m68k);
-        bool zero = ZERO(r->genesis->m68k);
-        bool overflow = OVERFLOW(r->genesis->m68k);
-        bool carry = CARRY(r->genesis->m68k);
+        bool extended = EXTENDED(m);
+        bool negative = NEGATIVE(m);
+        bool zero = ZERO(m);
+        bool overflow = OVERFLOW(m);
+        bool carry = CARRY(m);
 
         igPushStyleColor(ImGuiCol_CheckMark, color_accent);
         igColumns(5, NULL, false);
@@ -613,8 +652,8 @@ static void build_ui(Renderer* r)
         igColumns(1, NULL, false);
         igSeparator();
 
-        igText("PC:     %08X", r->genesis->m68k->pc);
-        igText("Cycles: %08X", r->genesis->m68k->cycles);
+        igText("PC:     %08X", m->pc);
+        igText("Cycles: %08X", m->cycles);
 
         igEnd();
     }
@@ -637,13 +676,13 @@ static void build_ui(Renderer* r)
         igNextColumn();
         igSeparator();
 
-        uint32_t address = r->genesis->m68k->pc;
         for (int i = 0; i < DISASSEMBLY_LENGTH; ++i)
         {
-            DecodedInstruction* instr = m68k_decode(r->genesis->m68k, address);
+            DisassembledInstruction* instr = &view->m68k_disassembly[i];
+            uint32_t address = instr->address;
 
             // The memory may not contain valid opcodes, especially after branching instructions
-            if (instr == NULL)
+            if (instr->length == 0)
             {
                 igColumns(1, NULL, false);
                 igTextColored(color_dimmed, "Cannot decode opcode at %06X", address);
@@ -656,7 +695,7 @@ static void build_ui(Renderer* r)
             }
 
             // Draw a bubble on lines with a breakpoint
-            if (debugger_get_breakpoint(r->genesis->debugger, address) != NULL)
+            if (instr->breakpoint)
             {
                 struct ImDrawList* draw_list = igGetWindowDrawList();
 
@@ -678,19 +717,16 @@ static void build_ui(Renderer* r)
             // TODO would be nice to have a hover feedback
             // TODO would be better to click the whole row but grouping seems to be interrupted by columns :(
             if (igIsItemClicked(0))
-                debugger_toggle_breakpoint(r->genesis->debugger, address);
+                send(r, (Command) { .type = Command_ToggleBreakpoint, .address = address });
 
             igNextColumn();
 
             for (int byte = 0; byte < instr->length; ++byte)
             {
-                igTextColored(color_dimmed, "%02X ", m68k_read_b(r->genesis->m68k, address + byte));
+                igTextColored(color_dimmed, "%02X ", instr->bytes[byte]);
                 igSameLine(0, 0);
             }
             igNextColumn();
-
-            address += instr->length;
-            decoded_instruction_free(instr);
         }
 
         igColumns(1, NULL, false);
@@ -700,17 +736,21 @@ static void build_ui(Renderer* r)
 
         for (uint8_t i = 0; i < BREAKPOINTS_COUNT; ++i)
         {
-            Breakpoint* b = &r->genesis->debugger->breakpoints[i];
+            Breakpoint b = view->breakpoints[i];
+            bool changed = false;
 
             char name_buffer[100];
 
             sprintf(name_buffer, "##be%d", i);
-            igCheckbox(name_buffer, &b->enabled);
+            changed |= igCheckbox(name_buffer, &b.enabled);
 
             igSameLine(0, 10);
 
             sprintf(name_buffer, "##ba%d", i);
-            igInputInt(name_buffer, (int*)&b->address, 1, 2, ImGuiInputTextFlags_CharsHexadecimal);
+            changed |= igInputInt(name_buffer, (int*)&b.address, 1, 2, ImGuiInputTextFlags_CharsHexadecimal);
+
+            if (changed)
+                send(r, (Command) { .type = Command_SetBreakpoint, .index = i, .enabled = b.enabled, .address = b.address });
         }
 
         igEnd();
@@ -719,7 +759,7 @@ static void build_ui(Renderer* r)
     // Z80 registers
     if (settings->show_z80_registers)
     {
-        Z80* z = r->genesis->z80;
+        Z80* z = &view->state.z80;
 
         igBegin("Z80 registers", &settings->show_z80_registers, 0);
         igColumns(2, NULL, true);
@@ -739,8 +779,8 @@ static void build_ui(Renderer* r)
         igText("DE': %04X", z->de_);
         igText("HL': %04X", z->hl_);
         igText("IY:  %04X", z->iy);
-        igText("PC:  %04X", r->genesis->z80->pc);
-        igText("SP:  %04X", r->genesis->z80->sp);
+        igText("PC:  %04X", z->pc);
+        igText("SP:  %04X", z->sp);
 
         igColumns(1, NULL, false);
         igSeparator();
@@ -780,16 +820,11 @@ static void build_ui(Renderer* r)
     {
         igBegin("CPU log", &settings->show_m68k_log, 0);
 
-        Debugger* d = r->genesis->debugger;
         for (int i = 0; i < M68K_LOG_LENGTH; ++i)
         {
-            uint32_t address = d->m68k_log_addresses[(d->m68k_log_cursor + 1 + i) % M68K_LOG_LENGTH];
-            DecodedInstruction* instr = m68k_decode(r->genesis->m68k, address);
-            if (instr != NULL)
-            {
-                igText("%04X   %s", address, instr->mnemonics);
-                decoded_instruction_free(instr);
-            }
+            DisassembledInstruction* instr = &view->m68k_log[i];
+            if (instr->length > 0)
+                igText("%04X   %s", instr->address, instr->mnemonics);
         }
 
         igSetScrollHere(0);     // scroll to bottom
@@ -816,13 +851,13 @@ static void build_ui(Renderer* r)
         igNextColumn();
         igSeparator();
 
-        uint32_t address = r->genesis->z80->pc;
         for (int i = 0; i < DISASSEMBLY_LENGTH; ++i)
         {
-            FullyDecodedZ80Instruction* instr = z80_decode(r->genesis->z80, address);
+            DisassembledInstruction* instr = &view->z80_disassembly[i];
+            uint32_t address = instr->address;
 
             // The memory may not contain valid opcodes, especially after branching instructions
-            if (instr == NULL)
+            if (instr->length == 0)
             {
                 igColumns(1, NULL, false);
                 igTextColored(color_dimmed, "Cannot decode opcode at %04X", address);
@@ -843,14 +878,10 @@ static void build_ui(Renderer* r)
 
             for (int byte = 0; byte < instr->length; ++byte)
             {
-                igTextColored(color_dimmed, "%02X ", z80_read(r->genesis->z80, address + byte));
+                igTextColored(color_dimmed, "%02X ", instr->bytes[byte]);
                 igSameLine(0, 0);
             }
             igNextColumn();
-
-            address += instr->length;
-
-            fully_decoded_z80_instruction_free(instr);
         }
 
         igEnd();
@@ -861,10 +892,9 @@ static void build_ui(Renderer* r)
     {
         igBegin("Z80 log", &settings->show_z80_log, 0);
 
-        Debugger* d = r->genesis->debugger;
         for (int i = 0; i < Z80_LOG_LENGTH; ++i)
         {
-            LoggedZ80Instruction* instr = &d->z80_log_instrs[(d->z80_log_cursor + 1 + i) % Z80_LOG_LENGTH];
+            LoggedZ80Instruction* instr = &view->z80_log[i];
             igText("%04X   %s", instr->address, instr->mnemonics);
         }
 
@@ -872,13 +902,13 @@ static void build_ui(Renderer* r)
         igEnd();
     }
 
-    // ROM
+    // ROM, only replaced while the emulation thread is stopped
     if (settings->show_rom)
-        memory_viewer("ROM", &settings->show_rom, r->genesis->rom, Byte, 0x400000, &r->rom_target_address);
+        memory_viewer("ROM", &settings->show_rom, r->genesis->rom, Byte, r->genesis->rom_size, &r->rom_target_address);
 
     // RAM
     if (settings->show_ram)
-        memory_viewer("RAM", &settings->show_ram, r->genesis->ram, Byte, 0x10000, &r->ram_target_address);
+        memory_viewer("RAM", &settings->show_ram, view->state.ram, Byte, 0x10000, &r->ram_target_address);
 
     // VDP registers
     if (settings->show_vdp_registers)
@@ -886,7 +916,7 @@ static void build_ui(Renderer* r)
         igBegin("VDP registers", &settings->show_vdp_registers, 0);
         igColumns(3, NULL, false);
 
-        Vdp* v = r->genesis->vdp;
+        Vdp* v = &view->state.vdp;
 
 #define REGISTER_SECTION(reg) igTextColored(color_title, "Register %0X [%02X]", reg, v->register_raw_values[reg])
 
@@ -1007,7 +1037,7 @@ static void build_ui(Renderer* r)
                 cell_bottom_right.x = cell_top_left.x + PALETTE_ENTRY_WIDTH;
                 cell_bottom_right.y = cell_top_left.y + PALETTE_ENTRY_WIDTH;
 
-                Color color = r->genesis->vdp->cram[row * 16 + col];
+                Color color = view->state.vdp.cram[row * 16 + col];
                 ImDrawList_AddRectFilled(draw_list, cell_top_left, cell_bottom_right, 255u << 24 | color.b << 16 | color.g << 8 | color.r, 0, 0);
 
             }
@@ -1025,21 +1055,10 @@ static void build_ui(Renderer* r)
         igPushStyleVarVec(ImGuiStyleVar_WindowPadding, vec_zero);
         igBegin("VDP patterns", &settings->show_vdp_patterns, ImGuiWindowFlags_NoResize);
 
-        // Update the pattern texture with the VRAM contents
-
-        uint8_t patterns_buffer[PATTERNS_COUNT * 64 * 3]; // n patterns * 64 pixels * 3 color components
-
-        for (int pattern = 0; pattern < PATTERNS_COUNT; ++pattern)
-        {
-            int x = pattern % PATTERNS_COLUMNS * 8;
-            int y = pattern / PATTERNS_COLUMNS * 8;
-            vdp_draw_pattern(r->genesis->vdp, pattern, debug_palette, patterns_buffer, patterns_width, x, y, false, false);
-        }
-
-        glBindTexture(GL_TEXTURE_2D, r->ui_patterns_texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, patterns_width, patterns_height, 0, GL_RGB, GL_UNSIGNED_BYTE, patterns_buffer);
+        // Update the patterns that changed in VRAM
+        debug_view_update_patterns(r->patterns_view, &view->state.vdp, debug_palette);
 
-        igImage((ImTextureID)(intptr_t)r->ui_patterns_texture, (struct ImVec2) { patterns_width, patterns_height }, vec_zero, vec_one, color_white, color_black);
+        igImage((ImTextureID)(intptr_t)r->patterns_view->texture, (struct ImVec2) { patterns_width, patterns_height }, vec_zero, vec_one, color_white, color_black);
 
         // If a pattern is hovered, show a tooltip with a magnified view
         if (igIsItemHovered())
@@ -1048,7 +1067,7 @@ static void build_ui(Renderer* r)
             uint16_t pattern_index = (int)pattern_pos.y / 8 * PATTERNS_COLUMNS + (int)pattern_pos.x / 8;
 
             uint8_t magnified_pattern_buffer[64 * 3];
-            vdp_draw_pattern(r->genesis->vdp, pattern_index, debug_palette, magnified_pattern_buffer, 8, 0, 0, false, false);
+            vdp_draw_pattern(&view->state.vdp, pattern_index, debug_palette, magnified_pattern_buffer, 8, 0, 0, false, false);
 
             glBindTexture(GL_TEXTURE_2D, r->ui_magnified_pattern_texture);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 8, 8, 0, GL_RGB, GL_UNSIGNED_BYTE, magnified_pattern_buffer);
@@ -1072,15 +1091,10 @@ static void build_ui(Renderer* r)
         igPushStyleVarVec(ImGuiStyleVar_WindowPadding, vec_zero);
         igBegin("VDP planes", &settings->show_vdp_planes, ImGuiWindowFlags_NoResize);
 
-        // Update the plane texture with the selected plane
+        // Update the cells of the selected plane that changed
+        debug_view_update_plane(r->plane_view, &view->state.vdp, r->selected_plane);
 
-        memset(r->plane_buffer, 0, 64 * 8 * 64 * 8 * 3 * sizeof(uint8_t));
-        vdp_draw_plane(r->genesis->vdp, r->selected_plane, r->plane_buffer, 512);
-
-        glBindTexture(GL_TEXTURE_2D, r->ui_planes_texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, plane_width, plane_height, 0, GL_RGB, GL_UNSIGNED_BYTE, r->plane_buffer);
-
-        igImage((ImTextureID)(intptr_t)r->ui_planes_texture, (struct ImVec2) { plane_width, plane_height }, vec_zero, vec_one, color_white, color_black);
+        igImage((ImTextureID)(intptr_t)r->plane_view->texture, (struct ImVec2) { plane_width, plane_height }, vec_zero, vec_one, color_white, color_black);
 
         // If a cell is hovered, show a tooltip with details
         if (igIsItemHovered())
@@ -1088,11 +1102,11 @@ static void build_ui(Renderer* r)
             // Get the data of the hovered cell
 
             struct ImVec2 cell_pos = get_mouse_wrt_window();
-            uint16_t cell_index = (int)cell_pos.y / 8 * r->genesis->vdp->plane_height + (int)cell_pos.x / 8;
+            uint16_t cell_index = (int)cell_pos.y / 8 * view->state.vdp.plane_height + (int)cell_pos.x / 8;
 
             uint16_t pattern_index, palette_index;
             bool priority, horizontal_flip, vertical_flip;
-            vdp_get_plane_cell_data(r->genesis->vdp, r->selected_plane, cell_index, &pattern_index, &palette_index, &priority, &horizontal_flip, &vertical_flip);
+            vdp_get_plane_cell_data(&view->state.vdp, r->selected_plane, cell_index, &pattern_index, &palette_index, &priority, &horizontal_flip, &vertical_flip);
             
             // Draw a border around the hovered cell
 
@@ -1105,10 +1119,10 @@ static void build_ui(Renderer* r)
 
             // Draw a magnified version of the pattern
 
-            Color* palette = r->genesis->vdp->cram + palette_index * 16;
+            Color* palette = view->state.vdp.cram + palette_index * 16;
 
             uint8_t magnified_pattern_buffer[64 * 3];
-            vdp_draw_pattern(r->genesis->vdp, pattern_index, palette, magnified_pattern_buffer, 8, 0, 0, horizontal_flip, vertical_flip);
+            vdp_draw_pattern(&view->state.vdp, pattern_index, palette, magnified_pattern_buffer, 8, 0, 0, horizontal_flip, vertical_flip);
 
             glBindTexture(GL_TEXTURE_2D, r->ui_magnified_pattern_texture);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 8, 8, 0, GL_RGB, GL_UNSIGNED_BYTE, magnified_pattern_buffer);
@@ -1152,20 +1166,15 @@ static void build_ui(Renderer* r)
 
         struct ImVec2 pos = get_cursor();
 
-        // Update the sprite texture
-
-        memset(r->sprites_buffer, 0, 552 * 552 * 3 * sizeof(uint8_t));
-        vdp_draw_sprites(r->genesis->vdp, r->sprites_buffer, 552);
-
-        glBindTexture(GL_TEXTURE_2D, r->ui_sprites_texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 552, 552, 0, GL_RGB, GL_UNSIGNED_BYTE, r->sprites_buffer);
+        // Update the sprites if they changed
+        debug_view_update_sprites(r->sprites_view, &view->state.vdp);
 
-        igImage((ImTextureID)(intptr_t)r->ui_sprites_texture, (struct ImVec2) { 552, 552 }, vec_zero, vec_one, color_white, color_black);
+        igImage((ImTextureID)(intptr_t)r->sprites_view->texture, (struct ImVec2) { 552, 552 }, vec_zero, vec_one, color_white, color_black);
 
         // Draw the screen border
 
         struct ImVec2 a = { pos.x + 128, pos.y + 128 };
-        struct ImVec2 b = { a.x + r->genesis->vdp->display_width * 8, a.y + r->genesis->vdp->display_height * 8 };
+        struct ImVec2 b = { a.x + view->state.vdp.display_width * 8, a.y + view->state.vdp.display_height * 8 };
 
         struct ImDrawList* draw_list = igGetWindowDrawList();
         ImDrawList_AddRect(draw_list, a, b, igGetColorU32Vec(&color_accent), 0, 0, 1);
@@ -1176,11 +1185,11 @@ static void build_ui(Renderer* r)
 
     // VRAM
     if (settings->show_vram)
-        memory_viewer("VRAM", &settings->show_vram, r->genesis->vdp->vram, Byte, 0x10000, NULL);
+        memory_viewer("VRAM", &settings->show_vram, view->state.vdp.vram, Byte, 0x10000, NULL);
 
     // VSRAM
     if (settings->show_vsram)
-        memory_viewer("VSRAM", &settings->show_vsram, r->genesis->vdp->vsram, Word, 0x40, NULL);
+        memory_viewer("VSRAM", &settings->show_vsram, view->state.vdp.vsram, Word, 0x40, NULL);
 
     // CRAM
     if (settings->show_cram)
@@ -1189,19 +1198,19 @@ static void build_ui(Renderer* r)
         // the decoded colors back to words for the debug view
         uint16_t raw_cram[0x40];
         for (int c = 0; c < 0x40; ++c)
-            raw_cram[c] = COLOR_STRUCT_TO_11(r->genesis->vdp->cram[c]);
+            raw_cram[c] = COLOR_STRUCT_TO_11(view->state.vdp.cram[c]);
 
         memory_viewer("CRAM", &settings->show_cram, raw_cram, Word, 0x40, NULL);
     }
 
     // Status bubble when the emulation is paused/rewinding
     // TODO would be better to always keep this overlay on top of the other windows but I don't think it's currently possible
-    if (r->genesis->status == Status_Pause || r->genesis->status == Status_Rewinding)
+    if (view->status == Status_Pause || view->status == Status_Rewinding)
     {
         igSetNextWindowPos((struct ImVec2) { 10, 50 }, 0);
         igPushStyleColor(ImGuiCol_WindowBg, (struct ImVec4) { 1.0f, 1.0f, 1.0f, 0.10f });
         igBegin("Example: Fixed Overlay", &dummy_flag, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings);
-        igTextColored(color_accent, r->genesis->status == Status_Pause ? "Paused" : "Rewinding");
+        igTextColored(color_accent, view->status == Status_Pause ? "Paused" : "Rewinding");
         igEnd();
         igPopStyleColor(1);
     }
@@ -1211,13 +1220,24 @@ static void build_ui(Renderer* r)
     r->last_time = now;
 
     metric_push(r->tpf, dt * 1000);
-    metric_push(r->audio_buffer_queue, SDL_GetQueuedAudioSize(r->genesis->audio->device) / sizeof(int16_t));
+    metric_push(r->emulation_time, view->emulation_time * 1000);
+    metric_push(r->audio_buffer_queue, audio_ring_fill(r->genesis->audio->ring));
+
+    if (view->pipelined) {
+        metric_push(r->render_queue_depth, view->render_queue_depth);
+        metric_push(r->render_latency, view->render_latency * 1000);
+        metric_push(r->render_time_saved, view->render_time_saved * 1000);
+    }
 
     r->metrics_refresh_counter += dt;
     if (r->metrics_refresh_counter > 1) {
         r->metrics_refresh_counter = 0;
         metric_avg(r->tpf);
+        metric_avg(r->emulation_time);
         metric_avg(r->audio_buffer_queue);
+        metric_avg(r->render_queue_depth);
+        metric_avg(r->render_latency);
+        metric_avg(r->render_time_saved);
     }
 
     if (settings->show_metrics) {
@@ -1229,19 +1249,81 @@ static void build_ui(Renderer* r)
             r->tpf->avg, r->tpf->avg > 0 ? 1000.0 / r->tpf->avg : 0);
         metric_plot(r->tpf, buf);
 
+        // Time the emulation thread spent in its last update, in milliseconds
+        snprintf(buf, sizeof(buf), "emulation (ms)\navg: %.2f", r->emulation_time->avg);
+        metric_plot(r->emulation_time, buf);
+
         // (M68k) instructions per frame, in kilos
         snprintf(buf, sizeof buf, "audio queue (samples)\navg: %.2f", r->audio_buffer_queue->avg);
         metric_plot(r->audio_buffer_queue, buf);
 
+        AudioRing* ring = r->genesis->audio->ring;
+        igText("Underruns: %d", SDL_AtomicGet(&ring->underruns));
+        igText("Overruns:  %d (%d samples dropped)", SDL_AtomicGet(&ring->overruns), SDL_AtomicGet(&ring->dropped_samples));
+        igText("Rate:      %+.3f%%", (view->audio_rate - 1) * 100);
+
         igTextColored(color_title, "Remaining audio time: ");
         igSameLine(0,0);
-        igText("%.6fms", r->genesis->audio->remaining_time * 1000);
+        igText("%.6fms", view->audio_remaining_time * 1000);
 
         igTextColored(color_title, "Remaining master cycles");
-        igText("M68k:   %d", r->genesis->m68k->remaining_master_cycles);
-        igText("Z80:    %d", r->genesis->z80->remaining_master_cycles);
-        igText("PSG:    %d", r->genesis->psg->remaining_master_cycles);
-        igText("YM2612: %d", r->genesis->ym2612->remaining_master_cycles);
+        igText("M68k:   %d", view->state.m68k.remaining_master_cycles);
+        igText("Z80:    %d", view->state.z80.remaining_master_cycles);
+        igText("PSG:    %d", view->state.psg.remaining_master_cycles);
+        igText("YM2612: %d", view->state.ym2612.remaining_master_cycles);
+
+        FrameSkip* frameskip = &view->state.vdp.frameskip;
+        igTextColored(color_title, "Frames");
+        igText("Rendered: %llu", (unsigned long long)frameskip->rendered_frames);
+        igText("Skipped:  %llu", (unsigned long long)frameskip->skipped_frames);
+
+        uint64_t drawn_lines = view->line_cache_hits + view->line_cache_misses;
+        igTextColored(color_title, "Line cache");
+        igText("Reused: %llu", (unsigned long long)view->line_cache_hits);
+        igText("Drawn:  %llu", (unsigned long long)view->line_cache_misses);
+        igText("Hit rate: %.1f%%", drawn_lines > 0 ? 100.0 * view->line_cache_hits / drawn_lines : 0.0);
+
+        if (view->render_threads > 0)
+        {
+            igTextColored(color_title, "Parallel rendering");
+            igText("Threads: %d", view->render_threads);
+            igText("Frame:   %.3fms", view->parallel_frame_time * 1000);
+            igText("Log:     %u entries", view->parallel_log_length);
+        }
+
+        if (view->pipelined)
+        {
+            igTextColored(color_title, "Pipelined rendering");
+
+            snprintf(buf, sizeof buf, "render queue (entries)\navg: %.2f", r->render_queue_depth->avg);
+            metric_plot(r->render_queue_depth, buf);
+
+            // Delay between the end of a frame and its display
+            snprintf(buf, sizeof buf, "latency (ms)\navg: %.2f", r->render_latency->avg);
+            metric_plot(r->render_latency, buf);
+
+            // Rendering time moved off the emulation thread, minus the time spent waiting for the queue
+            snprintf(buf, sizeof buf, "time saved (ms)\navg: %.2f", r->render_time_saved->avg);
+            metric_plot(r->render_time_saved, buf);
+        }
+
+        if (settings->run_ahead_frames > 0)
+        {
+            igTextColored(color_title, "Run-ahead");
+            igText("Frames:  %d", settings->run_ahead_frames);
+            igText("Cost:    %.3fms/frame", view->run_ahead_frame_time * 1000);
+            igText("Capture: %.1fus", view->run_ahead_capture_time * 1e6);
+            igText("Restore: %.1fus", view->run_ahead_restore_time * 1e6);
+        }
+
+        if (settings->rewinding_enabled && view->rewind_frame_count > 0)
+        {
+            double history = (double)view->rewind_frame_count / (r->genesis->region == Region_Europe ? 50 : 60);
+            igTextColored(color_title, "Rewind");
+            igText("History: %u frames (%.1fs)", view->rewind_frame_count, history);
+            igText("Memory:  %.2fMB (%.1fKB/s)", view->rewind_used_bytes / (1024.0 * 1024.0), view->rewind_used_bytes / 1024.0 / history);
+            igText("Capture: %.3fms/frame", view->rewind_capture_time * 1000);
+        }
 
         igEnd();
     }
@@ -1251,7 +1333,7 @@ static void build_ui(Renderer* r)
     {
         igBegin("PSG registers", &settings->show_psg_registers, 0);
 
-        PSG* p = r->genesis->psg;
+        PSG* p = &view->state.psg;
 
         for (int i=0; i < 3; ++i) {
             igTextColored(color_title, "Square %d", i);
@@ -1284,7 +1366,7 @@ static void build_ui(Renderer* r)
     {
         igBegin("YM2612 registers", &settings->show_ym2612_registers, 0);
 
-        YM2612* y = r->genesis->ym2612;
+        YM2612* y = &view->state.ym2612;
 
         // Global registers
         igTextColored(color_title, "Global registers");
@@ -1332,7 +1414,8 @@ static void build_ui(Renderer* r)
             igSameLine(20,0);
             char name_buffer[10];
             sprintf(name_buffer, "##chan%d", i);
-            igCheckbox(name_buffer, &y->channels[i].muted);
+            if (igCheckbox(name_buffer, &y->channels[i].muted))
+                send(r, (Command) { .type = Command_MuteChannel, .index = i, .enabled = y->channels[i].muted });
             igPopStyleColor(1);
 
             if ((i+1) % 3 == 0) {
@@ -1412,7 +1495,7 @@ static void build_ui(Renderer* r)
     // igShowTestWindow(&a);
 }
 
-static void render_ui(Renderer* r)
+static void render_ui(Renderer* r, EmulationView* view)
 {
     struct ImGuiIO* io = igGetIO();
 
@@ -1424,7 +1507,7 @@ static void render_ui(Renderer* r)
     io->DisplayFramebufferScale = (struct ImVec2) { window_width > 0 ? ((float)display_width / window_width) : 0, window_height > 0 ? ((float)display_height / window_height) : 0 };
 
     igNewFrame();
-    build_ui(r);
+    build_ui(r, view);
     igRender();
 
     //draw_data->ScaleClipRects(io->DisplayFramebufferScale);
@@ -1495,50 +1578,49 @@ static void handle_inputs(Renderer* r, int key, int action)
     case GLFW_PRESS:
         switch (key)
         {
-        case GLFW_KEY_LEFT  : joypad_press(r->genesis->joypad1, Left); break;
-        case GLFW_KEY_RIGHT : joypad_press(r->genesis->joypad1, Right); break;
-        case GLFW_KEY_UP    : joypad_press(r->genesis->joypad1, Up); break;
-        case GLFW_KEY_DOWN  : joypad_press(r->genesis->joypad1, Down); break;
-        case GLFW_KEY_ENTER : joypad_press(r->genesis->joypad1, Start); break;
-        case GLFW_KEY_Q     : joypad_press(r->genesis->joypad1, ButtonA); break;
-        case GLFW_KEY_W     : joypad_press(r->genesis->joypad1, ButtonB); break;
-        case GLFW_KEY_E     : joypad_press(r->genesis->joypad1, ButtonC); break;
-
-        case GLFW_KEY_1: joypad_press(r->genesis->joypad2, Left); break;
-        case GLFW_KEY_3: joypad_press(r->genesis->joypad2, Right); break;
-        case GLFW_KEY_5: joypad_press(r->genesis->joypad2, Up); break;
-        case GLFW_KEY_2: joypad_press(r->genesis->joypad2, Down); break;
-        case GLFW_KEY_0: joypad_press(r->genesis->joypad2, Start); break;
-        case GLFW_KEY_7: joypad_press(r->genesis->joypad2, ButtonA); break;
-        case GLFW_KEY_8: joypad_press(r->genesis->joypad2, ButtonB); break;
-        case GLFW_KEY_9: joypad_press(r->genesis->joypad2, ButtonC); break;
+        case GLFW_KEY_LEFT  : press(r, 0, Left); break;
+        case GLFW_KEY_RIGHT : press(r, 0, Right); break;
+        case GLFW_KEY_UP    : press(r, 0, Up); break;
+        case GLFW_KEY_DOWN  : press(r, 0, Down); break;
+        case GLFW_KEY_ENTER : press(r, 0, Start); break;
+        case GLFW_KEY_Q     : press(r, 0, ButtonA); break;
+        case GLFW_KEY_W     : press(r, 0, ButtonB); break;
+        case GLFW_KEY_E     : press(r, 0, ButtonC); break;
+
+        case GLFW_KEY_1: press(r, 1, Left); break;
+        case GLFW_KEY_3: press(r, 1, Right); break;
+        case GLFW_KEY_5: press(r, 1, Up); break;
+        case GLFW_KEY_2: press(r, 1, Down); break;
+        case GLFW_KEY_0: press(r, 1, Start); break;
+        case GLFW_KEY_7: press(r, 1, ButtonA); break;
+        case GLFW_KEY_8: press(r, 1, ButtonB); break;
+        case GLFW_KEY_9: press(r, 1, ButtonC); break;
 
         case GLFW_KEY_R:
-            if (r->genesis->settings->rewinding_enabled && r->genesis->status == Status_Running)
-                r->genesis->status = Status_Rewinding;
+            send(r, (Command) { .type = Command_StartRewinding });
             break;
         }
         break;
     case GLFW_RELEASE:
         switch (key)
         {
-        case GLFW_KEY_LEFT  : joypad_release(r->genesis->joypad1, Left); break;
-        case GLFW_KEY_RIGHT : joypad_release(r->genesis->joypad1, Right); break;
-        case GLFW_KEY_UP    : joypad_release(r->genesis->joypad1, Up); break;
-        case GLFW_KEY_DOWN  : joypad_release(r->genesis->joypad1, Down); break;
-        case GLFW_KEY_ENTER : joypad_release(r->genesis->joypad1, Start); break;
-        case GLFW_KEY_Q     : joypad_release(r->genesis->joypad1, ButtonA); break;
-        case GLFW_KEY_W     : joypad_release(r->genesis->joypad1, ButtonB); break;
-        case GLFW_KEY_E     : joypad_release(r->genesis->joypad1, ButtonC); break;
-
-        case GLFW_KEY_1: joypad_release(r->genesis->joypad2, Left); break;
-        case GLFW_KEY_3: joypad_release(r->genesis->joypad2, Right); break;
-        case GLFW_KEY_5: joypad_release(r->genesis->joypad2, Up); break;
-        case GLFW_KEY_2: joypad_release(r->genesis->joypad2, Down); break;
-        case GLFW_KEY_0: joypad_release(r->genesis->joypad2, Start); break;
-        case GLFW_KEY_7: joypad_release(r->genesis->joypad2, ButtonA); break;
-        case GLFW_KEY_8: joypad_release(r->genesis->joypad2, ButtonB); break;
-        case GLFW_KEY_9: joypad_release(r->genesis->joypad2, ButtonC); break;
+        case GLFW_KEY_LEFT  : release(r, 0, Left); break;
+        case GLFW_KEY_RIGHT : release(r, 0, Right); break;
+        case GLFW_KEY_UP    : release(r, 0, Up); break;
+        case GLFW_KEY_DOWN  : release(r, 0, Down); break;
+        case GLFW_KEY_ENTER : release(r, 0, Start); break;
+        case GLFW_KEY_Q     : release(r, 0, ButtonA); break;
+        case GLFW_KEY_W     : release(r, 0, ButtonB); break;
+        case GLFW_KEY_E     : release(r, 0, ButtonC); break;
+
+        case GLFW_KEY_1: release(r, 1, Left); break;
+        case GLFW_KEY_3: release(r, 1, Right); break;
+        case GLFW_KEY_5: release(r, 1, Up); break;
+        case GLFW_KEY_2: release(r, 1, Down); break;
+        case GLFW_KEY_0: release(r, 1, Start); break;
+        case GLFW_KEY_7: release(r, 1, ButtonA); break;
+        case GLFW_KEY_8: release(r, 1, ButtonB); break;
+        case GLFW_KEY_9: release(r, 1, ButtonC); break;
 
         case GLFW_KEY_F     : toggle_full_screen(r); break;
         case GLFW_KEY_P     : toggle_pause(r); break;
@@ -1548,12 +1630,11 @@ static void handle_inputs(Renderer* r, int key, int action)
             if (r->genesis->settings->full_screen)
                 toggle_full_screen(r);
             else
-                r->genesis->status = Status_Quitting;
+                send(r, (Command) { .type = Command_Quit });
             break;
 
         case GLFW_KEY_R:
-            if (r->genesis->status == Status_Rewinding)
-                r->genesis->status = Status_Running;
+            send(r, (Command) { .type = Command_StopRewinding });
             break;
         }
         break;
@@ -1617,7 +1698,7 @@ void window_resize_callback(GLFWwindow* window, int width, int height)
 void window_close_callback(GLFWwindow* window)
 {
     Renderer* r = (Renderer*)glfwGetWindowUserPointer(window);
-    r->genesis->status = Status_Quitting;
+    send(r, (Command) { .type = Command_Quit });
 }
 
 void error_callback(int error, const char* description) {
@@ -1674,8 +1755,6 @@ Renderer* renderer_make(Genesis* genesis)
     Renderer* r = calloc(1, sizeof(Renderer));
     r->genesis = genesis;
     r->window = window;
-    r->plane_buffer = calloc(64 * 8 * 64 * 8 * 3, sizeof(uint8_t));
-    r->sprites_buffer = calloc(552 * 552 * 3, sizeof(uint8_t));
 
     // Store a pointer to the renderer in the window so that it can be accessed from callback functions
     glfwSetWindowUserPointer(r->window, r);
@@ -1683,7 +1762,11 @@ Renderer* renderer_make(Genesis* genesis)
     glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 
     r->tpf = metric_make(128);
+    r->emulation_time = metric_make(128);
     r->audio_buffer_queue = metric_make(128);
+    r->render_queue_depth = metric_make(128);
+    r->render_latency = metric_make(128);
+    r->render_time_saved = metric_make(128);
 
     init_ui_rendering(r);
     init_genesis_rendering(r);
@@ -1698,29 +1781,32 @@ void renderer_free(Renderer* r)
 
     glDeleteProgram(r->game_shader);
     glDeleteProgram(r->ui_shader);
+    debug_view_free(r->patterns_view);
+    debug_view_free(r->plane_view);
+    debug_view_free(r->sprites_view);
 
     igShutdown();
     glfwDestroyWindow(r->window);
     glfwTerminate();
 
-    free(r->plane_buffer);
-    free(r->sprites_buffer);
     metric_free(r->tpf);
+    metric_free(r->emulation_time);
     metric_free(r->audio_buffer_queue);
-
-    for (int i=0; i < SNAPSHOT_SLOTS; ++i) {
-        snapshot_metadata_free(r->snapshots[i]);
-    }
+    metric_free(r->render_queue_depth);
+    metric_free(r->render_latency);
+    metric_free(r->render_time_saved);
 
     free(r);
 }
 
 void renderer_render(Renderer* r)
 {
+    EmulationView* view = emulation_thread_view(r->genesis->emulation);
+
     glClear(GL_COLOR_BUFFER_BIT);
 
-    render_genesis(r);
-    render_ui(r);
+    render_genesis(r, view);
+    render_ui(r, view);
 
     glfwSwapBuffers(r->window);
     glfwPollEvents();
@@ -14,16 +14,20 @@ typedef struct Renderer
     // Window dimensions to be restored when leaving full screen
     int window_previous_width, window_previous_height;
 
-    struct SnapshotMetadata* snapshots[SNAPSHOT_SLOTS];
-
     float last_time;
     float metrics_refresh_counter;
     struct Metric* tpf; // time per frame
+    struct Metric* emulation_time; // per update of the emulation thread
     struct Metric* audio_buffer_queue;
+    struct Metric* render_queue_depth;
+    struct Metric* render_latency;
+    struct Metric* render_time_saved;
 
+    // VDP debug windows
     enum Planes selected_plane;
-    uint8_t* plane_buffer;
-    uint8_t* sprites_buffer;
+    struct DebugView* patterns_view;
+    struct DebugView* plane_view;
+    struct DebugView* sprites_view;
 
     uint32_t rom_target_address;
     uint32_t ram_target_address;
@@ -37,7 +41,7 @@ typedef struct Renderer
 
     // Graphics resources for the user interface
     GLuint ui_shader;
-    GLuint ui_patterns_texture, ui_magnified_pattern_texture, ui_planes_texture, ui_sprites_texture;
+    GLuint ui_magnified_pattern_texture;
     GLuint ui_vertex_array_object, ui_vertex_buffer_object, ui_element_buffer_object;
     GLint ui_shader_texture_loc, ui_shader_projection_loc;
 } Renderer;
@@ -0,0 +1,200 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE
+#endif
+
+#include "resampler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Cutoff frequency, relative to the output rate, and Kaiser window shape.
+// With RESAMPLER_WIDTH, aliases stay around 80dB below the signal.
+static const double CUTOFF = 0.45;
+static const double KAISER_BETA = 8;
+
+// The kernel is rebuilt when the step changes more than that
+static const double STEP_TOLERANCE = 0.01;
+
+Resampler* resampler_make(void)
+{
+    return calloc(1, sizeof(Resampler));
+}
+
+void resampler_free(Resampler* r)
+{
+    if (r == NULL)
+        return;
+
+    free(r->kernel);
+    free(r->input);
+    free(r);
+}
+
+void resampler_clear(Resampler* r)
+{
+    if (r->input != NULL)
+        memset(r->input, 0, r->taps * sizeof(float));
+}
+
+// Modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void build_kernel(Resampler* r, double step)
+{
+    // When downsampling, the kernel stretches to keep the same cutoff at the output rate
+    double stretch = step > 1 ? step : 1;
+    double length = RESAMPLER_WIDTH * stretch; // In input samples
+    uint32_t taps = ((uint32_t)ceil(length) + 7) & ~7u; // The extra taps are zeros
+    double cutoff = CUTOFF / stretch; // In cycles per input sample
+
+    float* kernel = malloc((RESAMPLER_PHASES + 1) * taps * sizeof(float));
+
+    for (uint32_t phase = 0; phase <= RESAMPLER_PHASES; ++phase)
+    {
+        float* row = kernel + phase * taps;
+        double fraction = (double)phase / RESAMPLER_PHASES;
+        double sum = 0;
+
+        // Coefficient k applies to the input sample `taps - 1 - k + fraction` before the output
+        for (uint32_t k = 0; k < taps; ++k)
+        {
+            double distance = taps - 1 - k + fraction;
+            double x = distance - length / 2;
+            double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+            double w = 2 * distance / length - 1;
+            double window = w * w < 1 ? bessel_i0(KAISER_BETA * sqrt(1 - w * w)) / bessel_i0(KAISER_BETA) : 0;
+
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+
+        // Unity gain for every phase
+        for (uint32_t k = 0; k < taps; ++k)
+            row[k] /= sum;
+    }
+
+    // Keep the most recent input samples as the new history
+    if (taps != r->taps)
+    {
+        float* input = calloc(taps, sizeof(float));
+        uint32_t kept = taps < r->taps ? taps : r->taps;
+        if (kept > 0)
+            memcpy(input + taps - kept, r->input + r->taps - kept, kept * sizeof(float));
+
+        free(r->input);
+        r->input = input;
+        r->input_capacity = taps;
+    }
+
+    free(r->kernel);
+    r->kernel = kernel;
+    r->kernel_step = step;
+    r->taps = taps;
+}
+
+// Dot products of the input with two consecutive phases of the kernel
+static void dot2(const float* x, const float* k0, const float* k1, uint32_t taps, float* d0, float* d1)
+{
+#if defined(__AVX__)
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    for (uint32_t i = 0; i < taps; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(x + i);
+        a0 = _mm256_add_ps(a0, _mm256_mul_ps(v, _mm256_loadu_ps(k0 + i)));
+        a1 = _mm256_add_ps(a1, _mm256_mul_ps(v, _mm256_loadu_ps(k1 + i)));
+    }
+    __m128 s0 = _mm_add_ps(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+    __m128 s1 = _mm_add_ps(_mm256_castps256_ps128(a1), _mm256_extractf128_ps(a1, 1));
+#elif defined(RESAMPLER_SSE)
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (uint32_t i = 0; i < taps; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(x + i);
+        s0 = _mm_add_ps(s0, _mm_mul_ps(v, _mm_loadu_ps(k0 + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(v, _mm_loadu_ps(k1 + i)));
+    }
+#else
+    float s0[4] = { 0 }, s1[4] = { 0 };
+    for (uint32_t i = 0; i < taps; i += 4)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            s0[j] += x[i + j] * k0[i + j];
+            s1[j] += x[i + j] * k1[i + j];
+        }
+    }
+    *d0 = (s0[0] + s0[1]) + (s0[2] + s0[3]);
+    *d1 = (s1[0] + s1[1]) + (s1[2] + s1[3]);
+    return;
+#endif
+
+#if defined(__AVX__) || defined(RESAMPLER_SSE)
+    // Horizontal sums of both accumulators at once
+    __m128 lo = _mm_unpacklo_ps(s0, s1); // s0[0] s1[0] s0[1] s1[1]
+    __m128 hi = _mm_unpackhi_ps(s0, s1); // s0[2] s1[2] s0[3] s1[3]
+    __m128 sum = _mm_add_ps(lo, hi);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+    float result[4];
+    _mm_storeu_ps(result, sum);
+    *d0 = result[0];
+    *d1 = result[1];
+#endif
+}
+
+void resampler_run(Resampler* r, const int16_t* in, uint32_t in_count,
+    int16_t* out, uint32_t out_count, double time, double step)
+{
+    if (r->kernel == NULL || fabs(step - r->kernel_step) > r->kernel_step * STEP_TOLERANCE)
+        build_kernel(r, step);
+
+    uint32_t taps = r->taps;
+
+    if (taps + in_count > r->input_capacity)
+    {
+        r->input_capacity = taps + in_count;
+        r->input = realloc(r->input, r->input_capacity * sizeof(float));
+    }
+
+    float* input = r->input + taps;
+    for (uint32_t i = 0; i < in_count; ++i)
+        input[i] = in[i];
+
+    for (uint32_t i = 0; i < out_count; ++i)
+    {
+        double position = time + i * step;
+        double base = floor(position);
+        double phase = (position - base) * RESAMPLER_PHASES;
+        uint32_t row = (uint32_t)phase;
+        float weight = (float)(phase - row);
+
+        // The window ends at the last input sample before the output
+        const float* x = input + (int32_t)base - (int32_t)taps + 1;
+        const float* k0 = r->kernel + row * taps;
+
+        float d0, d1;
+        dot2(x, k0, k0 + taps, taps, &d0, &d1);
+
+        float sample = d0 + (d1 - d0) * weight;
+        out[i] = sample > 32767 ? 32767 : sample < -32768 ? -32768 : (int16_t)lrintf(sample);
+    }
+
+    memmove(r->input, r->input + in_count, taps * sizeof(float));
+}
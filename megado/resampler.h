@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Kernel length, in output samples: the longer, the sharper the cutoff
+#define RESAMPLER_WIDTH 40
+
+// Fractional positions the kernel is tabulated for, the ones in between are interpolated
+#define RESAMPLER_PHASES 128
+
+// Band-limited sample rate conversion of a stream, by a windowed sinc polyphase filter
+//
+// The filter is causal: each output sample only depends on the input samples
+// up to its position, and is delayed by RESAMPLER_WIDTH / 2 output samples.
+typedef struct Resampler
+{
+    // Built for a given step, as the cutoff depends on the output rate
+    double kernel_step;
+    uint32_t taps; // Multiple of 8
+    float* kernel; // (RESAMPLER_PHASES + 1) rows of `taps` coefficients
+
+    // Last `taps` input samples, followed by the ones being resampled
+    float* input;
+    uint32_t input_capacity;
+} Resampler;
+
+Resampler* resampler_make(void);
+void resampler_free(Resampler*);
+
+// Forget the past input samples
+void resampler_clear(Resampler*);
+
+// Append `in_count` input samples, and compute `out_count` output samples.
+// `time` is the position of the first output sample in input samples,
+// counted from the first new one, and `step` the distance between two outputs.
+// The last output sample must not be after the last input sample.
+void resampler_run(Resampler*, const int16_t* in, uint32_t in_count,
+    int16_t* out, uint32_t out_count, double time, double step);
@@ -0,0 +1,294 @@
+#include <SDL.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "genesis.h"
+#include "rewind_buffer.h"
+#include "snapshot.h"
+#include "utils.h"
+
+// A run of changed bytes only ends after that many unchanged bytes,
+// shorter gaps are cheaper to store than to skip
+#define MIN_SKIP 4
+
+// Worst case: every other byte changed
+#define ENCODING_BUFFER_SIZE (2 * sizeof(Snapshot))
+
+#define FRAME(b, i) (&(b)->frames[((b)->first_frame + (i)) % REWIND_MAX_FRAMES])
+
+static uint8_t* write_varint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+
+    *out++ = value;
+    return out;
+}
+
+static const uint8_t* read_varint(const uint8_t* in, uint32_t* value)
+{
+    *value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        uint8_t byte = *in++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return in;
+    }
+}
+
+// Encode the changes from `from` to `to` as a list of
+// (unchanged byte count, changed byte count, XORed changed bytes)
+static uint32_t encode(const uint8_t* from, const uint8_t* to, uint32_t size, uint8_t* out)
+{
+    uint8_t* start = out;
+
+    uint32_t i = 0;
+    while (i < size)
+    {
+        // Skip the unchanged bytes, 8 at a time first
+        uint32_t skip_start = i;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t a, b;
+            memcpy(&a, from + i, 8);
+            memcpy(&b, to + i, 8);
+            if (a != b)
+                break;
+        }
+
+        while (i < size && from[i] == to[i])
+            ++i;
+
+        if (i == size)
+            break;
+
+        // Find where the changes end
+        uint32_t changes_start = i;
+        uint32_t changes_end = ++i;
+        for (; i < size && i - changes_end < MIN_SKIP; ++i)
+            if (from[i] != to[i])
+                changes_end = i + 1;
+
+        i = changes_end;
+
+        out = write_varint(out, changes_start - skip_start);
+        out = write_varint(out, changes_end - changes_start);
+        for (uint32_t j = changes_start; j < changes_end; ++j)
+            *out++ = from[j] ^ to[j];
+    }
+
+    return (uint32_t)(out - start);
+}
+
+// Apply encoded changes in place (works both ways since the changes are XORed)
+static void decode(uint8_t* state, const uint8_t* data, uint32_t length)
+{
+    const uint8_t* end = data + length;
+    while (data < end)
+    {
+        uint32_t skip, count;
+        data = read_varint(data, &skip);
+        data = read_varint(data, &count);
+
+        state += skip;
+        for (uint32_t i = 0; i < count; ++i)
+            *state++ ^= *data++;
+    }
+}
+
+RewindBuffer* rewind_buffer_make()
+{
+    return calloc(1, sizeof(RewindBuffer));
+}
+
+void rewind_buffer_free(RewindBuffer* b)
+{
+    if (b == NULL)
+        return;
+
+    rewind_buffer_release(b);
+    free(b);
+}
+
+static void allocate(RewindBuffer* b)
+{
+    b->arena = malloc(REWIND_ARENA_SIZE);
+    b->frames = calloc(REWIND_MAX_FRAMES, sizeof(RewindFrame));
+    b->state = calloc(1, sizeof(Snapshot));
+    b->next_state = calloc(1, sizeof(Snapshot));
+    b->empty_state = calloc(1, sizeof(Snapshot));
+    b->encoding_buffer = malloc(ENCODING_BUFFER_SIZE);
+
+    if (b->arena == NULL)
+        FATAL("Cannot allocate the rewind arena");
+}
+
+void rewind_buffer_release(RewindBuffer* b)
+{
+    if (b->arena == NULL)
+        return;
+
+    free(b->encoding_buffer);
+    free(b->empty_state);
+    free(b->next_state);
+    free(b->state);
+    free(b->frames);
+    free(b->arena);
+
+    b->arena = NULL;
+    b->frames = NULL;
+    b->state = NULL;
+    b->next_state = NULL;
+    b->empty_state = NULL;
+    b->encoding_buffer = NULL;
+
+    rewind_buffer_clear(b);
+}
+
+void rewind_buffer_clear(RewindBuffer* b)
+{
+    b->arena_head = 0;
+    b->first_frame = 0;
+    b->frame_count = 0;
+    b->frames_since_keyframe = 0;
+    b->used_bytes = 0;
+}
+
+// Drop the oldest keyframe along with the deltas built upon it
+static void evict_oldest_group(RewindBuffer* b)
+{
+    do
+    {
+        b->used_bytes -= FRAME(b, 0)->length;
+        b->first_frame = (b->first_frame + 1) % REWIND_MAX_FRAMES;
+        --b->frame_count;
+    } while (b->frame_count > 0 && !FRAME(b, 0)->keyframe);
+
+    if (b->frame_count == 0)
+        b->arena_head = 0;
+}
+
+// Find room for a new frame in the arena, evicting the oldest frames if needed.
+// Returns false if the whole history had to be evicted.
+static bool reserve(RewindBuffer* b, uint32_t length, uint32_t* offset)
+{
+    while (b->frame_count > 0)
+    {
+        uint32_t start = FRAME(b, 0)->offset;
+
+        if (b->arena_head > start)
+        {
+            // The frames lie in [start, head): room after them or at the beginning of the arena
+            if (b->arena_head + length <= REWIND_ARENA_SIZE)
+            {
+                *offset = b->arena_head;
+                return true;
+            }
+
+            if (length <= start)
+            {
+                *offset = 0;
+                return true;
+            }
+        }
+        else if (b->arena_head + length <= start)
+        {
+            // The frames wrap around: room in [head, start)
+            *offset = b->arena_head;
+            return true;
+        }
+
+        evict_oldest_group(b);
+    }
+
+    *offset = 0;
+    return false;
+}
+
+void rewind_buffer_push(RewindBuffer* b, struct Genesis* g)
+{
+    uint64_t start = SDL_GetPerformanceCounter();
+
+    if (b->arena == NULL)
+        allocate(b);
+
+    snapshot_capture(g, b->next_state);
+
+    if (b->frame_count == REWIND_MAX_FRAMES)
+        evict_oldest_group(b);
+
+    bool keyframe = b->frame_count == 0 || b->frames_since_keyframe + 1 >= REWIND_KEYFRAME_INTERVAL;
+    uint32_t length = encode((uint8_t*)(keyframe ? b->empty_state : b->state), (uint8_t*)b->next_state, sizeof(Snapshot), b->encoding_buffer);
+
+    uint32_t offset;
+    if (!reserve(b, length, &offset) && !keyframe)
+    {
+        // The frame this delta was built upon is gone
+        keyframe = true;
+        length = encode((uint8_t*)b->empty_state, (uint8_t*)b->next_state, sizeof(Snapshot), b->encoding_buffer);
+    }
+
+    memcpy(b->arena + offset, b->encoding_buffer, length);
+
+    RewindFrame* frame = FRAME(b, b->frame_count);
+    frame->offset = offset;
+    frame->length = length;
+    frame->keyframe = keyframe;
+
+    ++b->frame_count;
+    b->frames_since_keyframe = keyframe ? 0 : b->frames_since_keyframe + 1;
+    b->arena_head = offset + length;
+    b->used_bytes += length;
+
+    Snapshot* previous_state = b->state;
+    b->state = b->next_state;
+    b->next_state = previous_state;
+
+    double time = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    b->capture_time = b->capture_time * 0.95 + time * 0.05;
+}
+
+bool rewind_buffer_pop(RewindBuffer* b, struct Genesis* g)
+{
+    if (b->frame_count < 2)
+        return false;
+
+    RewindFrame* newest = FRAME(b, b->frame_count - 1);
+
+    if (!newest->keyframe)
+    {
+        // Undo the delta
+        decode((uint8_t*)b->state, b->arena + newest->offset, newest->length);
+    }
+    else
+    {
+        // Rebuild the previous frame from its keyframe (the oldest frame is always a keyframe)
+        uint32_t keyframe = b->frame_count - 2;
+        while (!FRAME(b, keyframe)->keyframe)
+            --keyframe;
+
+        memset(b->state, 0, sizeof(Snapshot));
+        for (uint32_t i = keyframe; i < b->frame_count - 1; ++i)
+            decode((uint8_t*)b->state, b->arena + FRAME(b, i)->offset, FRAME(b, i)->length);
+    }
+
+    b->used_bytes -= newest->length;
+    --b->frame_count;
+
+    RewindFrame* previous = FRAME(b, b->frame_count - 1);
+    b->arena_head = previous->offset + previous->length;
+
+    b->frames_since_keyframe = 0;
+    for (uint32_t i = b->frame_count - 1; !FRAME(b, i)->keyframe; --i)
+        ++b->frames_since_keyframe;
+
+    snapshot_restore(g, b->state);
+
+    return true;
+}
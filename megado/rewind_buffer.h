@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Genesis;
+struct Snapshot;
+
+// Size of the arena holding the encoded frames
+#define REWIND_ARENA_SIZE (64 * 1024 * 1024)
+
+// Maximum number of frames in the history (10 minutes at 60 FPS)
+#define REWIND_MAX_FRAMES (60 * 60 * 10)
+
+// A full state is stored every N frames, the other frames are deltas
+#define REWIND_KEYFRAME_INTERVAL 300
+
+typedef struct RewindFrame
+{
+    uint32_t offset; // In the arena
+    uint32_t length;
+    bool keyframe;
+} RewindFrame;
+
+// Rewind history
+//
+// One entry is pushed per frame. Each entry is the XOR of the emulator state
+// with the state of the previous frame, with the runs of unchanged bytes left
+// out (keyframes are encoded the same way against an all-zero state). The
+// entries are packed in a ring arena: when it is full, the oldest keyframe and
+// the deltas that depend on it are evicted together. The arena and the states
+// are only allocated on the first push, instances that never rewind do not
+// pay for them.
+//
+// Stepping back from a delta is a single XOR of the current state, stepping
+// back from a keyframe decodes the previous keyframe and its deltas.
+typedef struct RewindBuffer
+{
+    uint8_t* arena; // NULL until the first push
+    uint32_t arena_head; // Where the next frame will be written
+
+    RewindFrame* frames; // Ring, from oldest to newest
+    uint32_t first_frame;
+    uint32_t frame_count;
+    uint32_t frames_since_keyframe;
+
+    struct Snapshot* state; // State of the newest frame
+    struct Snapshot* next_state;
+    struct Snapshot* empty_state;
+    uint8_t* encoding_buffer;
+
+    // Stats
+    uint32_t used_bytes;
+    double capture_time; // Moving average of the time it takes to push a frame (s)
+} RewindBuffer;
+
+RewindBuffer* rewind_buffer_make();
+void rewind_buffer_free(RewindBuffer*);
+void rewind_buffer_clear(RewindBuffer*);
+
+// Clear the history and give its memory back (until the next push)
+void rewind_buffer_release(RewindBuffer*);
+
+// Record the current state of the emulator
+void rewind_buffer_push(RewindBuffer*, struct Genesis*);
+
+// Drop the newest frame and restore the one before.
+// Returns false if there is no older frame.
+bool rewind_buffer_pop(RewindBuffer*, struct Genesis*);
@@ -0,0 +1,116 @@
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debugger.h"
+#include "genesis.h"
+#include "run_ahead.h"
+#include "snapshot.h"
+#include "sound.h"
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static uint32_t sram_size(struct Genesis* g)
+{
+    return g->sram != NULL && g->sram_end > g->sram_start ? g->sram_end - g->sram_start : 0;
+}
+
+static void average(double* value, double sample)
+{
+    *value = *value * 0.95 + sample * 0.05;
+}
+
+RunAhead* run_ahead_make()
+{
+    RunAhead* r = calloc(1, sizeof(RunAhead));
+    r->snapshot = calloc(1, sizeof(Snapshot));
+    return r;
+}
+
+void run_ahead_free(RunAhead* r)
+{
+    if (r == NULL)
+        return;
+
+    free(r->snapshot);
+    free(r->sram);
+    free(r);
+}
+
+void run_ahead_begin_frame(RunAhead* r, struct Genesis* g)
+{
+    // The real frames are never displayed
+    r->frameskip = g->vdp->frameskip;
+    g->vdp->frameskip.mode = FrameSkipMode_OnDemand;
+    g->vdp->frameskip.requested = false;
+}
+
+void run_ahead_end_frame(RunAhead* r, struct Genesis* g, int frames)
+{
+    double start = now();
+
+    // The pipeline draws asynchronously, its frames could not be matched with the restored state
+    if (g->vdp->pipeline != NULL)
+        vdp_set_pipelined_rendering(g->vdp, false);
+
+    if (g->status == Status_Running)
+    {
+        snapshot_capture(g, r->snapshot);
+
+        uint32_t size = sram_size(g);
+        if (size != r->sram_size)
+        {
+            free(r->sram);
+            r->sram = malloc(size);
+            r->sram_size = size;
+        }
+        if (size > 0)
+            memcpy(r->sram, g->sram, size);
+
+        Breakpoint* active_breakpoint = g->debugger->active_breakpoint;
+
+        // The frames run ahead only add to the sound queue (see genesis_run_frame),
+        // what was queued by the real frames is put back after the restore
+        uint32_t sound_writes = g->sound->write_count;
+        uint32_t sound_cycles = g->sound->cycles;
+        uint32_t sound_samples = g->sound->sample_count;
+
+        double captured = now();
+        average(&r->capture_time, captured - start);
+
+        // Run the next frames and only draw the last one
+        r->running = true;
+        for (int i = 0; i < frames && g->status == Status_Running; ++i)
+        {
+            if (i == frames - 1)
+                vdp_request_frame(g->vdp);
+
+            genesis_run_frame(g);
+        }
+        r->running = false;
+
+        // Go back to the real state (breakpoints hit ahead will be hit again for real)
+        double restore_start = now();
+        snapshot_restore(g, r->snapshot);
+        if (r->sram_size > 0)
+            memcpy(g->sram, r->sram, r->sram_size);
+        g->sound->write_count = sound_writes;
+        g->sound->cycles = sound_cycles;
+        g->sound->sample_count = sound_samples;
+        g->debugger->active_breakpoint = active_breakpoint;
+        g->status = Status_Running;
+
+        average(&r->restore_time, now() - restore_start);
+    }
+
+    // Put the frame skipping policy back, keeping the stats
+    g->vdp->frameskip.mode = r->frameskip.mode;
+    g->vdp->frameskip.interval = r->frameskip.interval;
+    g->vdp->frameskip.counter = r->frameskip.counter;
+    g->vdp->frameskip.requested = r->frameskip.requested;
+
+    average(&r->frame_time, now() - start);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdp.h"
+
+struct Genesis;
+struct Snapshot;
+
+#define RUN_AHEAD_MAX_FRAMES 4
+
+// Run-ahead
+//
+// Hides the frames of latency between an input and its effect on screen.
+// After the emulation of each host frame, the state is saved, the emulation
+// goes on for a few more frames with the current inputs, the last of those
+// frames is displayed and the state is restored. Only the displayed frame is
+// drawn: the real frames and the intermediate ones are skipped.
+typedef struct RunAhead
+{
+    struct Snapshot* snapshot;
+    bool running; // Set while emulating ahead
+
+    // Battery-backed RAM is not part of in-memory snapshots
+    // (some games map it over the work RAM)
+    uint8_t* sram;
+    uint32_t sram_size;
+
+    // Frame skipping policy outside of run-ahead
+    FrameSkip frameskip;
+
+    // Moving averages (s)
+    double capture_time;
+    double restore_time;
+    double frame_time; // The whole run-ahead, per host frame
+} RunAhead;
+
+RunAhead* run_ahead_make();
+void run_ahead_free(RunAhead*);
+
+// Called around the real emulation of a host frame
+void run_ahead_begin_frame(RunAhead*, struct Genesis*);
+void run_ahead_end_frame(RunAhead*, struct Genesis*, int frames);
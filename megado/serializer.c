@@ -0,0 +1,181 @@
+#include <string.h>
+
+#include "serializer.h"
+
+Serializer serializer_make(SerializerModes mode, uint8_t* data, uint32_t size)
+{
+    return (Serializer) { mode, data, size, 0, false };
+}
+
+void serializer_bytes(Serializer* s, void* bytes, uint32_t length)
+{
+    if (s->error || length > s->size - s->position)
+    {
+        s->error = true;
+        if (s->mode == Serializer_Read)
+            memset(bytes, 0, length);
+        return;
+    }
+
+    if (s->mode == Serializer_Write)
+        memcpy(s->data + s->position, bytes, length);
+    else
+        memcpy(bytes, s->data + s->position, length);
+
+    s->position += length;
+}
+
+static void serialize_integer(Serializer* s, uint64_t* value, int length)
+{
+    uint8_t bytes[8];
+
+    if (s->mode == Serializer_Write)
+        for (int i = 0; i < length; ++i)
+            bytes[i] = *value >> (i * 8);
+
+    serializer_bytes(s, bytes, length);
+
+    if (s->mode == Serializer_Read)
+    {
+        *value = 0;
+        for (int i = 0; i < length; ++i)
+            *value |= (uint64_t)bytes[i] << (i * 8);
+    }
+}
+
+void serializer_u8(Serializer* s, uint8_t* value)
+{
+    serializer_bytes(s, value, 1);
+}
+
+void serializer_u16(Serializer* s, uint16_t* value)
+{
+    uint64_t v = *value;
+    serialize_integer(s, &v, 2);
+    *value = v;
+}
+
+void serializer_u32(Serializer* s, uint32_t* value)
+{
+    uint64_t v = *value;
+    serialize_integer(s, &v, 4);
+    *value = v;
+}
+
+void serializer_u64(Serializer* s, uint64_t* value)
+{
+    serialize_integer(s, value, 8);
+}
+
+void serializer_double(Serializer* s, double* value)
+{
+    // IEEE 754 bits
+    uint64_t v;
+    memcpy(&v, value, sizeof(v));
+    serialize_integer(s, &v, 8);
+    memcpy(value, &v, sizeof(v));
+}
+
+// PackBits: a header byte n is followed by either
+// - n + 1 literal bytes (n < 128)
+// - a byte repeated 257 - n times (n > 128)
+uint32_t rle_compress(const uint8_t* input, uint32_t length, uint8_t* output)
+{
+    uint8_t* start = output;
+
+    uint32_t i = 0;
+    while (i < length)
+    {
+        // Repeated bytes
+        uint32_t run = 1;
+        while (i + run < length && run < 128 && input[i + run] == input[i])
+            ++run;
+
+        if (run >= 3)
+        {
+            *output++ = 257 - run;
+            *output++ = input[i];
+            i += run;
+            continue;
+        }
+
+        // Literal bytes, until the next run of 3
+        uint32_t literal = 0;
+        while (i + literal < length && literal < 128)
+        {
+            if (i + literal + 2 < length &&
+                input[i + literal] == input[i + literal + 1] &&
+                input[i + literal] == input[i + literal + 2])
+                break;
+
+            ++literal;
+        }
+
+        *output++ = literal - 1;
+        memcpy(output, input + i, literal);
+        output += literal;
+        i += literal;
+    }
+
+    return (uint32_t)(output - start);
+}
+
+bool rle_decompress(const uint8_t* input, uint32_t length, uint8_t* output, uint32_t output_length)
+{
+    const uint8_t* end = input + length;
+    uint32_t position = 0;
+
+    while (input < end)
+    {
+        uint8_t header = *input++;
+
+        if (header < 128)
+        {
+            uint32_t literal = header + 1;
+            if (literal > (uint32_t)(end - input) || literal > output_length - position)
+                return false;
+
+            memcpy(output + position, input, literal);
+            input += literal;
+            position += literal;
+        }
+        else if (header > 128)
+        {
+            uint32_t run = 257 - header;
+            if (input == end || run > output_length - position)
+                return false;
+
+            memset(output + position, *input++, run);
+            position += run;
+        }
+        else
+            return false;
+    }
+
+    return position == output_length;
+}
+
+// Adler-32
+uint32_t checksum(const uint8_t* data, uint32_t length)
+{
+    uint32_t a = 1, b = 0;
+
+    while (length > 0)
+    {
+        // Largest number of bytes before b can overflow
+        uint32_t block = length < 5552 ? length : 5552;
+        length -= block;
+
+        for (uint32_t i = 0; i < block; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        data += block;
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return b << 16 | a;
+}
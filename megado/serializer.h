@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    Serializer_Write,
+    Serializer_Read
+} SerializerModes;
+
+// Reads or writes values in a byte buffer, in little-endian order.
+//
+// The same function can describe both directions of a structure's
+// serialization by calling the serializer_* functions on each field.
+// Any overflow sets the error flag instead of going past the buffer
+// (values read past the end are zeroed).
+typedef struct Serializer
+{
+    SerializerModes mode;
+    uint8_t* data;
+    uint32_t size;
+    uint32_t position;
+    bool error;
+} Serializer;
+
+Serializer serializer_make(SerializerModes mode, uint8_t* data, uint32_t size);
+
+void serializer_bytes(Serializer*, void* bytes, uint32_t length);
+void serializer_u8(Serializer*, uint8_t*);
+void serializer_u16(Serializer*, uint16_t*);
+void serializer_u32(Serializer*, uint32_t*);
+void serializer_u64(Serializer*, uint64_t*);
+void serializer_double(Serializer*, double*);
+
+// Serializes any integer-like lvalue (including bitfields, enums and booleans) with the given width
+#define SERIALIZE(s, field, bits) do { uint##bits##_t serialized = (uint##bits##_t)(field); serializer_u##bits(s, &serialized); (field) = serialized; } while (0)
+
+// Run-length compression (PackBits).
+// The output buffer must be able to hold RLE_BOUND(length) bytes.
+#define RLE_BOUND(length) ((length) + (length) / 128 + 1)
+uint32_t rle_compress(const uint8_t* input, uint32_t length, uint8_t* output);
+
+// Returns false if the data is malformed or does not decompress to exactly `output_length` bytes
+bool rle_decompress(const uint8_t* input, uint32_t length, uint8_t* output, uint32_t output_length);
+
+// Adler-32
+uint32_t checksum(const uint8_t* data, uint32_t length);
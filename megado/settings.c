@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "run_ahead.h"
 #include "settings.h"
 
 Settings* settings_make()
@@ -43,6 +44,7 @@ void settings_save(Settings* s)
 
     JSON_SET_FLOAT(video_scale);
     JSON_SET_BOOL(vsync);
+    JSON_SET_INT(run_ahead_frames);
 
     JSON_SET_FLOAT(emulation_speed);
 
@@ -174,6 +176,11 @@ Settings* settings_load()
 
     JSON_GET_FLOAT(video_scale, 1.0f);
     JSON_GET_BOOL(vsync, true);
+    JSON_GET_INT(run_ahead_frames, 0);
+    if (s->run_ahead_frames < 0)
+        s->run_ahead_frames = 0;
+    else if (s->run_ahead_frames > RUN_AHEAD_MAX_FRAMES)
+        s->run_ahead_frames = RUN_AHEAD_MAX_FRAMES;
 
     JSON_GET_FLOAT(emulation_speed, 1.0f);
 
@@ -26,6 +26,7 @@ typedef struct Settings
     float video_scale; // Scaling factor for the Genesis video output
     bool full_screen;
     bool vsync;
+    int run_ahead_frames;
 
     float emulation_speed;
 
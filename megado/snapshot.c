@@ -1,27 +1,72 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "snapshot.h"
 #include "genesis.h"
+#include "joypad.h"
+#include "parallel_renderer.h"
+#include "render_pipeline.h"
+#include "serializer.h"
+#include "sound.h"
 
 #define WRITE_SNAPSHOT_NAME(BUFFER, TITLE, SLOT) sprintf(BUFFER, "%s.snapshot%d", TITLE, SLOT)
 
+#define SNAPSHOT_MAGIC "MGDS"
+
+#define ALIGN_8(x) (((x) + 7) & ~7u)
+
+// Size limits, to reject corrupted files early
+#define MAX_CHUNK_SIZE (16 * 1024 * 1024)
+#define MAX_FIELDS_SIZE 4096
+
 Snapshot* snapshot_take(struct Genesis* g)
 {
     Snapshot* snapshot = calloc(1, sizeof(Snapshot));
+    snapshot_capture(g, snapshot);
+    return snapshot;
+}
+
+// Copy the components as they are, without bringing the sound chips up to date
+static void copy_components(struct Genesis* g, Snapshot* snapshot)
+{
     memcpy(snapshot->ram, g->ram, 0x10000 * sizeof(uint8_t));
     snapshot->m68k = *g->m68k;
     snapshot->z80 = *g->z80;
     snapshot->vdp = *g->vdp;
     snapshot->psg = *g->psg;
     snapshot->ym2612 = *g->ym2612;
-    return snapshot;
+    snapshot->joypads[0] = g->joypad1->buttons & 0xC0;
+    snapshot->joypads[1] = g->joypad2->buttons & 0xC0;
+    snapshot->remaining_cycles = g->remaining_cycles;
+}
+
+void snapshot_capture(struct Genesis* g, Snapshot* snapshot)
+{
+    // Apply the pending writes to the sound chips
+    sound_render(g->sound);
+
+    copy_components(g, snapshot);
 }
 
 void snapshot_restore(struct Genesis* g, Snapshot* s)
 {
     uint8_t* vdp_buffer = g->vdp->output_buffer;
+    uint8_t* vdp_index_buffer = g->vdp->index_buffer;
+    ScanlineBuffers* vdp_scanline_buffers = g->vdp->scanline_buffers;
+    FrameSkip vdp_frameskip = g->vdp->frameskip; // Host-side policy, not part of the emulated state
+    LineCache* vdp_line_cache = g->vdp->line_cache;
+    struct ParallelRenderer* vdp_parallel = g->vdp->parallel;
+    struct RenderPipeline* vdp_pipeline = g->vdp->pipeline;
 
     // Copy the snapshot data
     memcpy(g->ram, &s->ram, 0x10000 * sizeof(uint8_t));
@@ -30,15 +75,657 @@ void snapshot_restore(struct Genesis* g, Snapshot* s)
     memcpy(g->vdp, &s->vdp, sizeof(Vdp));
     memcpy(g->psg, &s->psg, sizeof(PSG));
     memcpy(g->ym2612, &s->ym2612, sizeof(YM2612));
+    joypad_write(g->joypad1, s->joypads[0]);
+    joypad_write(g->joypad2, s->joypads[1]);
+    g->remaining_cycles = s->remaining_cycles;
 
     // Rebind internal pointers
     g->m68k->genesis = g;
+    g->z80->genesis = g;
     g->vdp->genesis = g;
     g->vdp->output_buffer = vdp_buffer;
+    g->vdp->index_buffer = vdp_index_buffer;
+    g->vdp->scanline_buffers = vdp_scanline_buffers;
+    g->vdp->frameskip = vdp_frameskip;
+    g->vdp->line_cache = vdp_line_cache;
+    vdp_invalidate_line_cache(g->vdp); // VRAM/CRAM were replaced without going through the write tracking
+    g->vdp->parallel = vdp_parallel;
+    g->vdp->pipeline = vdp_pipeline;
+    if (vdp_parallel != NULL)
+        parallel_renderer_cancel(vdp_parallel); // The log does not lead to the restored state
+    if (vdp_pipeline != NULL)
+        render_pipeline_sync(vdp_pipeline);
     g->psg->genesis = g;
     g->ym2612->genesis = g;
+    ym2612_update_cache(g->ym2612); // Not part of the serialized state
+    sound_discard(g->sound);
+}
+
+// Components
+
+static void serialize_genesis(Serializer* s, Snapshot* snapshot)
+{
+    serializer_double(s, &snapshot->remaining_cycles);
+}
+
+static void serialize_m68k(Serializer* s, Snapshot* snapshot)
+{
+    M68k* m = &snapshot->m68k;
+
+    SERIALIZE(s, m->pc, 32);
+    SERIALIZE(s, m->status, 16);
+    for (int i = 0; i < 8; ++i)
+        SERIALIZE(s, m->data_registers[i], 32);
+    for (int i = 0; i < 8; ++i)
+        SERIALIZE(s, m->address_registers[i], 32);
+    SERIALIZE(s, m->ssp, 32);
+    SERIALIZE(s, m->usp, 32);
+
+    SERIALIZE(s, m->cycles, 64);
+    SERIALIZE(s, m->stopped, 8);
+    SERIALIZE(s, m->remaining_master_cycles, 32);
+    SERIALIZE(s, m->pending_interrupt, 32);
+
+    SERIALIZE(s, m->prefetch_queue[0], 16);
+    SERIALIZE(s, m->prefetch_queue[1], 16);
+    SERIALIZE(s, m->prefetch_address, 32);
+    SERIALIZE(s, m->instruction_register, 16);
+    SERIALIZE(s, m->instruction_address, 32);
+
+    SERIALIZE(s, m->instruction_count, 64);
+}
+
+static void serialize_z80(Serializer* s, Snapshot* snapshot)
+{
+    Z80* z = &snapshot->z80;
+
+    SERIALIZE(s, z->remaining_master_cycles, 32);
+
+    SERIALIZE(s, z->af, 16);
+    SERIALIZE(s, z->bc, 16);
+    SERIALIZE(s, z->de, 16);
+    SERIALIZE(s, z->hl, 16);
+    SERIALIZE(s, z->i, 8);
+    SERIALIZE(s, z->r, 8);
+    SERIALIZE(s, z->pc, 16);
+    SERIALIZE(s, z->sp, 16);
+    SERIALIZE(s, z->ix, 16);
+    SERIALIZE(s, z->iy, 16);
+    SERIALIZE(s, z->af_, 16);
+    SERIALIZE(s, z->bc_, 16);
+    SERIALIZE(s, z->de_, 16);
+    SERIALIZE(s, z->hl_, 16);
+
+    SERIALIZE(s, z->running, 8);
+    SERIALIZE(s, z->resetting, 8);
+}
+
+static void serialize_vdp(Serializer* s, Snapshot* snapshot)
+{
+    Vdp* v = &snapshot->vdp;
+
+    SERIALIZE(s, v->remaining_cycles, 32);
+    SERIALIZE(s, v->clock, 32);
+
+    for (int i = 0; i < 0x40; ++i)
+        SERIALIZE(s, v->vsram[i], 16);
+    for (int i = 0; i < 0x40; ++i)
+    {
+        SERIALIZE(s, v->cram[i].r, 8);
+        SERIALIZE(s, v->cram[i].g, 8);
+        SERIALIZE(s, v->cram[i].b, 8);
+    }
+
+    SERIALIZE(s, v->pending_command, 8);
+    SERIALIZE(s, v->pending_dma_fill, 8);
+    SERIALIZE(s, v->access_mode, 32);
+    SERIALIZE(s, v->access_address, 16);
+
+    SERIALIZE(s, v->hblank_interrupt_enabled, 8);
+    SERIALIZE(s, v->hv_counter_latched, 8);
+    SERIALIZE(s, v->display_enabled, 8);
+    SERIALIZE(s, v->vblank_interrupt_enabled, 8);
+    SERIALIZE(s, v->dma_enabled, 8);
+    SERIALIZE(s, v->display_height, 8);
+    SERIALIZE(s, v->plane_a_nametable, 32);
+    SERIALIZE(s, v->window_nametable, 32);
+    SERIALIZE(s, v->plane_b_nametable, 32);
+    SERIALIZE(s, v->sprites_attribute_table, 32);
+    SERIALIZE(s, v->background_color_palette, 8);
+    SERIALIZE(s, v->background_color_entry, 8);
+    SERIALIZE(s, v->hblank_line, 8);
+    SERIALIZE(s, v->vertical_scrolling_mode, 8);
+    SERIALIZE(s, v->horizontal_scrolling_mode, 8);
+    SERIALIZE(s, v->display_width, 8);
+    SERIALIZE(s, v->shadow_highlight_enabled, 8);
+    SERIALIZE(s, v->interlace_mode, 32);
+    SERIALIZE(s, v->horizontal_scrolltable, 32);
+    SERIALIZE(s, v->auto_increment, 32);
+    SERIALIZE(s, v->plane_width, 8);
+    SERIALIZE(s, v->plane_height, 8);
+    SERIALIZE(s, v->window_plane_horizontal_direction, 8);
+    SERIALIZE(s, v->window_plane_horizontal_offset, 32);
+    SERIALIZE(s, v->window_plane_vertical_direction, 8);
+    SERIALIZE(s, v->window_plane_vertical_offset, 32);
+    SERIALIZE(s, v->dma_length, 16);
+    SERIALIZE(s, v->dma_source_address_lo, 16);
+    SERIALIZE(s, v->dma_source_address_hi, 8);
+    SERIALIZE(s, v->dma_type, 32);
+    serializer_bytes(s, v->register_raw_values, sizeof(v->register_raw_values));
+
+    SERIALIZE(s, v->dma_in_progress, 8);
+    SERIALIZE(s, v->hblank_in_progress, 8);
+    SERIALIZE(s, v->vblank_in_progress, 8);
+    SERIALIZE(s, v->vblank_pending, 8);
+    SERIALIZE(s, v->h_counter, 16);
+    SERIALIZE(s, v->v_counter, 16);
+    SERIALIZE(s, v->hblank_counter, 8);
+}
+
+static void serialize_psg(Serializer* s, Snapshot* snapshot)
+{
+    PSG* p = &snapshot->psg;
+
+    SERIALIZE(s, p->remaining_master_cycles, 32);
+    serializer_double(s, &p->sample_counter);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        SquareChannel* square = &p->square[i];
+        SERIALIZE(s, square->volume, 8);
+        SERIALIZE(s, square->tone, 16);
+        SERIALIZE(s, square->counter, 16);
+        SERIALIZE(s, square->output, 8);
+    }
+
+    SERIALIZE(s, p->noise.volume, 8);
+    SERIALIZE(s, p->noise.noise, 8);
+    SERIALIZE(s, p->noise.counter, 16);
+    SERIALIZE(s, p->noise.lfsr, 16);
+    SERIALIZE(s, p->noise.output, 8);
+
+    SERIALIZE(s, p->latched_channel, 8);
+    SERIALIZE(s, p->latched_register, 8);
+}
+
+static void serialize_frequency(Serializer* s, Frequency* f)
+{
+    SERIALIZE(s, f->block, 8);
+    SERIALIZE(s, f->freq, 16);
+}
+
+static void serialize_ym2612(Serializer* s, Snapshot* snapshot)
+{
+    YM2612* y = &snapshot->ym2612;
+
+    SERIALIZE(s, y->remaining_master_cycles, 32);
+    SERIALIZE(s, y->envelope_remaining_master_cycles, 32);
+    SERIALIZE(s, y->envelope_counter, 16);
+    SERIALIZE(s, y->latched_address_part1, 8);
+    SERIALIZE(s, y->latched_address_part2, 8);
+    SERIALIZE(s, y->lfo_enabled, 8);
+    SERIALIZE(s, y->lfo_frequency_index, 8);
+    SERIALIZE(s, y->timer_a, 16);
+    SERIALIZE(s, y->timer_b, 8);
+    SERIALIZE(s, y->channel3_mode, 8);
+    SERIALIZE(s, y->channel6_mode, 8);
+    SERIALIZE(s, y->dac_data, 8);
+    SERIALIZE(s, y->dac_enabled, 8);
+
+    for (int c = 0; c < 6; ++c)
+    {
+        Channel* channel = &y->channels[c];
+
+        for (int o = 0; o < 4; ++o)
+        {
+            Operator* op = &channel->operators[o];
+            uint8_t index = c * 4 + o;
+            SERIALIZE(s, op->detune, 8);
+            SERIALIZE(s, op->multiple, 8);
+            SERIALIZE(s, op->total_level, 8);
+            SERIALIZE(s, op->attack_rate, 8);
+            SERIALIZE(s, op->decay_rate, 8);
+            SERIALIZE(s, op->sustain_level, 8);
+            SERIALIZE(s, op->sustain_rate, 8);
+            SERIALIZE(s, op->release_rate, 8);
+            SERIALIZE(s, op->rate_scaling, 8);
+            SERIALIZE(s, op->amplitude_modulation_enabled, 8);
+            SERIALIZE(s, y->operator_state.phase_counter[index], 32);
+            SERIALIZE(s, y->operator_state.adsr_phase[index], 8);
+            SERIALIZE(s, y->operator_state.attenuation[index], 16);
+            SERIALIZE(s, y->operator_state.polarity[index], 8);
+        }
+
+        serialize_frequency(s, &channel->frequency);
+        SERIALIZE(s, channel->feedback, 8);
+        SERIALIZE(s, channel->algorithm, 8);
+        SERIALIZE(s, channel->left_output, 8);
+        SERIALIZE(s, channel->right_output, 8);
+        SERIALIZE(s, channel->amplitude_modulation_sensitivity, 8);
+        SERIALIZE(s, channel->frequency_modulation_sensitivity, 8);
+        SERIALIZE(s, channel->enabled, 8);
+        SERIALIZE(s, channel->muted, 8);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        serialize_frequency(s, &y->channel3_additional_frequencies[i]);
+        serialize_frequency(s, &y->channel6_additional_frequencies[i]);
+    }
 }
 
+// Chunks
+
+typedef struct SnapshotChunk
+{
+    char id[5];
+    uint16_t version;
+
+    // Either the component's fields are serialized one by one...
+    void (*serialize)(Serializer*, Snapshot*);
+
+    // ... or a memory is stored as is
+    size_t memory_offset;
+    uint32_t memory_size;
+
+    // Chunks added since the first version of the format are optional, to
+    // keep reading the older files
+    bool optional;
+} SnapshotChunk;
+
+static const SnapshotChunk chunks[] = {
+    { "RAM ", 1, NULL, offsetof(Snapshot, ram), 0x10000, false },
+    { "M68K", 1, serialize_m68k, 0, 0, false },
+    { "Z80 ", 1, serialize_z80, 0, 0, false },
+    { "ZRAM", 1, NULL, offsetof(Snapshot, z80.ram), Z80_RAM_LENGTH, false },
+    { "VDP ", 1, serialize_vdp, 0, 0, false },
+    { "VRAM", 1, NULL, offsetof(Snapshot, vdp.vram), 0x10000, false },
+    { "PSG ", 1, serialize_psg, 0, 0, false },
+    { "YM2 ", 1, serialize_ym2612, 0, 0, false },
+    { "JOYP", 1, NULL, offsetof(Snapshot, joypads), 2, true }, // Without it, no control bits are set
+    { "GEN ", 1, serialize_genesis, 0, 0, true } // Without it, the lines start from the first cycle
+};
+
+#define CHUNK_COUNT (sizeof(chunks) / sizeof(chunks[0]))
+
+static uint32_t sram_size(Genesis* g)
+{
+    return g->sram != NULL && g->sram_end > g->sram_start ? g->sram_end - g->sram_start : 0;
+}
+
+// Writing
+
+// The file is written either to a stream or to memory, in a buffer grown as needed
+typedef struct SnapshotSink
+{
+    FILE* file;
+    Serializer memory;
+} SnapshotSink;
+
+static bool sink_write(SnapshotSink* sink, const void* data, uint32_t length)
+{
+    if (sink->file != NULL)
+        return fwrite(data, 1, length, sink->file) == length;
+
+    Serializer* s = &sink->memory;
+    if (length > s->size - s->position)
+    {
+        s->size = (s->position + length) * 2;
+        s->data = realloc(s->data, s->size);
+    }
+
+    serializer_bytes(s, (void*)data, length);
+    return !s->error;
+}
+
+static bool write_chunk(SnapshotSink* sink, const char* id, uint16_t version, uint8_t* data, uint32_t size, bool compress, uint8_t* compression_buffer)
+{
+    uint16_t flags = 0;
+    uint32_t stored_size = size;
+
+    if (compress && size > 0)
+    {
+        uint32_t compressed_size = rle_compress(data, size, compression_buffer);
+        if (compressed_size < size)
+        {
+            data = compression_buffer;
+            stored_size = compressed_size;
+            flags |= SnapshotChunk_Compressed;
+        }
+    }
+
+    uint8_t header[SNAPSHOT_CHUNK_HEADER_SIZE] = { 0 };
+    uint32_t sum = checksum(data, stored_size);
+
+    Serializer s = serializer_make(Serializer_Write, header, sizeof(header));
+    serializer_bytes(&s, (void*)id, 4);
+    serializer_u16(&s, &version);
+    serializer_u16(&s, &flags);
+    serializer_u32(&s, &size);
+    serializer_u32(&s, &stored_size);
+    serializer_u32(&s, &sum);
+
+    static const uint8_t padding[8] = { 0 };
+    uint32_t padding_size = ALIGN_8(stored_size) - stored_size;
+
+    return sink_write(sink, header, sizeof(header)) &&
+        (stored_size == 0 || sink_write(sink, data, stored_size)) &&
+        sink_write(sink, padding, padding_size);
+}
+
+static bool write_snapshot(Genesis* g, SnapshotSink* sink, SnapshotMetadata* metadata, bool compress)
+{
+    uint8_t header[SNAPSHOT_HEADER_SIZE] = { 0 };
+    uint16_t version = SNAPSHOT_VERSION;
+    uint16_t flags = 0;
+    uint64_t date = (uint64_t)metadata->date;
+
+    Serializer s = serializer_make(Serializer_Write, header, sizeof(header));
+    serializer_bytes(&s, SNAPSHOT_MAGIC, 4);
+    serializer_u16(&s, &version);
+    serializer_u16(&s, &flags);
+    serializer_bytes(&s, metadata->game, sizeof(metadata->game));
+    serializer_u64(&s, &date);
+
+    bool ok = sink_write(sink, header, sizeof(header));
+
+    Snapshot* snapshot = snapshot_take(g);
+    uint8_t* fields = malloc(MAX_FIELDS_SIZE);
+    uint32_t largest_chunk = sram_size(g) > sizeof(Snapshot) ? sram_size(g) : sizeof(Snapshot);
+    uint8_t* compression_buffer = malloc(RLE_BOUND(largest_chunk));
+
+    for (uint32_t i = 0; ok && i < CHUNK_COUNT; ++i)
+    {
+        const SnapshotChunk* chunk = &chunks[i];
+
+        if (chunk->serialize != NULL)
+        {
+            Serializer fields_serializer = serializer_make(Serializer_Write, fields, MAX_FIELDS_SIZE);
+            chunk->serialize(&fields_serializer, snapshot);
+            ok = !fields_serializer.error && write_chunk(sink, chunk->id, chunk->version, fields, fields_serializer.position, compress, compression_buffer);
+        }
+        else
+            ok = write_chunk(sink, chunk->id, chunk->version, (uint8_t*)snapshot + chunk->memory_offset, chunk->memory_size, compress, compression_buffer);
+    }
+
+    if (ok && sram_size(g) > 0)
+        ok = write_chunk(sink, "SRAM", 1, g->sram, sram_size(g), compress, compression_buffer);
+
+    if (ok)
+        ok = write_chunk(sink, "END ", 1, NULL, 0, false, NULL);
+
+    free(compression_buffer);
+    free(fields);
+    free(snapshot);
+
+    return ok;
+}
+
+bool snapshot_write(struct Genesis* g, FILE* file, SnapshotMetadata* metadata, bool compress)
+{
+    SnapshotSink sink = { file };
+    return write_snapshot(g, &sink, metadata, compress);
+}
+
+uint8_t* snapshot_write_memory(struct Genesis* g, SnapshotMetadata* metadata, bool compress, size_t* size)
+{
+    SnapshotSink sink = { NULL, serializer_make(Serializer_Write, NULL, 0) };
+
+    if (!write_snapshot(g, &sink, metadata, compress))
+    {
+        free(sink.memory.data);
+        return NULL;
+    }
+
+    *size = sink.memory.position;
+    return sink.memory.data;
+}
+
+// Reading
+
+// Chunks are read sequentially from either a file in memory (without copies)
+// or a stream (through a buffer)
+typedef struct SnapshotSource
+{
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+
+    FILE* file;
+    uint8_t* buffer;
+    size_t buffer_size;
+} SnapshotSource;
+
+static const uint8_t* source_read(SnapshotSource* source, size_t length)
+{
+    if (source->file == NULL)
+    {
+        if (length > source->size - source->position)
+            return NULL;
+
+        const uint8_t* data = source->data + source->position;
+        source->position += length;
+        return data;
+    }
+
+    if (length > source->buffer_size)
+    {
+        source->buffer_size = length;
+        source->buffer = realloc(source->buffer, length);
+    }
+
+    return fread(source->buffer, 1, length, source->file) == length ? source->buffer : NULL;
+}
+
+static bool read_header(const uint8_t* data, SnapshotMetadata* metadata)
+{
+    char magic[4];
+    uint16_t flags;
+    uint64_t date;
+
+    Serializer s = serializer_make(Serializer_Read, (uint8_t*)data, SNAPSHOT_HEADER_SIZE);
+    serializer_bytes(&s, magic, 4);
+    serializer_u16(&s, &metadata->version);
+    serializer_u16(&s, &flags);
+    serializer_bytes(&s, metadata->game, sizeof(metadata->game));
+    serializer_u64(&s, &date);
+
+    metadata->game[sizeof(metadata->game) - 1] = '\0';
+    metadata->date = (time_t)date;
+
+    return memcmp(magic, SNAPSHOT_MAGIC, 4) == 0;
+}
+
+static bool read_snapshot(Genesis* g, SnapshotSource* source)
+{
+    const uint8_t* header = source_read(source, SNAPSHOT_HEADER_SIZE);
+
+    SnapshotMetadata metadata;
+    if (header == NULL || !read_header(header, &metadata))
+    {
+        printf("Not a snapshot file\n");
+        return false;
+    }
+
+    if (metadata.version != SNAPSHOT_VERSION)
+    {
+        printf("Incompatible snapshot version (loaded version is %d, current version is %d)\n", metadata.version, SNAPSHOT_VERSION);
+        return false;
+    }
+
+    // Decode everything in a staging snapshot first so that a broken file leaves the emulator untouched.
+    // The fields that are not serialized come from the live components, which are not rendered:
+    // the pending sound writes are dropped by the restore anyway.
+    Snapshot* snapshot = calloc(1, sizeof(Snapshot));
+    copy_components(g, snapshot);
+    uint8_t* sram = NULL;
+    uint8_t fields[MAX_FIELDS_SIZE];
+    uint32_t found_chunks = 0;
+    bool ok = true;
+
+    // Defaults of the optional chunks
+    snapshot->joypads[0] = 0;
+    snapshot->joypads[1] = 0;
+    snapshot->remaining_cycles = 0;
+
+    while (ok)
+    {
+        const uint8_t* chunk_header = source_read(source, SNAPSHOT_CHUNK_HEADER_SIZE);
+        if (chunk_header == NULL)
+        {
+            printf("Truncated snapshot\n");
+            ok = false;
+            break;
+        }
+
+        char id[4];
+        uint16_t version, flags;
+        uint32_t size, stored_size, sum;
+
+        Serializer s = serializer_make(Serializer_Read, (uint8_t*)chunk_header, SNAPSHOT_CHUNK_HEADER_SIZE);
+        serializer_bytes(&s, id, 4);
+        serializer_u16(&s, &version);
+        serializer_u16(&s, &flags);
+        serializer_u32(&s, &size);
+        serializer_u32(&s, &stored_size);
+        serializer_u32(&s, &sum);
+
+        if (memcmp(id, "END ", 4) == 0)
+            break;
+
+        const uint8_t* data = size <= MAX_CHUNK_SIZE && stored_size <= MAX_CHUNK_SIZE ? source_read(source, ALIGN_8(stored_size)) : NULL;
+        if (data == NULL || checksum(data, stored_size) != sum)
+        {
+            printf("Corrupted snapshot chunk %.4s\n", id);
+            ok = false;
+            break;
+        }
+
+        // Find where the chunk goes
+        const SnapshotChunk* chunk = NULL;
+        uint8_t* destination = NULL;
+        for (uint32_t i = 0; i < CHUNK_COUNT; ++i)
+            if (memcmp(id, chunks[i].id, 4) == 0)
+            {
+                chunk = &chunks[i];
+                found_chunks |= 1 << i;
+
+                if (chunk->serialize != NULL)
+                    destination = size <= MAX_FIELDS_SIZE ? fields : NULL;
+                else
+                    destination = size == chunk->memory_size ? (uint8_t*)snapshot + chunk->memory_offset : NULL;
+            }
+
+        if (chunk == NULL && memcmp(id, "SRAM", 4) == 0)
+        {
+            if (size == sram_size(g))
+                destination = sram = realloc(sram, size);
+        }
+        else if (chunk == NULL)
+            continue; // Unknown chunk, skip it
+
+        if (destination == NULL || (chunk != NULL && version != chunk->version))
+        {
+            printf("Unsupported snapshot chunk %.4s (version %d, %d bytes)\n", id, version, size);
+            ok = false;
+            break;
+        }
+
+        // Copy the data
+        if (flags & SnapshotChunk_Compressed)
+            ok = rle_decompress(data, stored_size, destination, size);
+        else if (stored_size == size)
+            memcpy(destination, data, size);
+        else
+            ok = false;
+
+        // Decode the fields
+        if (ok && chunk != NULL && chunk->serialize != NULL)
+        {
+            Serializer fields_serializer = serializer_make(Serializer_Read, fields, size);
+            chunk->serialize(&fields_serializer, snapshot);
+            ok = !fields_serializer.error && fields_serializer.position == size;
+        }
+
+        if (!ok)
+            printf("Invalid snapshot chunk %.4s\n", id);
+    }
+
+    uint32_t required_chunks = 0;
+    for (uint32_t i = 0; i < CHUNK_COUNT; ++i)
+        if (!chunks[i].optional)
+            required_chunks |= 1 << i;
+
+    if (ok && (found_chunks & required_chunks) != required_chunks)
+    {
+        printf("Incomplete snapshot\n");
+        ok = false;
+    }
+
+    if (ok)
+    {
+        snapshot_restore(g, snapshot);
+
+        if (sram != NULL)
+            memcpy(g->sram, sram, sram_size(g));
+    }
+
+    free(sram);
+    free(snapshot);
+
+    return ok;
+}
+
+bool snapshot_read(struct Genesis* g, const uint8_t* data, size_t size)
+{
+    SnapshotSource source = { data, size, 0, NULL, NULL, 0 };
+    return read_snapshot(g, &source);
+}
+
+bool snapshot_read_stream(struct Genesis* g, FILE* file)
+{
+    SnapshotSource source = { NULL, 0, 0, file, NULL, 0 };
+    bool ok = read_snapshot(g, &source);
+    free(source.buffer);
+    return ok;
+}
+
+bool snapshot_read_file(struct Genesis* g, const char* path)
+{
+#ifdef _WIN32
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    bool ok = snapshot_read_stream(g, file);
+    fclose(file);
+    return ok;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat stats;
+    if (fstat(fd, &stats) != 0 || stats.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    bool ok = snapshot_read(g, data, stats.st_size);
+    munmap(data, stats.st_size);
+    return ok;
+#endif
+}
+
+// Slots
+
 SnapshotMetadata* snapshot_save(struct Genesis* g, uint8_t slot)
 {
     SnapshotMetadata* metadata = calloc(1, sizeof(SnapshotMetadata));
@@ -46,8 +733,6 @@ SnapshotMetadata* snapshot_save(struct Genesis* g, uint8_t slot)
     metadata->date = time(NULL);
     metadata->version = SNAPSHOT_VERSION;
 
-    Snapshot* snapshot = snapshot_take(g);
-
     char file_name[70];
     WRITE_SNAPSHOT_NAME(file_name, metadata->game, slot);
 
@@ -56,13 +741,20 @@ SnapshotMetadata* snapshot_save(struct Genesis* g, uint8_t slot)
     if (!file)
     {
         printf("Cannot open file \"%s\"", file_name);
+        free(metadata);
         return NULL;
     }
 
-    fwrite(metadata, sizeof(SnapshotMetadata), 1, file);
-    fwrite(snapshot, sizeof(Snapshot), 1, file);
+    bool ok = snapshot_write(g, file, metadata, true);
     fclose(file);
 
+    if (!ok)
+    {
+        printf("Cannot write snapshot \"%s\"\n", file_name);
+        free(metadata);
+        return NULL;
+    }
+
     return metadata;
 }
 
@@ -76,19 +768,8 @@ void snapshot_load(struct Genesis* g, uint8_t slot)
 
     printf("Loading snapshot %s...\n", file_name);
 
-    FILE* file = fopen(file_name, "rb");
-    if (!file)
-    {
-        printf("Cannot open file \"%s\"", file_name);
-        return;
-    }
-
-    Snapshot s;
-    fseek(file, sizeof(SnapshotMetadata), SEEK_SET); // Skip the header
-    fread(&s, sizeof(Snapshot), 1, file);
-    fclose(file);
-
-    snapshot_restore(g, &s);
+    if (!snapshot_read_file(g, file_name))
+        printf("Cannot load snapshot \"%s\"\n", file_name);
 }
 
 void snapshots_preload(struct Genesis* g, SnapshotMetadata* snapshots[])
@@ -108,15 +789,16 @@ void snapshots_preload(struct Genesis* g, SnapshotMetadata* snapshots[])
             continue;
         }
 
-        SnapshotMetadata* metadata = calloc(1, sizeof(SnapshotMetadata));
-        fread(metadata, sizeof(SnapshotMetadata), 1, file);
+        uint8_t header[SNAPSHOT_HEADER_SIZE];
+        size_t header_size = fread(header, 1, SNAPSHOT_HEADER_SIZE, file);
         fclose(file);
 
         printf("Snapshot found: %s\n", file_name);
 
-        if (metadata->version != SNAPSHOT_VERSION)
+        SnapshotMetadata* metadata = calloc(1, sizeof(SnapshotMetadata));
+        if (header_size != SNAPSHOT_HEADER_SIZE || !read_header(header, metadata) || metadata->version != SNAPSHOT_VERSION)
         {
-            printf("Incompatible snapshot version (loaded version is %d, current version is %d)", metadata->version, SNAPSHOT_VERSION);
+            printf("Incompatible snapshot (loaded version is %d, current version is %d)\n", metadata->version, SNAPSHOT_VERSION);
             snapshots[slot] = NULL;
             snapshot_metadata_free(metadata);
             continue;
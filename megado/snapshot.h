@@ -1,6 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 #include "m68k/m68k.h"
@@ -14,17 +17,48 @@ struct Genesis;
 #define SNAPSHOT_SLOTS 3
 #define SNAPSHOT_NAME(NAME, SLOT) NAME #SLOT ".snapshot"
 
-// Bump that version number when changing the format or the structure of the
-// underlying data in order to discard out of date snapshots.
-#define SNAPSHOT_VERSION 0
+// Bump that version number when changing the file format in a way older
+// versions of the emulator cannot read.
+#define SNAPSHOT_VERSION 1
 
-// State of the emulator at a given time.
-// Can be saved to/loaded from file.
+// Snapshot file format
 //
-// Note: This is most likely not portable!
-//       Snapshots saved on a machine might not load on another architecture due to endianness or padding.
+// All integers are little-endian.
+//
+// Header (64 bytes)
+//     char     magic[4] ("MGDS")
+//     uint16_t version
+//     uint16_t flags (unused)
+//     char     game[48]
+//     uint64_t date
+//
+// Followed by chunks, each one starting on an 8-byte boundary
+//     char     id[4]
+//     uint16_t version (of the chunk's content)
+//     uint16_t flags (SnapshotChunkFlags)
+//     uint32_t size (uncompressed)
+//     uint32_t stored_size
+//     uint32_t checksum (of the stored bytes)
+//     uint32_t padding
+//     uint8_t  data[stored_size] (padded to 8 bytes)
+//
+// The last chunk is "END ". Each component's registers are serialized field by
+// field (see snapshot.c) and the memories (RAM, VRAM, etc) are stored in their
+// own chunks, so that with an uncompressed, memory-mapped file they are loaded
+// with a single copy. Unknown chunks are skipped.
+#define SNAPSHOT_HEADER_SIZE 64
+#define SNAPSHOT_CHUNK_HEADER_SIZE 24
+
+typedef enum
+{
+    SnapshotChunk_Compressed = 1 // RLE (see serializer.h)
+} SnapshotChunkFlags;
+
+// State of the emulator at a given time, as a plain copy of the components.
+// Only meant to be kept in memory (e.g. for rewinding): the layout depends on
+// the architecture and the compiler, use snapshot_write/snapshot_read to go
+// through files.
 //
-// TODO use a portable serialization lib
 // TODO use a really unique identifier for the snapshot's name (right now, could clash between rom versions)
 
 typedef struct Snapshot
@@ -35,6 +69,8 @@ typedef struct Snapshot
     Vdp vdp;
     PSG psg;
     YM2612 ym2612;
+    uint8_t joypads[2]; // Bits 6 and 7, written by the game
+    double remaining_cycles; // Of the Genesis, decides where the next lines split (see genesis_run_cycles)
 
 } Snapshot;
 
@@ -42,13 +78,29 @@ typedef struct SnapshotMetadata
 {
     char game[48]; // Game name, extracted from the header
     time_t date;
-    uint8_t version;
+    uint16_t version;
 } SnapshotMetadata;
 
 // Takes/Restores a snapshot for the game currently being executed
 Snapshot* snapshot_take(struct Genesis*);
+void snapshot_capture(struct Genesis*, Snapshot*); // Same as snapshot_take, in an existing snapshot
 void snapshot_restore(struct Genesis*, Snapshot*);
 
+// Writes the state of the emulator to a stream, the chunks are compressed if requested
+bool snapshot_write(struct Genesis*, FILE*, SnapshotMetadata*, bool compress);
+
+// Same as snapshot_write, to a file in memory (to free) whose size is set in `size`.
+// Returns NULL on failure
+uint8_t* snapshot_write_memory(struct Genesis*, SnapshotMetadata*, bool compress, size_t* size);
+
+// Restores the state of the emulator from a file in memory or from a stream.
+// The whole snapshot is validated before anything is restored.
+bool snapshot_read(struct Genesis*, const uint8_t* data, size_t size);
+bool snapshot_read_stream(struct Genesis*, FILE*);
+
+// Restores the state of the emulator from a file, mapped in memory
+bool snapshot_read_file(struct Genesis*, const char* path);
+
 // Saves/Loads a snapshot in the given slot for the game currently being executed
 SnapshotMetadata* snapshot_save(struct Genesis*, uint8_t slot);
 void snapshot_load(struct Genesis*, uint8_t slot);
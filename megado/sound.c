@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "blep.h"
+#include "psg.h"
+#include "resampler.h"
+#include "sound.h"
+#include "ym2612.h"
+
+Sound* sound_make(PSG* psg, YM2612* ym2612, double cycles_per_sample)
+{
+    Sound* s = calloc(1, sizeof(Sound));
+    s->psg = psg;
+    s->ym2612 = ym2612;
+    s->cycles_per_sample = cycles_per_sample;
+    s->write_capacity = 256;
+    s->writes = calloc(s->write_capacity, sizeof(SoundWrite));
+    s->samples = calloc(SOUND_BUFFER_LENGTH * 2, sizeof(int16_t));
+
+    s->streams[SoundChip_PSG].period = PSG_MASTER_CYCLES_PER_SAMPLE;
+    s->streams[SoundChip_YM2612].period = YM2612_MASTER_CYCLES_PER_SAMPLE;
+    s->streams[SoundChip_PSG].blep = blep_make(SOUND_BLOCK_LENGTH);
+    s->streams[SoundChip_YM2612].resampler = resampler_make();
+
+    return s;
+}
+
+void sound_free(Sound* s)
+{
+    if (s == NULL)
+        return;
+
+    blep_free(s->streams[SoundChip_PSG].blep);
+    resampler_free(s->streams[SoundChip_YM2612].resampler);
+
+    free(s->writes);
+    free(s->native);
+    free(s->samples);
+    free(s);
+}
+
+void sound_clear(Sound* s)
+{
+    s->write_count = 0;
+    s->cycles = 0;
+    s->position = 0;
+    s->sample_count = 0;
+
+    s->streams[SoundChip_PSG].next = 0;
+    s->streams[SoundChip_YM2612].next = 0;
+    blep_clear(s->streams[SoundChip_PSG].blep);
+    resampler_clear(s->streams[SoundChip_YM2612].resampler);
+}
+
+void sound_discard(Sound* s)
+{
+    // The chip samples stay on the same clock: the restored state is emulated from the last rendered sample
+    s->write_count = 0;
+    s->cycles = 0;
+    s->sample_count = 0;
+}
+
+void sound_write(Sound* s, uint32_t delay, SoundChips chip, uint8_t address, uint8_t value)
+{
+    if (s->write_count == s->write_capacity)
+    {
+        s->write_capacity *= 2;
+        s->writes = realloc(s->writes, s->write_capacity * sizeof(SoundWrite));
+    }
+
+    // The M68k runs its slice before the Z80 runs the same one: keep the writes
+    // in the order they happen, after those of the same cycle
+    int32_t cycle = s->cycles + delay;
+    uint32_t i = s->write_count++;
+    for (; i > 0 && s->writes[i - 1].cycle > cycle; --i)
+        s->writes[i] = s->writes[i - 1];
+
+    s->writes[i] = (SoundWrite) { cycle, chip, address, value };
+}
+
+void sound_advance(Sound* s, uint32_t cycles)
+{
+    s->cycles += cycles;
+}
+
+static void apply_write(Sound* s, SoundWrite* w)
+{
+    if (w->chip == SoundChip_PSG)
+        psg_write(s->psg, w->value);
+    else
+        ym2612_write(s->ym2612, 0x4000 | w->address, w->value);
+
+    w->chip = SOUND_WRITE_APPLIED;
+}
+
+// Render the chip samples `from` to `to` of the block
+static void render_chip(Sound* s, SoundChips chip, uint32_t from, uint32_t to)
+{
+    SoundStream* stream = &s->streams[chip];
+
+    if (chip == SoundChip_PSG)
+    {
+        // Position of the clocks in the host samples, each sample is the output at its end
+        double time = (stream->next + (double)from * stream->period - s->position) / s->cycles_per_sample - 1;
+        psg_render(s->psg, stream->blep, to - from, time, stream->period / s->cycles_per_sample);
+    }
+    else
+    {
+        ym2612_render(s->ym2612, s->native + from, to - from);
+    }
+}
+
+// Render the chip samples up to the `end` cycle, and convert them to the next `count` samples
+static void render_stream(Sound* s, SoundChips chip, uint32_t count, double end)
+{
+    SoundStream* stream = &s->streams[chip];
+    uint32_t period = stream->period;
+
+    uint32_t native_count = end >= stream->next ? (uint32_t)((end - stream->next) / period) + 1 : 0;
+    if (chip == SoundChip_YM2612 && native_count > s->native_capacity)
+    {
+        s->native_capacity = native_count;
+        s->native = realloc(s->native, s->native_capacity * sizeof(int16_t));
+    }
+
+    // Stop at the writes to this chip
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < s->write_count; ++i)
+    {
+        SoundWrite* w = &s->writes[i];
+        if (w->chip != chip)
+            continue;
+
+        uint32_t index = w->cycle <= stream->next ? 0 : (w->cycle - stream->next + period - 1) / period;
+        if (index >= native_count)
+            break;
+
+        render_chip(s, chip, done, index);
+        done = index;
+        apply_write(s, w);
+    }
+    render_chip(s, chip, done, native_count);
+
+    if (chip == SoundChip_PSG)
+    {
+        blep_read(stream->blep, stream->block, count);
+    }
+    else
+    {
+        // Each sample is the output at its end
+        double time = (s->position + s->cycles_per_sample - stream->next) / period;
+        resampler_run(stream->resampler, s->native, native_count, stream->block, count,
+            time, s->cycles_per_sample / period);
+    }
+
+    stream->next += native_count * period;
+}
+
+static void push_samples(Sound* s, uint32_t count)
+{
+    // Drop the oldest samples if nobody reads them
+    if (s->sample_count + count > SOUND_BUFFER_LENGTH)
+    {
+        uint32_t dropped = s->sample_count + count - SOUND_BUFFER_LENGTH;
+        memmove(s->samples, s->samples + dropped * 2, (s->sample_count - dropped) * 2 * sizeof(int16_t));
+        s->sample_count -= dropped;
+    }
+
+    int16_t* out = s->samples + s->sample_count * 2;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        out[i * 2] = s->streams[SoundChip_PSG].block[i];
+        out[i * 2 + 1] = s->streams[SoundChip_YM2612].block[i];
+    }
+
+    s->sample_count += count;
+}
+
+void sound_render(Sound* s)
+{
+    while (s->cycles >= s->position + s->cycles_per_sample)
+    {
+        double available = (s->cycles - s->position) / s->cycles_per_sample;
+        uint32_t count = available < SOUND_BLOCK_LENGTH ? (uint32_t)available : SOUND_BLOCK_LENGTH;
+        double end = s->position + count * s->cycles_per_sample;
+
+        render_stream(s, SoundChip_PSG, count, end);
+        render_stream(s, SoundChip_YM2612, count, end);
+        push_samples(s, count);
+
+        // Count the cycles from the end of the block, the fraction is carried over
+        uint32_t cycles = (uint32_t)end;
+        s->cycles -= cycles;
+        s->position = end - cycles;
+        for (int i = 0; i < 2; ++i)
+            s->streams[i].next -= cycles;
+
+        // Keep the writes for the chip samples not rendered yet
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < s->write_count; ++i)
+        {
+            if (s->writes[i].chip != SOUND_WRITE_APPLIED)
+            {
+                s->writes[kept] = s->writes[i];
+                s->writes[kept++].cycle -= cycles;
+            }
+        }
+        s->write_count = kept;
+    }
+}
+
+uint32_t sound_read(Sound* s, int16_t* samples, uint32_t count)
+{
+    if (count > s->sample_count)
+        count = s->sample_count;
+
+    memcpy(samples, s->samples, count * 2 * sizeof(int16_t));
+
+    s->sample_count -= count;
+    memmove(s->samples, s->samples + count * 2, s->sample_count * 2 * sizeof(int16_t));
+
+    return count;
+}
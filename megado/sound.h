@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Blep;
+struct PSG;
+struct Resampler;
+struct YM2612;
+
+// Maximum number of samples rendered at once
+#define SOUND_BLOCK_LENGTH 1024
+
+// Rendered samples kept until they are read, the oldest ones are dropped past that
+#define SOUND_BUFFER_LENGTH 16384
+
+typedef enum
+{
+    SoundChip_PSG,
+    SoundChip_YM2612
+} SoundChips;
+
+typedef struct SoundWrite
+{
+    int32_t cycle; // Master cycles since the last rendered sample
+    uint8_t chip; // SoundChips, or SOUND_WRITE_APPLIED
+    uint8_t address; // YM2612 port (0-3)
+    uint8_t value;
+} SoundWrite;
+
+#define SOUND_WRITE_APPLIED 0xff
+
+// Output of one chip, converted to the host rate
+typedef struct SoundStream
+{
+    uint32_t period; // Master cycles per chip sample (or clock)
+    int32_t next; // Master cycle of the next chip sample, from the same origin as the writes
+
+    struct Blep* blep; // PSG: its output changes are synthesized at the host rate
+    struct Resampler* resampler; // YM2612: its samples are resampled
+
+    int16_t block[SOUND_BLOCK_LENGTH]; // Resampled
+} SoundStream;
+
+// Sound output of the PSG and the YM2612
+//
+// The emulation does not run the sound chips: it only queues the writes to
+// their registers, with the master cycle they happen at, and counts the
+// cycles. When the samples are needed, each chip renders blocks at its own
+// rate, with the writes applied at the start of the first chip sample
+// following them, and the blocks are converted to the host rate.
+typedef struct Sound
+{
+    struct PSG* psg;
+    struct YM2612* ym2612;
+
+    double cycles_per_sample;
+
+    // Emulated since the last rendered sample
+    SoundWrite* writes;
+    uint32_t write_count;
+    uint32_t write_capacity;
+    uint32_t cycles;
+    double position; // End of the last rendered sample, in cycles (less than 1)
+
+    SoundStream streams[2]; // Indexed by SoundChips
+
+    // YM2612 samples of the block being rendered
+    int16_t* native;
+    uint32_t native_capacity;
+
+    // Rendered, interleaved (PSG on the left, YM2612 on the right)
+    int16_t* samples;
+    uint32_t sample_count; // Stereo samples
+} Sound;
+
+Sound* sound_make(struct PSG*, struct YM2612*, double cycles_per_sample);
+void sound_free(Sound*);
+
+// Drop the pending writes and samples, and start the output over (e.g. when the chips are reset)
+void sound_clear(Sound*);
+
+// Drop the pending writes and the samples not read yet, when the chips were
+// restored to another state. The streams go on from the samples already
+// output (BLEP steps and resampler history), without the click of starting over.
+void sound_discard(Sound*);
+
+// Called by the emulation. A write happens `delay` cycles after the cycles
+// counted so far, i.e. where the CPU writing is in the slice that will be
+// passed to sound_advance next (see genesis_slice_cycles).
+void sound_write(Sound*, uint32_t delay, SoundChips, uint8_t address, uint8_t value);
+void sound_advance(Sound*, uint32_t cycles);
+
+// Render all the samples emulated so far
+void sound_render(Sound*);
+
+// Take up to `count` stereo samples from the rendered ones, returns how many were taken
+uint32_t sound_read(Sound*, int16_t* samples, uint32_t count);
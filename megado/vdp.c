@@ -6,6 +6,8 @@
 #include "debugger.h"
 #include "genesis.h"
 #include "m68k/m68k.h"
+#include "parallel_renderer.h"
+#include "render_pipeline.h"
 #include "vdp.h"
 
 #ifdef DEBUG
@@ -28,6 +30,11 @@ Vdp* vdp_make(Genesis* genesis)
     Vdp* v = calloc(1, sizeof(Vdp));
     v->genesis = genesis;
     v->output_buffer = calloc(BUFFER_SIZE, sizeof(uint8_t));
+    v->scanline_buffers = calloc(1, sizeof(ScanlineBuffers)); // The parallel renderer workers have their own
+    v->frameskip.mode = FrameSkipMode_Interval;
+    v->frameskip.interval = 1;
+    v->line_cache = calloc(1, sizeof(LineCache));
+    v->line_cache->enabled = true;
 
     return v;
 }
@@ -37,7 +44,12 @@ void vdp_free(Vdp* v)
     if (v == NULL)
         return;
 
+    parallel_renderer_free(v->parallel);
+    render_pipeline_free(v->pipeline);
     free(v->output_buffer);
+    free(v->index_buffer);
+    free(v->scanline_buffers);
+    free(v->line_cache);
     free(v);
 }
 
@@ -46,6 +58,7 @@ void vdp_initialize(Vdp* v)
     memset(v->vram, 0, 0x10000 * sizeof(uint8_t));
     memset(v->vsram, 0, 0x40 * sizeof(uint16_t));
     memset(v->cram, 0, 0x40 * sizeof(Color));
+    vdp_invalidate_line_cache(v);
 
     // Reset the internal state
 
@@ -65,6 +78,12 @@ void vdp_initialize(Vdp* v)
     v->v_counter = 0;
     v->hblank_counter = 0;
     v->auto_increment = 2;
+
+    // The threaded renderers missed these changes
+    if (v->parallel != NULL)
+        parallel_renderer_cancel(v->parallel);
+    if (v->pipeline != NULL)
+        render_pipeline_sync(v->pipeline);
 }
 
 uint16_t vdp_read_data(Vdp* v)
@@ -104,6 +123,40 @@ uint16_t vdp_read_data(Vdp* v)
     return value;
 }
 
+// Forward the changes that matter for rendering to the threaded renderers
+static void log_change(Vdp* v, VdpLogEntryTypes type, uint16_t address, uint16_t value)
+{
+    if (v->parallel != NULL)
+        parallel_renderer_log(v->parallel, type, address, value);
+    else if (v->pipeline != NULL)
+        render_pipeline_push(v->pipeline, type, address, value);
+}
+
+// All the VRAM/CRAM/VSRAM writes go through these to keep
+// the line cache and the threaded renderers up to date
+
+static void write_vram(Vdp* v, uint16_t address, uint8_t value)
+{
+    v->vram[address] = value;
+    ++v->line_cache->pattern_generations[address >> 5];
+    log_change(v, VdpLogEntry_Vram, address, value);
+}
+
+static void write_cram(Vdp* v, uint16_t address, uint16_t value)
+{
+    uint8_t index = address >> 1 & 0x3F;
+    v->cram[index] = COLOR_11_TO_STRUCT(value);
+    ++v->line_cache->palette_generations[index >> 4];
+    log_change(v, VdpLogEntry_Cram, index, value);
+}
+
+static void write_vsram(Vdp* v, uint16_t address, uint16_t value)
+{
+    uint8_t index = address >> 1 & 0x3F;
+    v->vsram[index] = value;
+    log_change(v, VdpLogEntry_Vsram, index, value);
+}
+
 void vdp_write_data(Vdp* v, uint16_t value)
 {
     //printf("[%06x] data write: %02x\n", v->cpu->instruction_address, value);
@@ -116,8 +169,8 @@ void vdp_write_data(Vdp* v, uint16_t value)
 
         LOG_VDP("\tWrite %04x to VRAM @ %04x\n", value, v->access_address);
 
-        v->vram[v->access_address] = BYTE_HI(value); // TODO sure about that?
-        v->vram[v->access_address ^ 1] = BYTE_LO(value);
+        write_vram(v, v->access_address, BYTE_HI(value)); // TODO sure about that?
+        write_vram(v, v->access_address ^ 1, BYTE_LO(value));
         v->access_address += v->auto_increment;
         break;
 
@@ -125,8 +178,7 @@ void vdp_write_data(Vdp* v, uint16_t value)
 
         LOG_VDP("\tWrite %02x to CRAM @ %02x\n", value, v->access_address >> 1);
 
-        Color color = COLOR_11_TO_STRUCT(value);
-        v->cram[v->access_address >> 1 & 0x3F] = color;
+        write_cram(v, v->access_address, value);
         v->access_address += v->auto_increment;
         break;
 
@@ -134,7 +186,7 @@ void vdp_write_data(Vdp* v, uint16_t value)
 
         LOG_VDP("\tWrite %04x to VSRAM @ %02x\n", value, v->access_address >> 1);
 
-        v->vsram[v->access_address >> 1 & 0x3F] = value;
+        write_vsram(v, v->access_address, value);
         v->access_address += v->auto_increment;
         break;
 
@@ -169,7 +221,7 @@ void vdp_write_data(Vdp* v, uint16_t value)
             uint8_t hi = BYTE_HI(value);
             do
             {
-                v->vram[v->access_address ^ 1] = hi;
+                write_vram(v, v->access_address ^ 1, hi);
                 v->access_address += v->auto_increment;
 
                 // The DMA source address is not used in this process but must be incremented anyway
@@ -184,7 +236,7 @@ void vdp_write_data(Vdp* v, uint16_t value)
             LOG_VDP("\tDMA Fill to CRAM @ %04x, value %04x, length %04x, auto increment %04x\n", v->access_address >> 1, value, v->dma_length, v->auto_increment);
 
             do {
-                v->cram[v->access_address >> 1 & 0x3F] = COLOR_11_TO_STRUCT(value);
+                write_cram(v, v->access_address, value);
                 v->access_address += v->auto_increment;
 
                 ++v->dma_source_address_lo;
@@ -197,7 +249,7 @@ void vdp_write_data(Vdp* v, uint16_t value)
             LOG_VDP("\tDMA Fill to VSRAM @ %04x, value %04x, length %04x, auto increment %04x\n", v->access_address >> 1, value, v->dma_length, v->auto_increment);
 
             do {
-                v->vsram[v->access_address >> 1 & 0x3F] = value;
+                write_vsram(v, v->access_address, value);
                 v->access_address += v->auto_increment;
 
                 ++v->dma_source_address_lo;
@@ -230,175 +282,203 @@ uint16_t vdp_read_control(Vdp* v)
         (v->genesis->region == Region_Europe); // NTSC (0) / PAL (1)
 }
 
-void vdp_write_control(Vdp* v, uint16_t value)
+// Update the internal state of the VDP from a register write
+void vdp_set_register(Vdp* v, uint8_t reg, uint8_t reg_value)
 {
-    LOG_VDP("[%0x] control write: %02x\n", v->genesis->m68k->instruction_address, value);
-
-    // TODO see https://sourceforge.net/p/dgen/dgen/ci/master/tree/vdp.cpp for cancelling commands
+    // Store the raw value
+    v->register_raw_values[reg] = reg_value;
 
-    // Register write (most significant bits are 10)
-    //
-    // Not documented: it seems that words with this pattern are considered
-    // as the second half of a command word is a command is pending (behavior
-    // found in CrazyBus, which has an invalid plane B address if not handled)
-    if ((value & 0xC000) == 0x8000 && !v->pending_command)
+    // Update the internal state of the VDP
+    switch (reg)
     {
-        uint8_t reg = FRAGMENT(value, 12, 8);
-        uint8_t reg_value = WORD_LO(value);
+    case 0:
+        // TODO bit 5
+        v->hblank_interrupt_enabled = BIT(reg_value, 4);
+        v->hv_counter_latched = !BIT(reg_value, 1);
+        // Bit 0 tells the VDP if the display is enabled or not. The difference with bit 6 of register 1 is unclear.
 
-        if (reg > 0x17)
-        {
-            LOG_VDP("\t\tUnhandled register %02X\n", reg);
-            return;
-        }
+        LOG_VDP("\t\tH-blank interrupt %d, HV-counter latched %d\n", v->hblank_interrupt_enabled, v->hv_counter_latched);
+        return;
 
-        LOG_VDP("\tRegister %02X, value %02X\n", reg, reg_value);
+    case 1:
+        v->display_enabled = BIT(reg_value, 6);
+        v->vblank_interrupt_enabled = BIT(reg_value, 5);
+        v->dma_enabled = BIT(reg_value, 4);
+        v->display_height = display_height_values[BIT(reg_value, 3)];
 
-        // Store the raw value
-        v->register_raw_values[reg] = reg_value;
+        LOG_VDP("\t\tDisplay enabled %d, V-blank interrupt %d, DMA enabled %d, Display mode %d\n", v->display_enabled, v->vblank_interrupt_enabled, v->dma_enabled, v->display_height);
+        return;
 
-        // Update the internal state of the VDP
-        switch (reg)
-        {
-        case 0:
-            // TODO bit 5
-            v->hblank_interrupt_enabled = BIT(reg_value, 4);
-            v->hv_counter_latched = !BIT(reg_value, 1);
-            // Bit 0 tells the VDP if the display is enabled or not. The difference with bit 6 of register 1 is unclear.
+    case 2:
+        v->plane_a_nametable = (reg_value & 0x38) * 0x400;
 
-            LOG_VDP("\t\tH-blank interrupt %d, HV-counter latched %d\n", v->hblank_interrupt_enabled, v->hv_counter_latched);
-            return;
+        LOG_VDP("\t\tPlane A nametable %04x\n", v->plane_a_nametable);
+        return;
 
-        case 1:
-            v->display_enabled = BIT(reg_value, 6);
-            v->vblank_interrupt_enabled = BIT(reg_value, 5);
-            v->dma_enabled = BIT(reg_value, 4);
-            v->display_height = display_height_values[BIT(reg_value, 3)];
+    case 3:
+        v->window_nametable = (reg_value & 0x3E) * 0x400;
+        // TODO WD11 is ignored if the display resolution is 320px wide (H40), which limits the Window nametable address to multiples of $1000
+        LOG_VDP("\t\tWindow nametable %04x\n", v->window_nametable);
+        return;
 
-            LOG_VDP("\t\tDisplay enabled %d, V-blank interrupt %d, DMA enabled %d, Display mode %d\n", v->display_enabled, v->vblank_interrupt_enabled, v->dma_enabled, v->display_height);
-            return;
+    case 4:
+        v->plane_b_nametable = ((reg_value & 7) << 3) * 0x400;
 
-        case 2:
-            v->plane_a_nametable = (reg_value & 0x38) * 0x400;
+        LOG_VDP("\t\tPlane B nametable %04x\n", v->plane_b_nametable);
+        return;
 
-            LOG_VDP("\t\tPlane A nametable %04x\n", v->plane_a_nametable);
-            return;
+    case 5:
+        v->sprites_attribute_table = FRAGMENT(reg_value, 6, 0) * 0x200;
 
-        case 3:
-            v->window_nametable = (reg_value & 0x3E) * 0x400;
-            // TODO WD11 is ignored if the display resolution is 320px wide (H40), which limits the Window nametable address to multiples of $1000
-            LOG_VDP("\t\tWindow nametable %04x\n", v->window_nametable);
-            return;
+        LOG_VDP("\t\tSprites attribute table %04x\n", v->sprites_attribute_table);
+        return;
 
-        case 4:
-            v->plane_b_nametable = ((reg_value & 7) << 3) * 0x400;
+    case 7:
+        v->background_color_palette = FRAGMENT(reg_value, 5, 4);
+        v->background_color_entry = FRAGMENT(reg_value, 3, 0);
 
-            LOG_VDP("\t\tPlane B nametable %04x\n", v->plane_b_nametable);
-            return;
+        LOG_VDP("\t\tBackground palette %d, entry %d\n", v->background_color_palette, v->background_color_entry);
+        return;
 
-        case 5:
-            v->sprites_attribute_table = FRAGMENT(reg_value, 6, 0) * 0x200;
+    case 0xA:
+        v->hblank_line = reg_value;
 
-            LOG_VDP("\t\tSprites attribute table %04x\n", v->sprites_attribute_table);
-            return;
+        LOG_VDP("\t\tH-blank counter %04x\n", v->hblank_line);
+        return;
 
-        case 7:
-            v->background_color_palette = FRAGMENT(reg_value, 5, 4);
-            v->background_color_entry = FRAGMENT(reg_value, 3, 0);
+    case 0xB:
+        v->vertical_scrolling_mode = BIT(reg_value, 2);
+        v->horizontal_scrolling_mode = FRAGMENT(reg_value, 1, 0);
 
-            LOG_VDP("\t\tBackground palette %d, entry %d\n", v->background_color_palette, v->background_color_entry);
-            return;
+        LOG_VDP("\t\tVertical scrolling %d, Horizontal scrolling %d\n", v->vertical_scrolling_mode, v->horizontal_scrolling_mode);
+        return;
 
-        case 0xA:
-            v->hblank_line = reg_value;
+    case 0xC:
+        v->display_width = display_width_values[BIT(reg_value, 7)];
+        v->shadow_highlight_enabled = BIT(reg_value, 3);
+        v->interlace_mode = FRAGMENT(reg_value, 2, 1);
 
-            LOG_VDP("\t\tH-blank counter %04x\n", v->hblank_line);
-            return;
+        LOG_VDP("\t\tDisplay width %d, Shadow/Highlight enabled %d, Interlace mode  %d\n", v->display_height, v->shadow_highlight_enabled, v->interlace_mode);
+        return;
 
-        case 0xB:
-            v->vertical_scrolling_mode = BIT(reg_value, 2);
-            v->horizontal_scrolling_mode = FRAGMENT(reg_value, 1, 0);
+    case 0xD:
+        v->horizontal_scrolltable = FRAGMENT(reg_value, 5, 0) * 0x400;
 
-            LOG_VDP("\t\tVertical scrolling %d, Horizontal scrolling %d\n", v->vertical_scrolling_mode, v->horizontal_scrolling_mode);
-            return;
+        LOG_VDP("\t\tHorizontal scrolltable %d\n", v->horizontal_scrolltable);
+        return;
 
-        case 0xC:
-            v->display_width = display_width_values[BIT(reg_value, 7)];
-            v->shadow_highlight_enabled = BIT(reg_value, 3);
-            v->interlace_mode = FRAGMENT(reg_value, 2, 1);
+    case 0xF:
+        v->auto_increment = reg_value;
 
-            LOG_VDP("\t\tDisplay width %d, Shadow/Highlight enabled %d, Interlace mode  %d\n", v->display_height, v->shadow_highlight_enabled, v->interlace_mode);
-            if (v->interlace_mode != 0)
-                printf("WARNING interlace mode not supported!");
-            return;
+        LOG_VDP("\t\tAuto-increment %d\n", v->auto_increment);
+        return;
 
-        case 0xD:
-            v->horizontal_scrolltable = FRAGMENT(reg_value, 5, 0) * 0x400;
+    case 0x10:
+        v->plane_width = plane_size_values[FRAGMENT(reg_value, 5, 4)];
+        v->plane_height = plane_size_values[FRAGMENT(reg_value, 1, 0)];
 
-            LOG_VDP("\t\tHorizontal scrolltable %d\n", v->horizontal_scrolltable);
-            return;
+        LOG_VDP("\t\tVertical plane size %d, Horizontal plane size %d\n", v->plane_width, v->plane_height);
+        return;
 
-        case 0xF:
-            v->auto_increment = reg_value;
+    case 0x11:
+        v->window_plane_horizontal_direction = BIT(reg_value, 7);
+        v->window_plane_horizontal_offset = FRAGMENT(reg_value, 4, 0);
 
-            LOG_VDP("\t\tAuto-increment %d\n", v->auto_increment);
-            return;
+        LOG_VDP("\t\tHorizontal Window plane direction %d, Window plane offset %d\n", v->window_plane_horizontal_direction, v->window_plane_horizontal_offset);
+        return;
 
-        case 0x10:
-            v->plane_width = plane_size_values[FRAGMENT(reg_value, 5, 4)];
-            v->plane_height = plane_size_values[FRAGMENT(reg_value, 1, 0)];
+    case 0x12:
+        v->window_plane_vertical_direction = BIT(reg_value, 7);
+        v->window_plane_vertical_offset = FRAGMENT(reg_value, 4, 0);
 
-            LOG_VDP("\t\tVertical plane size %d, Horizontal plane size %d\n", v->plane_width, v->plane_height);
-            return;
+        LOG_VDP("\t\tVertical window plane direction %d, Window plane offset %d\n", v->window_plane_vertical_offset, v->window_plane_vertical_offset);
+        return;
 
-        case 0x11:
-            v->window_plane_horizontal_direction = BIT(reg_value, 7);
-            v->window_plane_horizontal_offset = FRAGMENT(reg_value, 4, 0);
+    case 0x13:
+        v->dma_length = (v->dma_length & 0xFF00) | reg_value;
 
-            LOG_VDP("\t\tHorizontal Window plane direction %d, Window plane offset %d\n", v->window_plane_horizontal_direction, v->window_plane_horizontal_offset);
-            return;
+        LOG_VDP("\t\tDMA length low %02x (%04x)\n", reg_value, v->dma_length);
+        return;
+    case 0x14:
+        v->dma_length = (v->dma_length & 0x00FF) | (reg_value << 8);
 
-        case 0x12:
-            v->window_plane_vertical_direction = BIT(reg_value, 7);
-            v->window_plane_vertical_offset = FRAGMENT(reg_value, 4, 0);
+        LOG_VDP("\t\tDMA length high %02x (%04x)\n", reg_value, v->dma_length);
+        return;
 
-            LOG_VDP("\t\tVertical window plane direction %d, Window plane offset %d\n", v->window_plane_vertical_offset, v->window_plane_vertical_offset);
-            return;
+    case 0x15:
+        v->dma_source_address_lo = (v->dma_source_address_lo & 0xFF00) | reg_value;
 
-        case 0x13:
-            v->dma_length = (v->dma_length & 0xFF00) | reg_value;
+        LOG_VDP("\t\tDMA source address low %02x (%08x)\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo);
+        return;
+    case 0x16:
+        v->dma_source_address_lo = (v->dma_source_address_lo & 0x00FF) | (reg_value << 8);
 
-            LOG_VDP("\t\tDMA length low %02x (%04x)\n", reg_value, v->dma_length);
-            return;
-        case 0x14:
-            v->dma_length = (v->dma_length & 0x00FF) | (reg_value << 8);
+        LOG_VDP("\t\tDMA source address med %02x (%08x)\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo);
+        return;
+    case 0x17:
+        v->dma_type = FRAGMENT(reg_value, 7, 6); // TODO convert
 
-            LOG_VDP("\t\tDMA length high %02x (%04x)\n", reg_value, v->dma_length);
-            return;
+        uint8_t address_mask = v->dma_type > 1 ? 0x3F : 0x7F; // Bit 6 is only part of the address for memory to VRAM DMA transfers
+        v->dma_source_address_hi = reg_value & address_mask;
 
-        case 0x15:
-            v->dma_source_address_lo = (v->dma_source_address_lo & 0xFF00) | reg_value;
+        LOG_VDP("\t\tDMA source address high %02x (%08x), DMA type %04x\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo, v->dma_type);
+        return;
 
-            LOG_VDP("\t\tDMA source address low %02x (%08x)\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo);
-            return;
-        case 0x16:
-            v->dma_source_address_lo = (v->dma_source_address_lo & 0x00FF) | (reg_value << 8);
+    default:
+        LOG_VDP("\t\tUnhandled register %02X\n", reg);
+        return;
+    }
+}
 
-            LOG_VDP("\t\tDMA source address med %02x (%08x)\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo);
-            return;
-        case 0x17:
-            v->dma_type = FRAGMENT(reg_value, 7, 6); // TODO convert
+void vdp_apply_log_entry(Vdp* v, VdpLogEntry* entry)
+{
+    switch (entry->type)
+    {
+    case VdpLogEntry_Vram:
+        v->vram[entry->address] = entry->value;
+        break;
+    case VdpLogEntry_Cram:
+        v->cram[entry->address] = COLOR_11_TO_STRUCT(entry->value);
+        break;
+    case VdpLogEntry_Vsram:
+        v->vsram[entry->address] = entry->value;
+        break;
+    case VdpLogEntry_Register:
+        vdp_set_register(v, entry->address, entry->value);
+        break;
+    }
+}
 
-            uint8_t address_mask = v->dma_type > 1 ? 0x3F : 0x7F; // Bit 6 is only part of the address for memory to VRAM DMA transfers
-            v->dma_source_address_hi = reg_value & address_mask;
+void vdp_write_control(Vdp* v, uint16_t value)
+{
+    LOG_VDP("[%0x] control write: %02x\n", v->genesis->m68k->instruction_address, value);
 
-            LOG_VDP("\t\tDMA source address high %02x (%08x), DMA type %04x\n", reg_value, v->dma_source_address_hi << 16 | v->dma_source_address_lo, v->dma_type);
-            return;
+    // TODO see https://sourceforge.net/p/dgen/dgen/ci/master/tree/vdp.cpp for cancelling commands
 
-        default:
+    // Register write (most significant bits are 10)
+    //
+    // Not documented: it seems that words with this pattern are considered
+    // as the second half of a command word is a command is pending (behavior
+    // found in CrazyBus, which has an invalid plane B address if not handled)
+    if ((value & 0xC000) == 0x8000 && !v->pending_command)
+    {
+        uint8_t reg = FRAGMENT(value, 12, 8);
+        uint8_t reg_value = WORD_LO(value);
+
+        if (reg > 0x17)
+        {
             LOG_VDP("\t\tUnhandled register %02X\n", reg);
             return;
         }
+
+        LOG_VDP("\tRegister %02X, value %02X\n", reg, reg_value);
+
+        vdp_set_register(v, reg, reg_value);
+
+        if (reg == 0xC && v->interlace_mode != 0)
+            printf("WARNING interlace mode not supported!");
+
+        log_change(v, VdpLogEntry_Register, reg, reg_value);
     }
     // Command word
     else
@@ -435,8 +515,8 @@ void vdp_write_control(Vdp* v, uint16_t value)
 
                         do {
                             uint16_t value = m68k_read_w(v->genesis->m68k, (v->dma_source_address_hi << 16 | v->dma_source_address_lo) << 1);
-                            v->vram[v->access_address] = BYTE_HI(value);
-                            v->vram[v->access_address ^ 1] = BYTE_LO(value);
+                            write_vram(v, v->access_address, BYTE_HI(value));
+                            write_vram(v, v->access_address ^ 1, BYTE_LO(value));
 
                             ++v->dma_source_address_lo;
                             v->access_address += v->auto_increment;
@@ -455,8 +535,7 @@ void vdp_write_control(Vdp* v, uint16_t value)
                             break;*/
 
                             uint16_t value = m68k_read_w(v->genesis->m68k, (v->dma_source_address_hi << 16 | v->dma_source_address_lo) << 1);
-                            Color color = COLOR_11_TO_STRUCT(value);
-                            v->cram[v->access_address >> 1 & 0x3F] = color;
+                            write_cram(v, v->access_address, value);
 
                             ++v->dma_source_address_lo;
                             v->access_address += v->auto_increment;
@@ -468,7 +547,7 @@ void vdp_write_control(Vdp* v, uint16_t value)
                         LOG_VDP("\tDMA transfer from %04x to VSRAM @ %04x, length %04x, auto increment %04x\n", (v->dma_source_address_hi << 16 | v->dma_source_address_lo) << 1, v->access_address, v->dma_length, v->auto_increment);
 
                         do {
-                            v->vsram[v->access_address >> 1 & 0x3F] = m68k_read_w(v->genesis->m68k, (v->dma_source_address_hi << 16 | v->dma_source_address_lo) << 1);
+                            write_vsram(v, v->access_address, m68k_read_w(v->genesis->m68k, (v->dma_source_address_hi << 16 | v->dma_source_address_lo) << 1));
 
                             ++v->dma_source_address_lo;
                             v->access_address += v->auto_increment;
@@ -511,14 +590,11 @@ void vdp_get_resolution(Vdp* v, uint16_t* width, uint16_t* height)
 
 void vdp_get_plane_cell_data(Vdp* v, Planes plane, uint16_t cell_index, uint16_t* pattern_index, uint16_t* palette, bool* priority, bool* horizontal_flip, bool* vertical_flip)
 {
-    uint8_t* plane_offset = v->vram;
-    switch (plane)
-    {
-    case Plane_A: plane_offset += v->plane_a_nametable; break;
-    case Plane_B: plane_offset += v->plane_b_nametable; break;
-    case Plane_Window: plane_offset += v->window_nametable; break;
-    }
+    uint32_t nametable;
+    uint16_t plane_width, plane_height;
+    vdp_get_plane_layout(v, plane, &nametable, &plane_width, &plane_height);
 
+    uint8_t* plane_offset = v->vram + nametable;
     uint16_t pattern_data = (plane_offset[cell_index * 2] << 8) | plane_offset[cell_index * 2 + 1];
 
     *priority = BIT(pattern_data, 15);
@@ -559,16 +635,11 @@ void vdp_draw_pattern(Vdp* v, uint16_t pattern_index, Color* palette, uint8_t* b
 
 void vdp_draw_plane(Vdp* v, Planes plane, uint8_t* buffer, uint32_t buffer_width)
 {
-    uint8_t* plane_offset = v->vram;
-    switch (plane)
-    {
-    case Plane_A: plane_offset += v->plane_a_nametable; break;
-    case Plane_B: plane_offset += v->plane_b_nametable; break;
-    case Plane_Window: plane_offset += v->window_nametable; break;
-    }
+    uint32_t nametable;
+    uint16_t plane_width, plane_height;
+    vdp_get_plane_layout(v, plane, &nametable, &plane_width, &plane_height);
 
-    uint16_t plane_width = plane == Plane_Window ? (v->display_width == 32 ? 32 : 64) : v->plane_height;
-    uint16_t plane_height = plane == Plane_Window ? 32 : v->plane_width;
+    uint8_t* plane_offset = v->vram + nametable;
 
     for (int py = 0; py < plane_height; ++py)
         for (int px = 0; px < plane_width; ++px)
@@ -664,73 +735,102 @@ void vdp_draw_sprites(Vdp* v, uint8_t* buffer, uint32_t buffer_width)
     } while (sprite != 0 && sprite_counter < 64);
 }
 
-typedef struct {
-    bool drawn[BUFFER_WIDTH];
-    uint8_t colors[BUFFER_WIDTH]; // color indices
-    bool priorities[BUFFER_WIDTH];
-} ScanlineData;
+// Check if the window plane is visible on the given scanline.
+//
+// It is not when:
+// - The window plane is disabled (reg 0x11 is 0 && reg 0x12 is 0)
+// - The window plane is visible from the first line to the offset (direction is 0) but the scanline is below
+// - The window plane is visible from the offset to the last line (direction is 1) but the scanline is above
+//
+// https://emudocs.org/Genesis/Graphics/genvdp.txt
+// http://gendev.spritesmind.net/forum/viewtopic.php?f=2&t=2492&p=30175#p30183
+static bool window_visible(Vdp* v, int scanline)
+{
+    return !(
+        (v->register_raw_values[0x11] == 0 && v->register_raw_values[0x12] == 0) || // The window is disabled
+        (scanline >= v->window_plane_vertical_offset * 8) ^ v->window_plane_vertical_direction); // The window is not visible on that line
+}
 
-static ScanlineData plane_a_scanline;
-static ScanlineData plane_b_scanline;
-static ScanlineData plane_w_scanline;
-static ScanlineData sprites_scanline;
+// The size of planes A and B is defined by register 0x10.
+//
+// For the window plane:
+// - in H32 mode, it is 32 cells wide.
+// - in H40 mode, it is 64 cells wide.
+// - it seems to always be 32 cells high.
+// TODO any doc to confirm that?
+static void plane_size(Vdp* v, Planes plane, uint8_t* width, uint8_t* height)
+{
+    *width = plane == Plane_Window ? (v->display_width == 32 ? 32 : 64) : v->plane_height;
+    *height = plane == Plane_Window ? 32 : v->plane_width;
+}
 
-void vdp_get_plane_scanline(Vdp* v, Planes plane, int scanline, ScanlineData* data)
+static uint16_t plane_horizontal_scroll(Vdp* v, Planes plane, int scanline)
 {
-    // Exit early if we are rendering the window plane but it is not visible on that scanline.
-    //
-    // This can occur due to the following circumstances:
-    // - The window plane is disabled (reg 0x11 is 0 && reg 0x12 is 0)
-    // - The window plane is visible from the first line to the offset (direction is 0) but the scanline is below
-    // - The window plane is visible from the offset to the last line (direction is 1) but the scanline is above
-    //
-    // https://emudocs.org/Genesis/Graphics/genvdp.txt
-    // http://gendev.spritesmind.net/forum/viewtopic.php?f=2&t=2492&p=30175#p30183
+    if (plane == Plane_Window)
+        return 0;
 
-    if (plane == Plane_Window && (
-        (v->register_raw_values[0x11] == 0 && v->register_raw_values[0x12] == 0) || // The window is disabled
-        (scanline >= v->window_plane_vertical_offset * 8) ^ v->window_plane_vertical_direction)) // The window is not visible on that line
-    {
-        for (uint16_t i = 0; i < BUFFER_WIDTH; ++i)
-            data->drawn[i] = false;
-        return;
-    }
+    uint8_t* horizontal_scroll_offset = v->vram + v->horizontal_scrolltable;
+
+    if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Screen)
+        horizontal_scroll_offset += plane == Plane_A ? 0 : 2;
+    else if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Row)
+        horizontal_scroll_offset += scanline / 8 * 32 + (plane == Plane_A ? 0 : 2); // TODO use y before or after vertical scrolling?!
+    else if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Line)
+        horizontal_scroll_offset += scanline * 4 + (plane == Plane_A ? 0 : 2); // TODO use y before or after vertical scrolling?!
+
+    return (horizontal_scroll_offset[0] << 8 | horizontal_scroll_offset[1]) & 0x3FF;
+}
+
+static uint16_t plane_vertical_scroll(Vdp* v, Planes plane, uint16_t pixel)
+{
+    if (plane == Plane_Window)
+        return 0;
 
-    uint8_t* plane_offset = v->vram;
+    if (v->vertical_scrolling_mode == VerticalScrollingMode_TwoColumns)
+        return v->vsram[pixel / 16 * 2 + (plane == Plane_A ? 0 : 1)] & 0x3FF; // TODO use x before or after horizontal scrolling?!
+
+    return v->vsram[plane == Plane_A ? 0 : 1];
+}
+
+static uint8_t* plane_nametable(Vdp* v, Planes plane)
+{
     switch (plane)
     {
-    case Plane_A: plane_offset += v->plane_a_nametable; break;
-    case Plane_B: plane_offset += v->plane_b_nametable; break;
-    case Plane_Window: plane_offset += v->window_nametable; break;
+    case Plane_A: return v->vram + v->plane_a_nametable;
+    case Plane_B: return v->vram + v->plane_b_nametable;
+    case Plane_Window: return v->vram + v->window_nametable;
     }
 
-    // Handle horizontal scrolling
+    return v->vram;
+}
 
-    uint16_t horizontal_scroll = 0;
+void vdp_get_plane_layout(Vdp* v, Planes plane, uint32_t* nametable, uint16_t* width, uint16_t* height)
+{
+    *nametable = (uint32_t)(plane_nametable(v, plane) - v->vram);
 
-    if (plane != Plane_Window)
+    uint8_t plane_width, plane_height;
+    plane_size(v, plane, &plane_width, &plane_height);
+    *width = plane_width;
+    *height = plane_height;
+}
+
+void vdp_get_plane_scanline(Vdp* v, Planes plane, int scanline, ScanlineData* data)
+{
+    // Exit early if we are rendering the window plane but it is not visible on that scanline.
+    if (plane == Plane_Window && !window_visible(v, scanline))
     {
-        uint8_t* horizontal_scroll_offset = v->vram + v->horizontal_scrolltable;
+        for (uint16_t i = 0; i < BUFFER_WIDTH; ++i)
+            data->drawn[i] = false;
+        return;
+    }
 
-        if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Screen)
-            horizontal_scroll_offset += plane == Plane_A ? 0 : 2;
-        else if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Row)
-            horizontal_scroll_offset += scanline / 8 * 32 + (plane == Plane_A ? 0 : 2); // TODO use y before or after vertical scrolling?!
-        else if (v->horizontal_scrolling_mode == HorizontalScrollingMode_Line)
-            horizontal_scroll_offset += scanline * 4 + (plane == Plane_A ? 0 : 2); // TODO use y before or after vertical scrolling?!
+    uint8_t* plane_offset = plane_nametable(v, plane);
 
-        horizontal_scroll = (horizontal_scroll_offset[0] << 8 | horizontal_scroll_offset[1]) & 0x3FF;
-    }
+    // Handle horizontal scrolling
+    uint16_t horizontal_scroll = plane_horizontal_scroll(v, plane, scanline);
 
-    // The size of planes A and B is defined by register 0x10.
-    //
-    // For the window plane:
-    // - in H32 mode, it is 32 cells wide.
-    // - in H40 mode, it is 64 cells wide.
-    // - it seems to always be 32 cells high.
-    // TODO any doc to confirm that?
-    uint8_t plane_width = plane == Plane_Window ? (v->display_width == 32 ? 32 : 64) : v->plane_height;
-    uint8_t plane_height = plane == Plane_Window ? 32 : v->plane_width;
+    uint8_t plane_width, plane_height;
+    plane_size(v, plane, &plane_width, &plane_height);
 
     uint16_t screen_width = v->display_width * 8;
     for (uint16_t pixel = 0; pixel < screen_width; ++pixel)
@@ -738,16 +838,7 @@ void vdp_get_plane_scanline(Vdp* v, Planes plane, int scanline, ScanlineData* da
         // TODO horizontal windowing
 
         // Handle vertical scrolling
-
-        uint16_t vertical_scroll = 0;
-
-        if (plane != Plane_Window)
-        {
-            if (v->vertical_scrolling_mode == VerticalScrollingMode_Screen)
-                vertical_scroll = v->vsram[plane == Plane_A ? 0 : 1];
-            else if (v->vertical_scrolling_mode == VerticalScrollingMode_TwoColumns)
-                vertical_scroll = v->vsram[pixel / 16 * 2 + (plane == Plane_A ? 0 : 1)] & 0x3FF; // TODO use x before or after horizontal scrolling?!
-        }
+        uint16_t vertical_scroll = plane_vertical_scroll(v, plane, pixel);
 
         uint16_t x = (uint16_t)(pixel - horizontal_scroll) % (plane_width * 8);
         uint16_t y = (uint16_t)(scanline + vertical_scroll) % (plane_height * 8);
@@ -883,9 +974,10 @@ void vdp_get_sprites_scanline(Vdp* v, int scanline, ScanlineData* data)
 }
 
 // Adjust the color of the given pixel if Shadow/Highlight mode is enabled
-Color shadow_highlight(Vdp* v, ScanlineData plane_scanline, ScanlineData sprites_scanline, bool plane_priority, int pixel)
+Color shadow_highlight(Vdp* v, ScanlineData plane_scanline, ScanlineData sprites_scanline, bool plane_priority, int pixel, uint8_t* index)
 {
-    Color color = v->cram[plane_scanline.colors[pixel]];
+    *index = plane_scanline.colors[pixel];
+    Color color = v->cram[*index];
 
     if (!v->shadow_highlight_enabled)
         return color;
@@ -911,25 +1003,27 @@ Color shadow_highlight(Vdp* v, ScanlineData plane_scanline, ScanlineData sprites
     if (shadow_highlight < 1)
     {
         color = COLOR_11_TO_STRUCT((COLOR_STRUCT_TO_11(color) & 0xEEE) >> 1);
+        *index |= INDEX_SHADOW;
     }
     // Highlighted: divide color by 2 and add 0x888
     else if (shadow_highlight > 1)
     {
         color = COLOR_11_TO_STRUCT(((COLOR_STRUCT_TO_11(color) & 0xEEE) >> 1) | 0x888);
+        *index |= INDEX_HIGHLIGHT;
     }
 
     return color;
 }
 
-void render_scanline(Vdp* v, int scanline)
+void vdp_render_scanline(Vdp* v, int scanline, ScanlineBuffers* buffers)
 {
-    Color background_color = v->cram[v->background_color_palette * 16 + v->background_color_entry];
+    uint8_t background_index = v->background_color_palette * 16 + v->background_color_entry;
 
     // Get color & priority data for each layer
-    vdp_get_plane_scanline(v, Plane_A, scanline, &plane_a_scanline);
-    vdp_get_plane_scanline(v, Plane_B, scanline, &plane_b_scanline);
-    vdp_get_plane_scanline(v, Plane_Window, scanline, &plane_w_scanline);
-    vdp_get_sprites_scanline(v, scanline, &sprites_scanline);
+    vdp_get_plane_scanline(v, Plane_A, scanline, &buffers->plane_a);
+    vdp_get_plane_scanline(v, Plane_B, scanline, &buffers->plane_b);
+    vdp_get_plane_scanline(v, Plane_Window, scanline, &buffers->window);
+    vdp_get_sprites_scanline(v, scanline, &buffers->sprites);
 
     // Combine the layers
     uint16_t screen_width = v->display_width * 8;
@@ -939,57 +1033,66 @@ void render_scanline(Vdp* v, int scanline)
         // TODO more details
 
         Color pixel_color;
+        uint8_t index;
 
         // For Shadow/Highlight mode: check if at least one plane has its priority set
-        bool plane_priority = v->shadow_highlight_enabled && (plane_a_scanline.priorities[pixel] || plane_b_scanline.priorities[pixel]);
+        bool plane_priority = v->shadow_highlight_enabled && (buffers->plane_a.priorities[pixel] || buffers->plane_b.priorities[pixel]);
 
         // TODO can sprites be shadowed/highlighted?
 
         // Window (priority)
-        if (plane_w_scanline.drawn[pixel] && plane_w_scanline.priorities[pixel]) 
-            pixel_color = v->cram[plane_w_scanline.colors[pixel]];
+        if (buffers->window.drawn[pixel] && buffers->window.priorities[pixel]) 
+            pixel_color = v->cram[index = buffers->window.colors[pixel]];
         
         // Sprites (priority)
-        else if (sprites_scanline.drawn[pixel] && sprites_scanline.priorities[pixel] &&
-                (!v->shadow_highlight_enabled || sprites_scanline.colors[pixel] < 62)) // Do not draw the sprite if it's used as a Shadow/Highlight mask            
-            pixel_color = v->cram[sprites_scanline.colors[pixel]];
+        else if (buffers->sprites.drawn[pixel] && buffers->sprites.priorities[pixel] &&
+                (!v->shadow_highlight_enabled || buffers->sprites.colors[pixel] < 62)) // Do not draw the sprite if it's used as a Shadow/Highlight mask            
+            pixel_color = v->cram[index = buffers->sprites.colors[pixel]];
         
         // A (priority)
-        else if (plane_a_scanline.drawn[pixel] && plane_a_scanline.priorities[pixel])
-            pixel_color = shadow_highlight(v, plane_a_scanline, sprites_scanline, plane_priority, pixel);
+        else if (buffers->plane_a.drawn[pixel] && buffers->plane_a.priorities[pixel])
+            pixel_color = shadow_highlight(v, buffers->plane_a, buffers->sprites, plane_priority, pixel, &index);
         
         // B (priority)
-        else if (plane_b_scanline.drawn[pixel] && plane_b_scanline.priorities[pixel])
-            pixel_color = shadow_highlight(v, plane_b_scanline, sprites_scanline, plane_priority, pixel);
+        else if (buffers->plane_b.drawn[pixel] && buffers->plane_b.priorities[pixel])
+            pixel_color = shadow_highlight(v, buffers->plane_b, buffers->sprites, plane_priority, pixel, &index);
         
         // Window
-        else if (plane_w_scanline.drawn[pixel]) 
-            pixel_color = shadow_highlight(v, plane_w_scanline, plane_b_scanline, plane_priority, pixel);
+        else if (buffers->window.drawn[pixel]) 
+            pixel_color = shadow_highlight(v, buffers->window, buffers->plane_b, plane_priority, pixel, &index);
 
         // Sprites
-        else if (sprites_scanline.drawn[pixel] &&
-                (!v->shadow_highlight_enabled || sprites_scanline.colors[pixel] < 62))
-                pixel_color = v->cram[sprites_scanline.colors[pixel]];
+        else if (buffers->sprites.drawn[pixel] &&
+                (!v->shadow_highlight_enabled || buffers->sprites.colors[pixel] < 62))
+                pixel_color = v->cram[index = buffers->sprites.colors[pixel]];
 
         // A
-        else if (plane_a_scanline.drawn[pixel]) 
-            pixel_color = shadow_highlight(v, plane_a_scanline, sprites_scanline, plane_priority, pixel);
+        else if (buffers->plane_a.drawn[pixel]) 
+            pixel_color = shadow_highlight(v, buffers->plane_a, buffers->sprites, plane_priority, pixel, &index);
         
         // B
-        else if (plane_b_scanline.drawn[pixel])
-            pixel_color = shadow_highlight(v, plane_b_scanline, sprites_scanline, plane_priority, pixel);
+        else if (buffers->plane_b.drawn[pixel])
+            pixel_color = shadow_highlight(v, buffers->plane_b, buffers->sprites, plane_priority, pixel, &index);
         
         // Background
         else
-            pixel_color = background_color;
+            pixel_color = v->cram[index = background_index];
 
         uint32_t pixel_offset = (scanline * BUFFER_WIDTH + pixel) * 3;
         v->output_buffer[pixel_offset] = pixel_color.r;
         v->output_buffer[pixel_offset + 1] = pixel_color.g;
         v->output_buffer[pixel_offset + 2] = pixel_color.b;
+
+        if (v->index_buffer != NULL)
+            v->index_buffer[scanline * BUFFER_WIDTH + pixel] = index;
     }
 }
 
+static void render_scanline(Vdp* v, int scanline)
+{
+    vdp_render_scanline(v, scanline, v->scanline_buffers);
+}
+
 static void vdp_clock(Vdp* v) {
     v->clock++;
 
@@ -1021,13 +1124,260 @@ void vdp_run_cycles(Vdp* v, uint32_t cycles) {
     }
 }
 
+void vdp_request_frame(Vdp* v)
+{
+    v->frameskip.requested = true;
+}
+
+// Decide whether the frame that is starting will be drawn
+static void begin_frame(Vdp* v)
+{
+    FrameSkip* f = &v->frameskip;
+
+    switch (f->mode)
+    {
+    case FrameSkipMode_Interval:
+        f->rendering = f->counter == 0;
+        f->counter = f->interval > 1 ? (f->counter + 1) % f->interval : 0;
+        break;
+
+    case FrameSkipMode_OnDemand:
+        f->rendering = f->requested;
+        f->requested = false;
+        break;
+    }
+}
+
+// The last visible line is over, the frame is complete
+static void end_frame(Vdp* v)
+{
+    FrameSkip* f = &v->frameskip;
+
+    if (f->rendering)
+        ++f->rendered_frames;
+    else
+        ++f->skipped_frames;
+}
+
+void vdp_invalidate_line_cache(Vdp* v)
+{
+    memset(v->line_cache->valid, 0, sizeof(v->line_cache->valid));
+}
+
+static void stop_threaded_rendering(Vdp* v)
+{
+    parallel_renderer_free(v->parallel);
+    render_pipeline_free(v->pipeline);
+    v->parallel = NULL;
+    v->pipeline = NULL;
+}
+
+void vdp_set_render_threads(Vdp* v, int threads)
+{
+    stop_threaded_rendering(v);
+    v->parallel = threads > 1 ? parallel_renderer_make(v, threads) : NULL;
+}
+
+void vdp_set_pipelined_rendering(Vdp* v, bool enabled)
+{
+    stop_threaded_rendering(v);
+    v->pipeline = enabled ? render_pipeline_make(v) : NULL;
+}
+
+void vdp_record_indices(Vdp* v, bool enabled)
+{
+    if (enabled && v->index_buffer == NULL)
+    {
+        v->index_buffer = calloc(BUFFER_WIDTH * BUFFER_HEIGHT, sizeof(uint8_t));
+        vdp_invalidate_line_cache(v); // The cached lines were not recorded
+    }
+    else if (!enabled)
+    {
+        free(v->index_buffer);
+        v->index_buffer = NULL;
+    }
+}
+
+static uint64_t hash_value(uint64_t hash, uint32_t value)
+{
+    return (hash ^ value) * 0x100000001B3; // FNV-1a prime
+}
+
+// Hash a nametable entry along with the generation of the pattern it points to
+static uint64_t hash_cell(Vdp* v, uint8_t* nametable, uint16_t offset, uint64_t hash, uint8_t* palettes)
+{
+    uint16_t pattern_data = nametable[offset] << 8 | nametable[offset + 1];
+    *palettes |= 1 << FRAGMENT(pattern_data, 14, 13);
+
+    hash = hash_value(hash, pattern_data);
+    return hash_value(hash, v->line_cache->pattern_generations[pattern_data & 0x7FF]);
+}
+
+// Hash the plane cells covered by a scanline.
+// This follows the same addressing as vdp_get_plane_scanline, one cell at a time.
+static uint64_t hash_plane(Vdp* v, Planes plane, int scanline, uint64_t hash, uint8_t* palettes)
+{
+    if (plane == Plane_Window)
+    {
+        bool visible = window_visible(v, scanline);
+        hash = hash_value(hash, visible);
+        if (!visible)
+            return hash;
+    }
+
+    uint8_t* nametable = plane_nametable(v, plane);
+
+    uint8_t plane_width, plane_height;
+    plane_size(v, plane, &plane_width, &plane_height);
+    hash = hash_value(hash, plane_width << 8 | plane_height);
+
+    uint16_t horizontal_scroll = plane_horizontal_scroll(v, plane, scanline);
+    hash = hash_value(hash, horizontal_scroll);
+
+    // The vertical scrolling can change every two cells
+    uint16_t screen_width = v->display_width * 8;
+    for (uint16_t column = 0; column < screen_width; column += 16)
+    {
+        uint16_t y = (uint16_t)(scanline + plane_vertical_scroll(v, plane, column)) % (plane_height * 8);
+        uint16_t x = (uint16_t)(column - horizontal_scroll) % (plane_width * 8);
+        hash = hash_value(hash, y);
+
+        uint8_t cells = (x % 8 + 16 + 7) / 8;
+        for (uint8_t cell = 0; cell < cells; ++cell)
+            hash = hash_cell(v, nametable, (y / 8 * plane_width + (x / 8 + cell) % plane_width) * 2, hash, palettes);
+    }
+
+    return hash;
+}
+
+// Hash the sprites that appear on a scanline.
+// This walks the sprite list the same way vdp_get_sprites_scanline does.
+static uint64_t hash_sprites(Vdp* v, int scanline, uint64_t hash, uint8_t* palettes)
+{
+    uint8_t* attribute_table = v->vram + v->sprites_attribute_table;
+
+    uint8_t sprite = 0;
+    uint8_t sprite_counter = 0;
+    do
+    {
+        uint8_t* attributes = attribute_table + sprite * 8;
+
+        int16_t y = ((attributes[0] & 3) << 8 | attributes[1]) - 128;
+        uint8_t width = FRAGMENT(attributes[2], 3, 2) + 1;
+        uint8_t height = FRAGMENT(attributes[2], 1, 0) + 1;
+        uint8_t total_height = height * 8;
+
+        if (scanline >= y && scanline < y + total_height)
+        {
+            hash = hash_value(hash, (uint32_t)attributes[0] << 24 | attributes[1] << 16 | attributes[2] << 8 | attributes[3]);
+            hash = hash_value(hash, (uint32_t)attributes[4] << 24 | attributes[5] << 16 | attributes[6] << 8 | attributes[7]);
+
+            uint16_t pattern_index = (attributes[4] & 7) << 8 | attributes[5];
+            bool vertical_flip = BIT(attributes[4], 4);
+            uint8_t sprite_y = vertical_flip ? total_height - (scanline - y) - 1 : scanline - y;
+
+            *palettes |= 1 << FRAGMENT(attributes[4], 6, 5);
+
+            // Sprite patterns are laid out column by column
+            for (uint8_t column = 0; column < width; ++column)
+                hash = hash_value(hash, v->line_cache->pattern_generations[(pattern_index + column * height + sprite_y / 8) & 0x7FF]);
+        }
+
+        ++sprite_counter;
+        sprite = attributes[3] & 0x7F;
+
+    } while (sprite != 0 && sprite_counter < 64);
+
+    return hash;
+}
+
+// Compute a signature of everything a scanline reads
+static uint64_t line_signature(Vdp* v, int scanline)
+{
+    uint64_t hash = 0xCBF29CE484222325; // FNV-1a offset basis
+
+    hash = hash_value(hash, v->display_width << 8 | v->shadow_highlight_enabled);
+    hash = hash_value(hash, v->background_color_palette << 8 | v->background_color_entry);
+
+    uint8_t palettes = 1 << v->background_color_palette;
+
+    hash = hash_plane(v, Plane_A, scanline, hash, &palettes);
+    hash = hash_plane(v, Plane_B, scanline, hash, &palettes);
+    hash = hash_plane(v, Plane_Window, scanline, hash, &palettes);
+    hash = hash_sprites(v, scanline, hash, &palettes);
+
+    for (uint8_t palette = 0; palette < 4; ++palette)
+        if (palettes & 1 << palette)
+            hash = hash_value(hash, v->line_cache->palette_generations[palette]);
+
+    return hash;
+}
+
+// Render a scanline unless its inputs did not change since it was last drawn
+static void draw_line(Vdp* v, int scanline)
+{
+    LineCache* cache = v->line_cache;
+
+    if (!cache->enabled)
+    {
+        cache->valid[scanline] = false;
+        render_scanline(v, scanline);
+        return;
+    }
+
+    uint64_t signature = line_signature(v, scanline);
+
+    if (cache->valid[scanline] && cache->signatures[scanline] == signature)
+    {
+        ++cache->hits;
+        return;
+    }
+
+    render_scanline(v, scanline);
+
+    cache->signatures[scanline] = signature;
+    cache->valid[scanline] = true;
+    ++cache->misses;
+}
+
 void vdp_draw_scanline(Vdp* v, int scanline)
 {
     uint16_t output_width, output_height;
     vdp_get_resolution(v, &output_width, &output_height);
 
-    if (v->display_enabled && scanline < output_height)
-        render_scanline(v, scanline);
+    if (scanline == 0)
+    {
+        begin_frame(v);
+
+        if (v->parallel != NULL && v->frameskip.rendering)
+            parallel_renderer_begin_frame(v->parallel);
+    }
+
+    // Skipped frames only bypass the pixel work,
+    // counters and interrupts are handled below as usual
+    bool draw = v->display_enabled && v->frameskip.rendering && scanline < output_height;
+
+    // In parallel mode, the whole frame is drawn at once after the last visible line
+    if (v->parallel != NULL)
+    {
+        if (scanline < output_height)
+            parallel_renderer_line(v->parallel, scanline, draw);
+        else
+            parallel_renderer_end_frame(v->parallel);
+    }
+    // In pipelined mode, the lines are drawn by the render thread
+    else if (v->pipeline != NULL)
+    {
+        if (draw)
+            render_pipeline_draw_line(v->pipeline, scanline);
+        else if (scanline == output_height)
+            render_pipeline_end_frame(v->pipeline);
+    }
+    else if (draw)
+        draw_line(v, scanline);
+
+    if (scanline == output_height)
+        end_frame(v);
 
     /*
      * Handle horizontal interrupts
@@ -1080,6 +1430,9 @@ void vdp_draw_screen(Vdp* v)
     uint16_t output_width, output_height;
     vdp_get_resolution(v, &output_width, &output_height);
 
+    // The signatures would not match the redrawn lines anymore
+    vdp_invalidate_line_cache(v);
+
     if (v->display_enabled)
         for (int line = 0; line <= output_height; ++line)
             render_scanline(v, line);
@@ -25,6 +25,10 @@
 #define BUFFER_HEIGHT 240
 #define BUFFER_SIZE (BUFFER_WIDTH * BUFFER_HEIGHT * 3)
 
+// Pixels of the index buffer: the CRAM entry, and the Shadow/Highlight effect applied to it
+#define INDEX_SHADOW 0x40
+#define INDEX_HIGHLIGHT 0x80
+
 struct Genesis;
 
 typedef enum Planes
@@ -55,6 +59,87 @@ typedef struct
     uint8_t b;
 } Color;
 
+// Color & priority data of a single layer on a scanline
+typedef struct
+{
+    bool drawn[BUFFER_WIDTH];
+    uint8_t colors[BUFFER_WIDTH]; // color indices
+    bool priorities[BUFFER_WIDTH];
+} ScanlineData;
+
+// Working buffers for drawing a scanline
+typedef struct ScanlineBuffers
+{
+    ScanlineData plane_a;
+    ScanlineData plane_b;
+    ScanlineData window;
+    ScanlineData sprites;
+} ScanlineBuffers;
+
+typedef enum
+{
+    FrameSkipMode_Interval, // Render one frame out of `interval`
+    FrameSkipMode_OnDemand  // Only render the frames requested via vdp_request_frame
+} FrameSkipModes;
+
+// Frame skipping policy
+//
+// Skipped frames go through the same timing, interrupt and status flags
+// logic as rendered frames, only the pixel work is left out (the output
+// buffer keeps the last rendered frame).
+typedef struct FrameSkip
+{
+    FrameSkipModes mode;
+    uint8_t interval; // 1 renders every frame
+    uint8_t counter;
+    bool requested;
+
+    // Whether the current frame is being drawn
+    bool rendering;
+
+    // Completed frames, counted once the beam leaves the last visible line
+    uint64_t rendered_frames;
+    uint64_t skipped_frames;
+} FrameSkip;
+
+typedef enum
+{
+    VdpLogEntry_Vram,
+    VdpLogEntry_Cram,
+    VdpLogEntry_Vsram,
+    VdpLogEntry_Register
+} VdpLogEntryTypes;
+
+// A VDP state change that matters for rendering, as logged for the threaded renderers
+typedef struct
+{
+    uint8_t type;
+    uint16_t line; // First line the change applies to
+    uint16_t address; // VRAM address, CRAM/VSRAM index or register number
+    uint16_t value;
+} VdpLogEntry;
+
+// Incremental rendering
+//
+// Each drawn line gets a signature built from everything it reads: scrolling,
+// nametable entries, sprites and the write generations of the patterns and
+// palettes involved. A line whose signature did not change since it was last
+// drawn is left untouched in the output buffer.
+typedef struct LineCache
+{
+    bool enabled;
+
+    // Bumped on each write to a VRAM pattern (32 bytes) / a CRAM palette
+    uint32_t pattern_generations[0x800];
+    uint32_t palette_generations[4];
+
+    uint64_t signatures[BUFFER_HEIGHT];
+    bool valid[BUFFER_HEIGHT];
+
+    uint64_t hits;
+    uint64_t misses;
+} LineCache;
+
 typedef struct Vdp
 { // TODO check types
     struct Genesis* genesis;
@@ -163,6 +248,19 @@ typedef struct Vdp
 
     // Video output
     uint8_t* output_buffer;
+    uint8_t* index_buffer; // One byte per pixel, only when recorded (see vdp_record_indices)
+
+    // Working buffers of the serial renderer
+    ScanlineBuffers* scanline_buffers;
+
+    FrameSkip frameskip;
+    LineCache* line_cache;
+
+    // Set when the frames are drawn in parallel (see parallel_renderer.h)
+    struct ParallelRenderer* parallel;
+
+    // Set when the frames are drawn on a render thread (see render_pipeline.h)
+    struct RenderPipeline* pipeline;
 } Vdp;
 
 Vdp* vdp_make(struct Genesis* cpu);
@@ -180,13 +278,33 @@ void vdp_write_data(Vdp*, uint16_t value); // TODO 8bit writes OK but only 16bit
 
 uint16_t vdp_read_control(Vdp*);
 void vdp_write_control(Vdp*, uint16_t value);
+void vdp_set_register(Vdp*, uint8_t reg, uint8_t value);
+void vdp_apply_log_entry(Vdp*, VdpLogEntry*); // Replay a logged change on another copy of the VDP
 
 uint16_t vdp_get_hv_counter(Vdp*); // Get the current value of the HV counter
 void vdp_get_resolution(Vdp*, uint16_t* width, uint16_t* height);
+void vdp_get_plane_layout(Vdp*, Planes plane, uint32_t* nametable, uint16_t* width, uint16_t* height); // Size in cells
 void vdp_get_plane_cell_data(Vdp* v, Planes plane, uint16_t cell_index, uint16_t* pattern_index, uint16_t* palette, bool* priority, bool* horizontal_flip, bool* vertical_flip);
 
+// Ask for the next frame to be rendered when using FrameSkipMode_OnDemand
+void vdp_request_frame(Vdp*);
+
+// Force every line to be redrawn (e.g. after the VDP state was replaced)
+void vdp_invalidate_line_cache(Vdp*);
+
+// Draw frames serially (1) or in parallel on a pool of worker threads
+void vdp_set_render_threads(Vdp*, int threads);
+
+// Draw frames on a render thread running about one frame behind
+void vdp_set_pipelined_rendering(Vdp*, bool enabled);
+
+// Also record the palette index of the drawn pixels, in the index buffer
+// (not when the frames are drawn on a render thread)
+void vdp_record_indices(Vdp*, bool enabled);
+
 void vdp_draw_screen(Vdp*);
 void vdp_draw_scanline(Vdp*, int scanline);
+void vdp_render_scanline(Vdp*, int scanline, ScanlineBuffers*); // Draw a scanline to the output buffer
 void vdp_draw_pattern(Vdp*, uint16_t pattern_index, Color* palette, uint8_t* buffer, uint32_t buffer_width, uint32_t x, uint32_t y, bool horizontal_flip, bool vertical_flip);
 void vdp_draw_plane(Vdp*, Planes plane, uint8_t* buffer, uint32_t buffer_width);
 void vdp_draw_sprites(Vdp*, uint8_t* buffer, uint32_t buffer_width);
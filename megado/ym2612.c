@@ -1,4 +1,3 @@
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,18 +23,20 @@
 
 // The YM2612 divides the master clock by 7
 // Then, the FM clock divides the YM2612 clock by 144
-static const uint32_t MASTER_CYCLES_PER_FM_CLOCK = 1008; // 144 * 7
+static const uint32_t MASTER_CYCLES_PER_FM_CLOCK = YM2612_MASTER_CYCLES_PER_SAMPLE;
 
 // The envelope clock divides the FM clock by 3
 static const uint16_t MASTER_CYCLES_PER_ENVELOPE_CLOCK = 336; // 1008 / 3
 
 // Local functions
 
-static void channel_clock(Channel*);
-static int16_t channel_output(Channel*);
+static int16_t channel_output(Channel*, const uint32_t* phase_counters, const uint16_t* levels);
 static uint8_t channel_key_code(Channel*);
 static void envelope_clock(YM2612*);
-static uint8_t operator_rate(Operator*, Channel*);
+static uint8_t operator_rate(YM2612*, uint8_t index);
+static void operator_set_adsr(YM2612*, uint8_t index, ADSR);
+static void operator_update_cache(YM2612*, uint8_t index);
+static void channel_update_cache(YM2612*, uint8_t channel);
 
 // Global functions
 
@@ -56,18 +57,27 @@ void ym2612_initialize(YM2612* y) {
     y->genesis = g;
 }
 
-static void ym2612_clock(YM2612* y) {
+void ym2612_update_cache(YM2612* y) {
     for (int i=0; i < 6; ++i) {
-        channel_clock(&y->channels[i]);
+        channel_update_cache(y, i);
+    }
+}
+
+// The phase counters only move by their increment on each FM clock,
+// all the clocks of a run are applied at once
+static void advance_phases(OperatorState* s, uint32_t clocks) {
+    for (int i=0; i < YM2612_OPERATORS; ++i) {
+        s->phase_counter[i] = (s->phase_counter[i] + s->phase_increment[i] * clocks) & 0xfffff;
     }
 }
 
 void ym2612_run_cycles(YM2612* y, uint32_t cycles) {
     y->remaining_master_cycles += cycles;
 
-    while (y->remaining_master_cycles > 0) {
-        ym2612_clock(y);
-        y->remaining_master_cycles -= MASTER_CYCLES_PER_FM_CLOCK;
+    if (y->remaining_master_cycles > 0) {
+        uint32_t clocks = (y->remaining_master_cycles + MASTER_CYCLES_PER_FM_CLOCK - 1) / MASTER_CYCLES_PER_FM_CLOCK;
+        advance_phases(&y->operator_state, clocks);
+        y->remaining_master_cycles -= clocks * MASTER_CYCLES_PER_FM_CLOCK;
     }
 
     y->envelope_remaining_master_cycles += cycles;
@@ -78,17 +88,27 @@ void ym2612_run_cycles(YM2612* y, uint32_t cycles) {
 }
 
 int16_t ym2612_mix(YM2612* y) {
+    OperatorState* s = &y->operator_state;
+
+    // Envelope and total level of all the operators,
+    // in the log domain (4.8 fixed point) to be added to the log-sine
+    uint16_t levels[YM2612_OPERATORS];
+    for (int i=0; i < YM2612_OPERATORS; ++i) {
+        uint16_t attenuation = s->attenuation[i] ^ (uint16_t)-s->polarity[i];
+        levels[i] = ((attenuation + s->total_level[i]) & 0x3ff) << 2;
+    }
+
     int32_t sample = 0;
 
     for (int i=0; i < 5; ++i) {
-        sample += channel_output(&y->channels[i]);
+        sample += channel_output(&y->channels[i], s->phase_counter + i * 4, levels + i * 4);
     }
 
     // If the DAC is enabled, the DAC data is output instead of channel 6
     if (y->dac_enabled) {
         sample += y->dac_data << 8; // bump to 16bit
     } else {
-        sample += channel_output(&y->channels[5]);
+        sample += channel_output(&y->channels[5], s->phase_counter + 5 * 4, levels + 5 * 4);
     }
 
     sample /= 6;
@@ -96,6 +116,14 @@ int16_t ym2612_mix(YM2612* y) {
     return sample;
 }
 
+// Output `count` samples at the FM clock rate
+void ym2612_render(YM2612* y, int16_t* out, uint32_t count) {
+    for (uint32_t i=0; i < count; ++i) {
+        ym2612_run_cycles(y, MASTER_CYCLES_PER_FM_CLOCK);
+        out[i] = ym2612_mix(y);
+    }
+}
+
 static const uint8_t counter_shift_table[64] = {
     11, 11, 11, 11, // 0-3    (0x00-0x03)
     10, 10, 10, 10, // 4-7    (0x04-0x07)
@@ -134,69 +162,71 @@ static const uint8_t attenuation_increment_table[64][8] = {
     {8,8,8,8,8,8,8,8}, {8,8,8,8,8,8,8,8}, {8,8,8,8,8,8,8,8}, {8,8,8,8,8,8,8,8}, // 60-63  (0x3C-0x3F)
 };
 
-void operator_set_adsr(Operator* op, ADSR phase, Channel* channel) {
-    op->adsr_phase = phase;
+static void operator_set_adsr(YM2612* y, uint8_t index, ADSR phase) {
+    y->operator_state.adsr_phase[index] = phase;
+    y->operator_state.rate[index] = operator_rate(y, index);
 }
 
 static void envelope_clock(YM2612* y) {
     y->envelope_counter++;
 
-    for (int i=0; i < 6; ++i) {
-        Channel* channel = &y->channels[i];
-        for (int j=0; j < 4; ++j) {
-            Operator* op = &channel->operators[j];
-            uint8_t rate = operator_rate(op, channel);
-            uint8_t counter_shift_value = counter_shift_table[rate];
-
-            if ((y->envelope_counter % (1 << counter_shift_value)) == 0) {
-                uint8_t update_cycle = (y->envelope_counter >> counter_shift_value) & 0x7;
-                uint8_t attenuation_increment = attenuation_increment_table[rate][update_cycle];
-                uint16_t new_attenuation = op->attenuation;
-
-                switch (op->adsr_phase) {
-
-                case ATTACK: {
-                    if (op->attenuation == 0) {
-                        operator_set_adsr(op, DECAY, channel);
-                    }
-
-                    if (rate < 62) {
-                        new_attenuation += (~op->attenuation * attenuation_increment) >> 4;
-                    }
-                } break;
-
-                case DECAY: {
-                    uint16_t sustain_as_attenuation = op->sustain_level == 0xf ?
-                        0x1f << 5 : op->sustain_level << 5;
-
-                    if (op->attenuation >= sustain_as_attenuation) {
-                        operator_set_adsr(op, SUSTAIN, channel);
-                    }
-
-                    new_attenuation += attenuation_increment;
-                } break;
-
-                case SUSTAIN:
-                case RELEASE:
-                    new_attenuation += attenuation_increment;
-                    break;
-                }
-
-                // Clamp attenuation to prevent overflow
-                if (new_attenuation > 0x3ff) {
-                    new_attenuation = 0x3ff;
-                }
-
-                op->attenuation = new_attenuation;
+    OperatorState* s = &y->operator_state;
+
+    for (int i=0; i < YM2612_OPERATORS; ++i) {
+        uint8_t rate = s->rate[i];
+        uint8_t counter_shift_value = counter_shift_table[rate];
+
+        if ((y->envelope_counter % (1 << counter_shift_value)) != 0) {
+            continue;
+        }
+
+        uint8_t update_cycle = (y->envelope_counter >> counter_shift_value) & 0x7;
+        uint8_t attenuation_increment = attenuation_increment_table[rate][update_cycle];
+        uint16_t attenuation = s->attenuation[i];
+        uint16_t new_attenuation = attenuation;
+
+        switch (s->adsr_phase[i]) {
+
+        case ATTACK: {
+            if (attenuation == 0) {
+                operator_set_adsr(y, i, DECAY);
+            }
+
+            if (rate < 62) {
+                new_attenuation += (~attenuation * attenuation_increment) >> 4;
+            }
+        } break;
+
+        case DECAY: {
+            if (attenuation >= s->sustain_level[i]) {
+                operator_set_adsr(y, i, SUSTAIN);
             }
+
+            new_attenuation += attenuation_increment;
+        } break;
+
+        case SUSTAIN:
+        case RELEASE:
+            new_attenuation += attenuation_increment;
+            break;
+        }
+
+        // Clamp attenuation to prevent overflow
+        if (new_attenuation > 0x3ff) {
+            new_attenuation = 0x3ff;
         }
+
+        s->attenuation[i] = new_attenuation;
     }
 }
 
-static uint8_t operator_rate(Operator* op, Channel* c) {
+static uint8_t operator_rate(YM2612* y, uint8_t index) {
+    Channel* c = &y->channels[index / 4];
+    Operator* op = &c->operators[index % 4];
+
     // r is the rate for the current ADSR phase of the operator
     uint8_t r;
-    switch (op->adsr_phase) {
+    switch (y->operator_state.adsr_phase[index]) {
     case ATTACK  : r = op->attack_rate; break;
     case DECAY   : r = op->decay_rate; break;
     case SUSTAIN : r = op->sustain_rate; break;
@@ -266,139 +296,187 @@ static uint8_t channel_key_code(Channel* c) {
     return (c->frequency.block << 2) | (n4 << 1) | n3;
 }
 
-static void channel_clock(Channel* c) {
-    for (int i=0; i < 4; ++i) {
-        uint32_t phase_increment = c->frequency.freq;
+// Phase increments, envelope rates and levels only change with the registers,
+// they are computed on write rather than on every clock
+static void operator_update_cache(YM2612* y, uint8_t index) {
+    Channel* c = &y->channels[index / 4];
+    Operator* op = &c->operators[index % 4];
+    OperatorState* s = &y->operator_state;
 
-        // Shift by block
-        if (c->frequency.block > 1) {
-            phase_increment <<= c->frequency.block - 1;
-        } else if (c->frequency.block == 0) {
-            phase_increment >>= 1;
-        }
+    uint32_t phase_increment = c->frequency.freq;
 
-        uint8_t key_code = channel_key_code(c);
-        uint8_t detune_adjust = detune_table[key_code][c->operators[i].detune & 0x3];
+    // Shift by block
+    if (c->frequency.block > 1) {
+        phase_increment <<= c->frequency.block - 1;
+    } else if (c->frequency.block == 0) {
+        phase_increment >>= 1;
+    }
 
-        // MSB of detune is the sign bit
-        if (c->operators[i].detune & 0x4) {
-            phase_increment -= detune_adjust;
-        } else {
-            phase_increment += detune_adjust;
-        }
+    uint8_t key_code = channel_key_code(c);
+    uint8_t detune_adjust = detune_table[key_code][op->detune & 0x3];
 
-        // Multiply by multiple
-        if (c->operators[i].multiple > 0) {
-            phase_increment *= c->operators[i].multiple;
-        } else {
-            phase_increment >>= 1;
-        }
+    // MSB of detune is the sign bit
+    if (op->detune & 0x4) {
+        phase_increment -= detune_adjust;
+    } else {
+        phase_increment += detune_adjust;
+    }
+
+    // Multiply by multiple
+    if (op->multiple > 0) {
+        phase_increment *= op->multiple;
+    } else {
+        phase_increment >>= 1;
+    }
+
+    s->phase_increment[index] = phase_increment;
+    s->rate[index] = operator_rate(y, index);
+    s->total_level[index] = op->total_level << 3;
+    s->sustain_level[index] = op->sustain_level == 0xf ? 0x1f << 5 : op->sustain_level << 5;
+}
 
-        c->operators[i].phase_counter += phase_increment;
+static void channel_update_cache(YM2612* y, uint8_t channel) {
+    for (int i=0; i < 4; ++i) {
+        operator_update_cache(y, channel * 4 + i);
     }
 }
 
-#define TAU 6.283185307178586
+// The chip computes sine waves and attenuation in the log domain with two
+// ROMs, the result is converted back to a linear value at the very end
+
+// First quarter of a sine wave, -log2(sin(x)) in 4.8 fixed point
+static const uint16_t log_sin_table[256] = {
+    2137, 1731, 1543, 1419, 1326, 1252, 1190, 1137, 1091, 1050, 1013,  979,  949,  920,  894,  869,
+     846,  825,  804,  785,  767,  749,  732,  717,  701,  687,  672,  659,  646,  633,  621,  609,
+     598,  587,  576,  566,  556,  546,  536,  527,  518,  509,  501,  492,  484,  476,  468,  461,
+     453,  446,  439,  432,  425,  418,  411,  405,  399,  392,  386,  380,  375,  369,  363,  358,
+     352,  347,  341,  336,  331,  326,  321,  316,  311,  307,  302,  297,  293,  289,  284,  280,
+     276,  271,  267,  263,  259,  255,  251,  248,  244,  240,  236,  233,  229,  226,  222,  219,
+     215,  212,  209,  205,  202,  199,  196,  193,  190,  187,  184,  181,  178,  175,  172,  169,
+     167,  164,  161,  159,  156,  153,  151,  148,  146,  143,  141,  138,  136,  134,  131,  129,
+     127,  125,  122,  120,  118,  116,  114,  112,  110,  108,  106,  104,  102,  100,   98,   96,
+      94,   92,   91,   89,   87,   85,   83,   82,   80,   78,   77,   75,   74,   72,   70,   69,
+      67,   66,   64,   63,   62,   60,   59,   57,   56,   55,   53,   52,   51,   49,   48,   47,
+      46,   45,   43,   42,   41,   40,   39,   38,   37,   36,   35,   34,   33,   32,   31,   30,
+      29,   28,   27,   26,   25,   24,   23,   23,   22,   21,   20,   20,   19,   18,   17,   17,
+      16,   15,   15,   14,   13,   13,   12,   12,   11,   10,   10,    9,    9,    8,    8,    7,
+       7,    7,    6,    6,    5,    5,    5,    4,    4,    4,    3,    3,    3,    2,    2,    2,
+       2,    1,    1,    1,    1,    1,    1,    1,    0,    0,    0,    0,    0,    0,    0,    0,
+};
+
+// Fractional part of 2^x, x in 1/256 steps, 10 bits: (2^(i/256) - 1) * 1024
+static const uint16_t exp_table[256] = {
+       0,    3,    6,    8,   11,   14,   17,   20,   22,   25,   28,   31,   34,   37,   40,   42,
+      45,   48,   51,   54,   57,   60,   63,   66,   69,   72,   75,   78,   81,   84,   87,   90,
+      93,   96,   99,  102,  105,  108,  111,  114,  117,  120,  123,  126,  130,  133,  136,  139,
+     142,  145,  148,  152,  155,  158,  161,  164,  168,  171,  174,  177,  181,  184,  187,  190,
+     194,  197,  200,  204,  207,  210,  214,  217,  220,  224,  227,  231,  234,  237,  241,  244,
+     248,  251,  255,  258,  262,  265,  268,  272,  276,  279,  283,  286,  290,  293,  297,  300,
+     304,  308,  311,  315,  318,  322,  326,  329,  333,  337,  340,  344,  348,  352,  355,  359,
+     363,  367,  370,  374,  378,  382,  385,  389,  393,  397,  401,  405,  409,  412,  416,  420,
+     424,  428,  432,  436,  440,  444,  448,  452,  456,  460,  464,  468,  472,  476,  480,  484,
+     488,  492,  496,  501,  505,  509,  513,  517,  521,  526,  530,  534,  538,  542,  547,  551,
+     555,  560,  564,  568,  572,  577,  581,  585,  590,  594,  599,  603,  607,  612,  616,  621,
+     625,  630,  634,  639,  643,  648,  652,  657,  661,  666,  670,  675,  680,  684,  689,  693,
+     698,  703,  708,  712,  717,  722,  726,  731,  736,  741,  745,  750,  755,  760,  765,  770,
+     774,  779,  784,  789,  794,  799,  804,  809,  814,  819,  824,  829,  834,  839,  844,  849,
+     854,  859,  864,  869,  874,  880,  885,  890,  895,  900,  906,  911,  916,  921,  927,  932,
+     937,  942,  948,  953,  959,  964,  969,  975,  980,  986,  991,  996, 1002, 1007, 1013, 1018,
+};
 
-static int16_t operator_output(Operator* o, int16_t operator_input) {
+static int16_t operator_output(uint32_t phase_counter, uint16_t level, int16_t operator_input) {
     // Convert input to 10bit modulation value
     uint16_t phase_modulation = ((uint16_t)operator_input >> 1) & 0x3ff;
 
     // Phase generator input is upper 10bit of the phase counter
-    uint16_t phase_input = o->phase_counter >> 10;
+    uint16_t phase_input = phase_counter >> 10;
 
-    // Compute sine from phase (with overflow, clamp to 10bit)
+    // Phase with overflow, clamp to 10bit
     uint16_t phase = (phase_input + phase_modulation) & 0x3ff;
-    double phase_normalized = (double)phase / 0x3ff;
-    double sin_result = sin(phase_normalized * TAU);
-
-    // Get attenuation from envelope generator
-    uint16_t attenuation = o->polarity ? ~o->attenuation : o->attenuation;
-    attenuation = (attenuation + (o->total_level << 3)) & 0x3ff;
-
-    // Convert to Bels
-    double attenuation_weighting = 48.0 / (1 << 10);
-    double attenuation_in_bels = ((double)attenuation * attenuation_weighting) / 10.0;
-    double power_linear = pow(10.0, -attenuation_in_bels);
-    // FIXME: envelope is not quite ready
-    //power_linear = 1;
-
-    // Combine sine and attenuation
-    double result_normalized = sin_result * power_linear;
-
-    // Convert to 14bit operator output
-    int16_t max = (1 << (14 - 1)) - 1;
-    return result_normalized * max;
+
+    // The table only holds a quarter wave:
+    // it is mirrored on the second quarter of each half (bit 8)
+    // and the second half is negated (bit 9)
+    uint8_t quarter_phase = phase & 0x100 ? ~phase & 0xff : phase & 0xff;
+    level += log_sin_table[quarter_phase];
+
+    // Back to linear, 13bit magnitude: the fractional part of the level
+    // goes through the exponent table and the integral part is a right shift
+    int16_t magnitude = ((exp_table[~level & 0xff] | 0x400) << 2) >> (level >> 8);
+
+    // 14bit operator output
+    return phase & 0x200 ? -magnitude : magnitude;
 }
 
-static int16_t channel_output(Channel* c) {
-    // FIXME: use something faster than sin()
+// Output of the n-th operator of the channel
+#define OP(n, input) operator_output(phase_counters[n], levels[n], input)
+
+static int16_t channel_output(Channel* c, const uint32_t* phase_counters, const uint16_t* levels) {
     if (c->enabled && !c->muted) {
         int16_t output = 0;
-        Operator* ops = c->operators;
 
         switch (c->algorithm) {
         case 0: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], s1);
-            int16_t s3 = operator_output(&ops[2], s2);
-            int16_t s4 = operator_output(&ops[3], s3);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, s1);
+            int16_t s3 = OP(2, s2);
+            int16_t s4 = OP(3, s3);
             output = s4;
         } break;
 
         case 1: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], 0);
-            int16_t s3 = operator_output(&ops[2], s1 + s2);
-            int16_t s4 = operator_output(&ops[3], s3);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, 0);
+            int16_t s3 = OP(2, s1 + s2);
+            int16_t s4 = OP(3, s3);
             output = s4;
         } break;
 
         case 2: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], 0);
-            int16_t s3 = operator_output(&ops[2], s2);
-            int16_t s4 = operator_output(&ops[3], s1 + s3);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, 0);
+            int16_t s3 = OP(2, s2);
+            int16_t s4 = OP(3, s1 + s3);
             output = s4;
         } break;
 
         case 3: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], s1);
-            int16_t s3 = operator_output(&ops[2], 0);
-            int16_t s4 = operator_output(&ops[3], s2 + s3);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, s1);
+            int16_t s3 = OP(2, 0);
+            int16_t s4 = OP(3, s2 + s3);
             output = s4;
         } break;
 
         case 4: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], s1);
-            int16_t s3 = operator_output(&ops[2], 0);
-            int16_t s4 = operator_output(&ops[3], s3);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, s1);
+            int16_t s3 = OP(2, 0);
+            int16_t s4 = OP(3, s3);
             output = s2 + s4;
         } break;
 
         case 5: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], s1);
-            int16_t s3 = operator_output(&ops[2], s1);
-            int16_t s4 = operator_output(&ops[3], s1);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, s1);
+            int16_t s3 = OP(2, s1);
+            int16_t s4 = OP(3, s1);
             output = s2 + s3 + s4;
         } break;
 
         case 6: {
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], s1);
-            int16_t s3 = operator_output(&ops[2], 0);
-            int16_t s4 = operator_output(&ops[3], 0);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, s1);
+            int16_t s3 = OP(2, 0);
+            int16_t s4 = OP(3, 0);
             output = s2 + s3 + s4;
         } break;
 
         case 7:{
-            int16_t s1 = operator_output(&ops[0], 0);
-            int16_t s2 = operator_output(&ops[1], 0);
-            int16_t s3 = operator_output(&ops[2], 0);
-            int16_t s4 = operator_output(&ops[3], 0);
+            int16_t s1 = OP(0, 0);
+            int16_t s2 = OP(1, 0);
+            int16_t s3 = OP(2, 0);
+            int16_t s4 = OP(3, 0);
             output = s1 + s2 + s3 + s4;
         } break;
         }
@@ -409,6 +487,8 @@ static int16_t channel_output(Channel* c) {
     }
 }
 
+#undef OP
+
 float channel_frequency_in_hertz(Channel* c, uint32_t master_frequency) {
     float note;
 
@@ -433,22 +513,25 @@ uint8_t ym2612_read(YM2612* y, uint32_t address) {
   return 0x7;
 }
 
-void ym2612_key_on(Operator* op, Channel* channel) {
-    operator_set_adsr(op, ATTACK, channel);
-    op->attenuation = 0;
-    op->phase_counter = 0;
+void ym2612_key_on(YM2612* y, uint8_t channel, uint8_t op) {
+    uint8_t index = channel * 4 + op;
+    operator_set_adsr(y, index, ATTACK);
+    y->operator_state.attenuation[index] = 0;
+    y->operator_state.phase_counter[index] = 0;
 }
 
-void ym2612_key_off(Operator* op, Channel* channel) {
-    operator_set_adsr(op, RELEASE, channel);
+void ym2612_key_off(YM2612* y, uint8_t channel, uint8_t op) {
+    operator_set_adsr(y, channel * 4 + op, RELEASE);
 }
 
 void ym2612_write_register(YM2612* y, uint8_t address, uint8_t value, Part part) {
     Channel* channels = y->channels;
+    uint8_t first_channel = 0;
     Frequency* additional_freqs = y->channel3_additional_frequencies;
     if (part == PART_II) {
         // Write to channels 4, 5 and 6 instead
         channels = &y->channels[3];
+        first_channel = 3;
         additional_freqs = y->channel6_additional_frequencies;
     }
 
@@ -507,11 +590,10 @@ void ym2612_write_register(YM2612* y, uint8_t address, uint8_t value, Part part)
 
         // Update envelope on key on/off for individual operators
         for (int i=0; i < 4; ++i) {
-            Operator* op = &y->channels[channel].operators[i];
             if (BIT(operators, i)) {
-                ym2612_key_on(op, &y->channels[channel]);
+                ym2612_key_on(y, channel, i);
             } else {
-                ym2612_key_off(op, &y->channels[channel]);
+                ym2612_key_off(y, channel, i);
             }
         }
 
@@ -580,17 +662,21 @@ void ym2612_write_register(YM2612* y, uint8_t address, uint8_t value, Part part)
             // proprietary register, skipping
             break;
         }
+
+        operator_update_cache(y, (first_channel + chan) * 4 + op);
     } break;
 
     case 0xa0: case 0xa1: case 0xa2: {
         uint8_t chan = address & 3;
         channels[chan].frequency.freq = (channels[chan].frequency.freq & 0x700) | value;
+        channel_update_cache(y, first_channel + chan);
     } break;
 
     case 0xa4: case 0xa5: case 0xa6: {
         uint8_t chan = address & 3;
         channels[chan].frequency.block = value >> 3;
         channels[chan].frequency.freq  = (channels[chan].frequency.freq & 0x0ff) | (((uint16_t) value) << 8);
+        channel_update_cache(y, first_channel + chan);
     } break;
 
     case 0xa8: case 0xa9: case 0xaa: {
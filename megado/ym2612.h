@@ -7,6 +7,9 @@
 // http://md.squee.co/YM2612
 // http://www.smspower.org/maxim/Documents/YM2612
 
+// One output sample per FM clock: the master clock divided by 7, then by 144 (about 53kHz)
+#define YM2612_MASTER_CYCLES_PER_SAMPLE 1008
+
 typedef enum {
     ATTACK, DECAY, SUSTAIN, RELEASE
 } ADSR;
@@ -15,6 +18,8 @@ typedef enum {
     PART_I, PART_II
 } Part;
 
+// Operator registers, as written by the game
+// (the state updated on every clock is in OperatorState)
 typedef struct Operator {
     // Frequency
     uint8_t detune                       : 3;
@@ -31,17 +36,27 @@ typedef struct Operator {
     bool    amplitude_modulation_enabled : 1;
 
     // uint8_t ssg_eg                    : 4;  // proprietary register, skipping
+} Operator;
 
-    // Internal FM generator values
-    uint32_t phase_counter : 20;
+#define YM2612_OPERATORS 24 // 4 per channel, operator j of channel i at i * 4 + j
 
-    // Internal envelope values
-    ADSR     adsr_phase;
-    uint16_t attenuation   : 10;
+// Internal state of all the operators, one array per field
+// so that the loops over the operators can be vectorized
+typedef struct OperatorState {
+    // FM generator
+    uint32_t phase_counter[YM2612_OPERATORS]; // 20 bits
+    uint32_t phase_increment[YM2612_OPERATORS]; // Cached from the frequency, detune and multiple
+
+    // Envelope generator
+    uint16_t attenuation[YM2612_OPERATORS]; // 10 bits
+    uint16_t total_level[YM2612_OPERATORS]; // Cached, as an attenuation
+    uint16_t sustain_level[YM2612_OPERATORS]; // Cached, as an attenuation
+    uint8_t  adsr_phase[YM2612_OPERATORS]; // ADSR
+    uint8_t  rate[YM2612_OPERATORS]; // Cached rate of the current ADSR phase (0-63)
 
     // For input inversion; used the SSG-EG
-    bool polarity;
-} Operator;
+    uint8_t  polarity[YM2612_OPERATORS];
+} OperatorState;
 
 typedef struct Frequency {
     uint8_t  block     : 3;
@@ -84,6 +99,7 @@ typedef struct YM2612
     bool     dac_enabled         : 1;
 
     Channel channels[6];
+    OperatorState operator_state;
 
     // These are only used by channels 3 & 6, but it's easier to keep them in
     // the global struct:
@@ -96,14 +112,15 @@ YM2612* ym2612_make(struct Genesis*);
 void ym2612_free(YM2612*);
 
 void ym2612_initialize(YM2612*);
+void ym2612_update_cache(YM2612*); // After changing the registers without ym2612_write_register
 uint8_t ym2612_read(YM2612*, uint32_t address);
 void ym2612_write(YM2612*, uint32_t address, uint8_t value);
 void ym2612_write_register(YM2612*, uint8_t address, uint8_t value, Part);
 void ym2612_run_cycles(YM2612*, uint32_t);
 int16_t ym2612_mix(YM2612*);
-void ym2612_key_on(Operator*, Channel*);
-void ym2612_key_off(Operator*, Channel*);
+void ym2612_render(YM2612*, int16_t* out, uint32_t count);
+void ym2612_key_on(YM2612*, uint8_t channel, uint8_t op);
+void ym2612_key_off(YM2612*, uint8_t channel, uint8_t op);
 
 float channel_frequency_in_hertz(Channel*, uint32_t master_frequency);
 
-void operator_set_adsr(Operator*, ADSR, Channel*);
@@ -4,7 +4,7 @@
 
 #include "debugger.h"
 #include "genesis.h"
-#include "psg.h"
+#include "sound.h"
 #include "ym2612.h"
 #include "z80.h"
 #include "z80_ops.h"
@@ -147,8 +147,12 @@ void z80_run_cycles(Z80* z, uint32_t cycles) {
     z->remaining_master_cycles += cycles;
 
     while (z->remaining_master_cycles > 0) {
+        // The first instruction may have started in the previous slice
+        z->slice_cycles = (int32_t)cycles - z->remaining_master_cycles;
         z->remaining_master_cycles -= z80_step(z) * MASTER_CYCLES_PER_CLOCK;
     }
+
+    z->slice_cycles = 0;
 }
 
 void z80_reset(Z80* z, uint8_t rst) {
@@ -223,13 +227,13 @@ void z80_write(Z80 *z, uint16_t address, uint8_t value) {
 
     // YM2612
     else if (address <= 0x4003) {
-        ym2612_write(z->genesis->ym2612, address, value);
+        sound_write(z->genesis->sound, genesis_slice_cycles(z->genesis), SoundChip_YM2612, address & 3, value);
     }
 
     // PSG access from Z80
     else if (address == 0x7f11) {
         printf("Z80 writes to PSG\n");
-        psg_write(z->genesis->psg, value);
+        sound_write(z->genesis->sound, genesis_slice_cycles(z->genesis), SoundChip_PSG, 0, value);
     }
 }
 
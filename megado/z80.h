@@ -9,6 +9,7 @@ typedef struct Z80 {
     struct Genesis* genesis;
 
     int32_t remaining_master_cycles;
+    uint32_t slice_cycles; // Master cycles run so far by z80_run_cycles, 0 outside of it
 
     // Registers
     struct {
@@ -0,0 +1,275 @@
+// Checks that a game still plays exactly as before, frame by frame.
+//
+// Usage: regression [-u] ROM MOVIE GOLDEN
+//        regression -r THREADS ROM MOVIE
+//
+// The movie is played back (see megado/movie.h) and the hashes of every frame
+// (see megado/frame_hash.h) are compared to the golden file. The first frame
+// that differs is reported with the parts of the state that differ. With -u,
+// the golden file is written instead, from the current version.
+//
+// With -r, the movie is played with each renderer instead: the hashes drawn
+// in parallel on THREADS threads, then on the render thread of the pipeline,
+// are compared to those drawn serially.
+//
+// Golden file: a comment line, then one line per frame with its number and
+// the hashes of each component, in hexadecimal.
+
+#include <SDL.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "megado/frame_hash.h"
+#include "megado/genesis.h"
+#include "megado/m68k/m68k.h"
+#include "megado/movie.h"
+#include "megado/render_pipeline.h"
+#include "megado/settings.h"
+#include "megado/vdp.h"
+
+typedef enum
+{
+    Renderer_Serial,
+    Renderer_Parallel,
+    Renderer_Pipelined
+} Renderers;
+
+static const char* const RENDERER_NAMES[] = { "serial", "parallel", "pipelined" };
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static bool write_golden(const char* path, FrameHash* hashes, uint32_t frames)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return false;
+    }
+
+    fprintf(file, "# frame");
+    for (int c = 0; c < FRAME_HASH_COMPONENTS; ++c)
+        fprintf(file, ", %s", frame_hash_component_name(c));
+    fprintf(file, "\n");
+
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        fprintf(file, "%" PRIu32, f);
+        for (int c = 0; c < FRAME_HASH_COMPONENTS; ++c)
+            fprintf(file, " %016" PRIx64, hashes[f].components[c]);
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+// Returns the number of frames read, -1 if the file cannot be read
+static int read_golden(const char* path, FrameHash* hashes, uint32_t max_frames)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        printf("Cannot open file \"%s\"\n", path);
+        return -1;
+    }
+
+    // Skip the comment line
+    int c;
+    while ((c = fgetc(file)) != '\n' && c != EOF);
+
+    uint32_t frames = 0, frame;
+    while (frames < max_frames && fscanf(file, "%" SCNu32, &frame) == 1)
+    {
+        for (int i = 0; i < FRAME_HASH_COMPONENTS; ++i)
+        {
+            if (fscanf(file, "%" SCNx64, &hashes[frames].components[i]) != 1)
+            {
+                printf("Frame %u of \"%s\" is incomplete\n", frame, path);
+                fclose(file);
+                return -1;
+            }
+        }
+
+        ++frames;
+    }
+
+    fclose(file);
+
+    return frames;
+}
+
+// Returns the number of frames played, -1 if the movie cannot be played.
+// The hashes are allocated for every frame of the movie.
+static int play(const char* rom, const char* movie, Renderers renderer, int threads, FrameHash** hashes, uint32_t* frames)
+{
+    Genesis* g = genesis_make_headless();
+    g->settings->rewinding_enabled = false; // Not needed to play the movie back
+    genesis_load_rom_file(g, rom);
+
+    if (renderer == Renderer_Parallel)
+        vdp_set_render_threads(g->vdp, threads);
+    else if (renderer == Renderer_Pipelined)
+        vdp_set_pipelined_rendering(g->vdp, true);
+
+    if (!movie_load(g->movie, movie) || !movie_play(g->movie, g))
+    {
+        genesis_free(g);
+        return -1;
+    }
+
+    *frames = g->movie->frame_count;
+    *hashes = calloc(*frames, sizeof(FrameHash));
+
+    double emulation_time = 0, hash_time = 0;
+    uint32_t played = 0;
+
+    for (; played < *frames && g->status == Status_Running; ++played)
+    {
+        double start = now();
+        genesis_run_frame(g);
+
+        // The render thread runs about a frame behind
+        if (renderer == Renderer_Pipelined)
+            render_pipeline_finish(g->vdp->pipeline);
+
+        double emulated = now();
+        frame_hash(g, &(*hashes)[played]);
+
+        emulation_time += emulated - start;
+        hash_time += now() - emulated;
+    }
+
+    printf("\n%s: %u frames, %.1f frames/s, hashing %.1fus per frame\n", RENDERER_NAMES[renderer],
+        played, played / emulation_time, hash_time / played * 1e6);
+
+    genesis_free(g);
+
+    return played;
+}
+
+// Reports the first frame that differs, only the first divergence matters,
+// the next frames follow from it
+static bool compare(FrameHash* hashes, FrameHash* expected, uint32_t frames)
+{
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        if (memcmp(&hashes[f], &expected[f], sizeof(FrameHash)) == 0)
+            continue;
+
+        printf("Frame %u diverges:", f);
+        for (int c = 0; c < FRAME_HASH_COMPONENTS; ++c)
+            if (hashes[f].components[c] != expected[f].components[c])
+                printf(" %s", frame_hash_component_name(c));
+        printf("\n");
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool check_golden(const char* golden, FrameHash* hashes, uint32_t frames)
+{
+    // One more, to tell a longer golden file
+    FrameHash* expected = calloc(frames + 1, sizeof(FrameHash));
+    int expected_frames = read_golden(golden, expected, frames + 1);
+    bool ok = expected_frames >= 0
+        && compare(hashes, expected, (uint32_t)expected_frames < frames ? (uint32_t)expected_frames : frames);
+
+    if (ok && (uint32_t)expected_frames != frames)
+    {
+        printf("The golden file has %d frames, the movie %u\n", expected_frames, frames);
+        ok = false;
+    }
+
+    free(expected);
+
+    return ok;
+}
+
+static bool check_renderers(const char* rom, const char* movie, int threads, FrameHash* serial, uint32_t frames)
+{
+    bool ok = true;
+
+    for (Renderers renderer = Renderer_Parallel; renderer <= Renderer_Pipelined; ++renderer)
+    {
+        FrameHash* hashes = NULL;
+        uint32_t renderer_frames;
+        int played = play(rom, movie, renderer, threads, &hashes, &renderer_frames);
+
+        bool same = played >= 0 && (uint32_t)played == frames && compare(hashes, serial, frames);
+        printf("%s %s\n", RENDERER_NAMES[renderer], same ? "matches serial" : "differs from serial");
+
+        ok = ok && same;
+        free(hashes);
+    }
+
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool update = false;
+    int threads = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ur:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'u': update = true; break;
+        case 'r': threads = atoi(optarg); break;
+        default:
+            return 1;
+        }
+    }
+
+    bool renderers = threads > 0;
+    if (argc - optind < (renderers ? 2 : 3) || (renderers && update))
+    {
+        printf("Usage: regression [-u] ROM MOVIE GOLDEN\n");
+        printf("       regression -r THREADS ROM MOVIE\n");
+        return 1;
+    }
+
+    const char* rom = argv[optind];
+    const char* movie = argv[optind + 1];
+    const char* golden = argv[optind + 2];
+
+    m68k_generate_opcode_table();
+
+    FrameHash* hashes = NULL;
+    uint32_t frames = 0;
+    int played = play(rom, movie, Renderer_Serial, 0, &hashes, &frames);
+
+    bool ok = played >= 0 && (uint32_t)played == frames;
+    if (played >= 0 && !ok)
+        printf("The emulation stopped at frame %d\n", played);
+
+    if (ok && renderers)
+        ok = check_renderers(rom, movie, threads, hashes, frames);
+    else if (ok && update)
+    {
+        ok = write_golden(golden, hashes, frames);
+        if (ok)
+            printf("Golden hashes written to \"%s\"\n", golden);
+    }
+    else if (ok)
+        ok = check_golden(golden, hashes, frames);
+
+    printf("%s\n", ok ? "OK" : "FAILED");
+
+    free(hashes);
+    m68k_free_opcode_table();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch regression (see ../tools.sh)
+
+exec ../tools.sh regression '[-u] ROM MOVIE GOLDEN | -r THREADS ROM MOVIE' "$@"
@@ -0,0 +1,177 @@
+// Measures how long it takes to save and load snapshots.
+//
+// Usage: snapshot-bench [SNAPSHOT]
+//
+// The state comes from the given snapshot file if any, otherwise it is made up
+// (half-empty memories with random data, like a game in progress).
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "megado/genesis.h"
+#include "megado/snapshot.h"
+#include "megado/vdp.h"
+#include "megado/z80.h"
+
+#define ITERATIONS 500
+
+typedef struct Timing
+{
+    double min, max, total;
+    int count;
+} Timing;
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static void timing_add(Timing* t, double start)
+{
+    double time = now() - start;
+
+    if (t->count == 0 || time < t->min)
+        t->min = time;
+    if (time > t->max)
+        t->max = time;
+
+    t->total += time;
+    ++t->count;
+}
+
+static void timing_print(const char* name, Timing* t)
+{
+    printf("%-28s avg %8.1fus  min %8.1fus  max %8.1fus\n",
+        name, t->total / t->count * 1e6, t->min * 1e6, t->max * 1e6);
+}
+
+static Genesis* make_genesis()
+{
+    Genesis* g = genesis_make_headless();
+
+    // 64KB of battery-backed RAM
+    g->sram_start = 0x200000;
+    g->sram_end = 0x210000;
+    g->sram = calloc(g->sram_end - g->sram_start, sizeof(uint8_t));
+
+    return g;
+}
+
+static void fill(uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        data[i] = (i / 256) % 2 ? rand() : 0;
+}
+
+static uint8_t* read_all(FILE* file, size_t* size)
+{
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = malloc(*size);
+    if (fread(data, 1, *size, file) != *size)
+    {
+        printf("Cannot read the snapshot back\n");
+        exit(1);
+    }
+
+    return data;
+}
+
+static void bench(Genesis* g, bool compress)
+{
+    printf("\n%s chunks\n", compress ? "Compressed" : "Uncompressed");
+
+    SnapshotMetadata metadata = { "BENCHMARK", 0, SNAPSHOT_VERSION };
+    Timing save = { 0 }, load_memory = { 0 }, load_stream = { 0 }, load_file = { 0 };
+
+    const char* path = "snapshot-bench.tmp";
+    size_t size = 0;
+
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        FILE* file = fopen(path, "wb");
+
+        double start = now();
+        bool ok = snapshot_write(g, file, &metadata, compress);
+        fflush(file);
+        timing_add(&save, start);
+
+        fclose(file);
+
+        if (!ok)
+        {
+            printf("Cannot write the snapshot\n");
+            exit(1);
+        }
+    }
+
+    FILE* file = fopen(path, "rb");
+    uint8_t* data = read_all(file, &size);
+
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        double start = now();
+        snapshot_read(g, data, size);
+        timing_add(&load_memory, start);
+
+        fseek(file, 0, SEEK_SET);
+        start = now();
+        snapshot_read_stream(g, file);
+        timing_add(&load_stream, start);
+
+        start = now();
+        snapshot_read_file(g, path);
+        timing_add(&load_file, start);
+    }
+
+    fclose(file);
+    free(data);
+    remove(path);
+
+    printf("Size: %zu bytes\n", size);
+    timing_print("Save (to file)", &save);
+    timing_print("Load (from memory)", &load_memory);
+    timing_print("Load (from stream)", &load_stream);
+    timing_print("Load (mapped file)", &load_file);
+}
+
+int main(int argc, char** argv)
+{
+    Genesis* g = make_genesis();
+
+    if (argc > 1)
+    {
+        if (!snapshot_read_file(g, argv[1]))
+            return 1;
+    }
+    else
+    {
+        fill(g->ram, 0x10000);
+        fill(g->vdp->vram, 0x10000);
+        fill(g->z80->ram, Z80_RAM_LENGTH);
+        fill(g->sram, g->sram_end - g->sram_start);
+    }
+
+    // Reference: a raw copy of the structures in memory
+    Timing capture = { 0 };
+    Snapshot* snapshot = calloc(1, sizeof(Snapshot));
+    for (int i = 0; i < ITERATIONS; ++i)
+    {
+        double start = now();
+        snapshot_capture(g, snapshot);
+        timing_add(&capture, start);
+    }
+    free(snapshot);
+
+    printf("%d iterations\n\n", ITERATIONS);
+    timing_print("Capture (in memory)", &capture);
+
+    bench(g, false);
+    bench(g, true);
+
+    return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch snapshot-bench (see ../tools.sh)
+
+exec ../tools.sh snapshot-bench '[SNAPSHOT]' "$@"
@@ -0,0 +1,379 @@
+// Compares the sound output of the chips sampled at the host rate (each sample
+// is the chip output at that time) with their band-limited output (the PSG
+// output changes synthesized as band-limited steps, the YM2612 rendered at its
+// own rate and resampled).
+//
+// Also compares a stream of DAC samples written with the time they are written
+// at in the slice emulated with the same stream written at the start of it, as
+// a DAC sample rate faster than the line rate loses samples then.
+//
+// Usage: sound-bench [SECONDS]
+//
+// Quality is the level of the aliases: the spectrum content that is not a
+// harmonic of the tone played, in the audible band. Cost is the time taken to
+// render SECONDS of audio with all the channels playing.
+
+#include <SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "megado/psg.h"
+#include "megado/sound.h"
+#include "megado/ym2612.h"
+
+#define SAMPLE_RATE 44100
+#define MASTER_FREQUENCY 53693175
+#define MASTER_CYCLES_PER_LINE 3420
+#define LINES_PER_FRAME 262
+#define SPECTRUM_LENGTH 65536
+#define DEFAULT_SECONDS 20
+
+// Frequencies counted in the audible band
+#define AUDIBLE_START 20.0
+#define AUDIBLE_LIMIT 18000.0
+
+typedef struct Chips
+{
+    PSG psg;
+    YM2612 ym2612;
+} Chips;
+
+typedef enum
+{
+    Method_PointSampled,
+    Method_BandLimited
+} Methods;
+
+static const char* method_names[] = { "point-sampled", "band-limited" };
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static void chips_initialize(Chips* c)
+{
+    psg_initialize(&c->psg);
+    ym2612_initialize(&c->ym2612);
+}
+
+static void ym_write(Chips* c, uint8_t address, uint8_t value, Part part)
+{
+    ym2612_write_register(&c->ym2612, address, value, part);
+}
+
+// A single sine operator on channel 1, at about 11kHz
+static void setup_fm_tone(Chips* c)
+{
+    ym_write(c, 0xb0, 0x07, PART_I); // All operators are carriers
+    ym_write(c, 0xb4, 0xc0, PART_I);
+
+    // Operator 1 at full volume, the others muted
+    static const uint8_t offsets[4] = { 0x0, 0x4, 0x8, 0xc };
+    for (int i = 0; i < 4; ++i)
+    {
+        ym_write(c, 0x30 + offsets[i], 0x02, PART_I);
+        ym_write(c, 0x40 + offsets[i], i == 0 ? 0x00 : 0x7f, PART_I);
+        ym_write(c, 0x50 + offsets[i], 0x1f, PART_I);
+        ym_write(c, 0x80 + offsets[i], 0x0f, PART_I);
+    }
+
+    uint16_t fnum = 1700;
+    ym_write(c, 0xa4, (7 << 3) | (fnum >> 8), PART_I);
+    ym_write(c, 0xa0, fnum & 0xff, PART_I);
+    ym_write(c, 0x28, 0xf0, PART_I);
+}
+
+// A square wave on the first PSG channel, at about 9.3kHz
+static void setup_psg_tone(Chips* c)
+{
+    uint16_t tone = 12;
+    psg_write(&c->psg, 0x80 | (tone & 0xf));
+    psg_write(&c->psg, tone >> 4);
+    psg_write(&c->psg, 0x90); // Full volume
+}
+
+// Everything playing, for the cost measurement
+static void setup_busy(Chips* c)
+{
+    for (int part = 0; part < 2; ++part)
+    {
+        for (int chan = 0; chan < 3; ++chan)
+        {
+            ym_write(c, 0xb0 + chan, (3 << 3) | 4, part);
+            ym_write(c, 0xb4 + chan, 0xc0, part);
+
+            for (int op = 0; op < 4; ++op)
+            {
+                ym_write(c, 0x30 + op * 4 + chan, 0x01 + op, part);
+                ym_write(c, 0x40 + op * 4 + chan, 0x10, part);
+                ym_write(c, 0x50 + op * 4 + chan, 0x1f, part);
+                ym_write(c, 0x60 + op * 4 + chan, 0x05, part);
+                ym_write(c, 0x80 + op * 4 + chan, 0x2f, part);
+            }
+
+            uint16_t fnum = 600 + 100 * (part * 3 + chan);
+            ym_write(c, 0xa4 + chan, (4 << 3) | (fnum >> 8), part);
+            ym_write(c, 0xa0 + chan, fnum & 0xff, part);
+        }
+    }
+
+    static const uint8_t channels[6] = { 0, 1, 2, 4, 5, 6 };
+    for (int i = 0; i < 6; ++i)
+        ym_write(c, 0x28, 0xf0 | channels[i], PART_I);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        uint16_t tone = 100 + 37 * i;
+        psg_write(&c->psg, 0x80 | (i << 5) | (tone & 0xf));
+        psg_write(&c->psg, tone >> 4);
+        psg_write(&c->psg, 0x90 | (i << 5));
+    }
+    psg_write(&c->psg, 0xe4); // White noise
+    psg_write(&c->psg, 0xf0);
+}
+
+// Render `count` stereo samples (PSG on the left, YM2612 on the right)
+static void render(Chips* c, Methods method, int16_t* out, uint32_t count)
+{
+    double cycles_per_sample = (double)MASTER_FREQUENCY / SAMPLE_RATE;
+
+    if (method == Method_PointSampled)
+    {
+        double remaining = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            remaining += cycles_per_sample;
+            uint32_t cycles = (uint32_t)remaining;
+            remaining -= cycles;
+
+            psg_run_cycles(&c->psg, cycles);
+            ym2612_run_cycles(&c->ym2612, cycles);
+            out[i * 2] = psg_mix(&c->psg);
+            out[i * 2 + 1] = ym2612_mix(&c->ym2612);
+        }
+    }
+    else
+    {
+        Sound* s = sound_make(&c->psg, &c->ym2612, cycles_per_sample);
+
+        uint32_t done = 0;
+        while (done < count)
+        {
+            // One video frame at a time, like the emulation
+            sound_advance(s, MASTER_FREQUENCY / 60);
+            sound_render(s);
+
+            uint32_t read;
+            while (done < count && (read = sound_read(s, out + done * 2, count - done)) > 0)
+                done += read;
+        }
+
+        sound_free(s);
+    }
+}
+
+static void fft(double* re, double* im, uint32_t n)
+{
+    for (uint32_t i = 1, j = 0; i < n; ++i)
+    {
+        uint32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if (i < j)
+        {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (uint32_t length = 2; length <= n; length <<= 1)
+    {
+        double angle = -2 * M_PI / length;
+        for (uint32_t i = 0; i < n; i += length)
+        {
+            for (uint32_t k = 0; k < length / 2; ++k)
+            {
+                double wr = cos(angle * k), wi = sin(angle * k);
+                double* a_re = &re[i + k], * a_im = &im[i + k];
+                double* b_re = &re[i + k + length / 2], * b_im = &im[i + k + length / 2];
+
+                double t_re = *b_re * wr - *b_im * wi;
+                double t_im = *b_re * wi + *b_im * wr;
+                *b_re = *a_re - t_re;
+                *b_im = *a_im - t_im;
+                *a_re += t_re;
+                *a_im += t_im;
+            }
+        }
+    }
+}
+
+// Level of the aliases relative to the tone, in dB
+static double alias_level(const int16_t* samples, int channel)
+{
+    static double re[SPECTRUM_LENGTH], im[SPECTRUM_LENGTH], power[SPECTRUM_LENGTH / 2];
+
+    // Skip the start, for the envelope to settle
+    const int16_t* start = samples + SPECTRUM_LENGTH * 2;
+    for (uint32_t i = 0; i < SPECTRUM_LENGTH; ++i)
+    {
+        // Blackman-Harris, for the leakage of the tone to stay under the aliases
+        double x = 2 * M_PI * i / SPECTRUM_LENGTH;
+        double window = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+        re[i] = start[i * 2 + channel] * window;
+        im[i] = 0;
+    }
+    fft(re, im, SPECTRUM_LENGTH);
+
+    // The PSG output is never negative, leave the DC out
+    double bin = (double)SAMPLE_RATE / SPECTRUM_LENGTH;
+    uint32_t first = (uint32_t)(AUDIBLE_START / bin);
+    uint32_t limit = (uint32_t)(AUDIBLE_LIMIT / bin);
+
+    uint32_t peak = first;
+    for (uint32_t i = first; i < limit; ++i)
+    {
+        power[i] = re[i] * re[i] + im[i] * im[i];
+        if (power[i] > power[peak])
+            peak = i;
+    }
+
+    // The tone and its harmonics, spread over a few bins by the window
+    double tone = 0, aliases = 0;
+
+    for (uint32_t i = first; i < limit; ++i)
+    {
+        double harmonic = (double)i / peak;
+        double distance = fabs(harmonic - round(harmonic)) * peak;
+
+        if (distance <= 5)
+            tone += power[i];
+        else
+            aliases += power[i];
+    }
+
+    return 10 * log10(aliases / tone);
+}
+
+static void quality(const char* name, void (*setup)(Chips*), int channel)
+{
+    uint32_t count = SPECTRUM_LENGTH * 2;
+    int16_t* samples = malloc(count * 2 * sizeof(int16_t));
+
+    printf("%s\n", name);
+    for (int method = 0; method < 2; ++method)
+    {
+        Chips* c = calloc(1, sizeof(Chips));
+        chips_initialize(c);
+        setup(c);
+
+        render(c, method, samples, count);
+        printf("  %-14s aliases at %6.1fdB\n", method_names[method], alias_level(samples, channel));
+
+        free(c);
+    }
+
+    free(samples);
+}
+
+// A sine wave at about 1kHz streamed to the DAC at 22kHz, one line at a time
+// like the emulation. The writes happen at their cycle in the line if `exact`,
+// at its start otherwise.
+static void dac_stream(bool exact, int16_t* out, uint32_t count)
+{
+    Chips* c = calloc(1, sizeof(Chips));
+    chips_initialize(c);
+    ym_write(c, 0xb6, 0xc0, PART_II);
+    ym_write(c, 0x2b, 0x80, PART_I);
+
+    Sound* s = sound_make(&c->psg, &c->ym2612, (double)MASTER_FREQUENCY / SAMPLE_RATE);
+
+    double dac_rate = 22050, frequency = 1000;
+    uint64_t line_start = 0, dac_sample = 0;
+    uint32_t done = 0;
+    while (done < count)
+    {
+        for (int line = 0; line < LINES_PER_FRAME; ++line)
+        {
+            uint64_t line_end = line_start + MASTER_CYCLES_PER_LINE;
+            for (uint64_t at; (at = dac_sample * MASTER_FREQUENCY / (uint64_t)dac_rate) < line_end; ++dac_sample)
+            {
+                uint32_t delay = exact ? (uint32_t)(at - line_start) : 0;
+                uint8_t value = (uint8_t)(128 + 100 * sin(2 * M_PI * frequency * dac_sample / dac_rate));
+                sound_write(s, delay, SoundChip_YM2612, 0, 0x2a);
+                sound_write(s, delay, SoundChip_YM2612, 1, value);
+            }
+
+            sound_advance(s, MASTER_CYCLES_PER_LINE);
+            line_start = line_end;
+        }
+        sound_render(s);
+
+        uint32_t read;
+        while (done < count && (read = sound_read(s, out + done * 2, count - done)) > 0)
+            done += read;
+    }
+
+    sound_free(s);
+    free(c);
+}
+
+static void dac_quality()
+{
+    uint32_t count = SPECTRUM_LENGTH * 2;
+    int16_t* samples = malloc(count * 2 * sizeof(int16_t));
+
+    printf("YM2612 DAC stream at 22kHz, sine wave at 1kHz\n");
+    static const char* names[] = { "line-stamped", "cycle-stamped" };
+    for (int exact = 0; exact < 2; ++exact)
+    {
+        dac_stream(exact, samples, count);
+        printf("  %-14s aliases at %6.1fdB\n", names[exact], alias_level(samples, 1));
+    }
+
+    free(samples);
+}
+
+static void cost(int seconds)
+{
+    uint32_t count = SAMPLE_RATE * seconds;
+    int16_t* samples = malloc(count * 2 * sizeof(int16_t));
+
+    printf("%d seconds with all the channels playing\n", seconds);
+    for (int method = 0; method < 2; ++method)
+    {
+        Chips* c = calloc(1, sizeof(Chips));
+        chips_initialize(c);
+        setup_busy(c);
+
+        double start = now();
+        render(c, method, samples, count);
+        double time = now() - start;
+
+        printf("  %-14s %7.1fms  %5.1fns per sample  x%.0f real time\n", method_names[method],
+            time * 1000, time * 1e9 / count, seconds / time);
+
+        free(c);
+    }
+
+    free(samples);
+}
+
+int main(int argc, char** argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+
+    quality("PSG square wave, 9.3kHz", setup_psg_tone, 0);
+    quality("YM2612 sine wave, 11kHz", setup_fm_tone, 1);
+    dac_quality();
+    printf("\n");
+    cost(seconds);
+
+    return 0;
+}
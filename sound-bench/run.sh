@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch sound-bench (see ../tools.sh)
+
+exec ../tools.sh sound-bench '[SECONDS]' "$@"
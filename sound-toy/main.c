@@ -1,10 +1,13 @@
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include <cimgui/cimgui.h>
 #include <GL/glew.h>
+#include <math.h>
 
 #include "../gym/sdl_imgui.h"
 #include "../gym/ui.h"
+#include "../megado/audio_ring.h"
 #include "../megado/psg.h"
+#include "../megado/sound.h"
 #include "../megado/ym2612.h"
 
 static const struct ImVec4 color_title = { 0.0f, 0.68f, 0.71f, 1.0f };
@@ -16,7 +19,9 @@ static const uint32_t SAMPLE_RATE = 44100;
 static float g_emulation_speed = 1.0f;
 static YM2612 g_ym2612;
 static PSG    g_psg;
+static Sound*  g_sound;
 static SDL_AudioDeviceID g_audio_device;
+static AudioRing* g_audio_ring;
 
 static double audio_remaining_time = 0;
 
@@ -27,10 +32,6 @@ void emulate_audio() {
   double dt = now - last_update;
   last_update = now;
 
-  // Schedule the end of this frame from the previous frame time
-  // (with some slack for overhead)
-  double max_time = now + dt - (dt / 10);
-
   // Emulate by slices of audio sample
   audio_remaining_time += dt;
   double time_slice = (double)1 / SAMPLE_RATE;
@@ -40,25 +41,26 @@ void emulate_audio() {
   // Convert the duration to master cycles
   double d_cycles = dt_genesis * NTSC_MASTER_FREQUENCY;
 
-  while (audio_remaining_time > 0) {
-    // Emulate enough for one audio sample
-    psg_run_cycles(&g_psg, d_cycles);
-    ym2612_run_cycles(&g_ym2612, d_cycles);
+  if (audio_remaining_time <= 0) {
+    return;
+  }
 
-    // Sample the audio units
-    // @Temporary: use left channel for PSG and right channel for YM2612
-    int16_t sample[2] = {psg_mix(&g_psg), ym2612_mix(&g_ym2612)};
+  // Render all the samples for this frame in one block
+  uint32_t samples = ceil(audio_remaining_time / time_slice);
+  if (samples > SOUND_BUFFER_LENGTH) {
+    samples = SOUND_BUFFER_LENGTH;
+  }
+  g_sound->cycles_per_sample = d_cycles;
+  sound_advance(g_sound, samples * d_cycles);
+  sound_render(g_sound);
+  audio_remaining_time -= samples * time_slice;
+
+  // @Temporary: use left channel for PSG and right channel for YM2612
+  int16_t buffer[SOUND_BLOCK_LENGTH * 2];
+  uint32_t count;
+  while ((count = sound_read(g_sound, buffer, SOUND_BLOCK_LENGTH)) > 0) {
     // Queue samples to audio device
-    if (g_audio_device > 0 && SDL_QueueAudio(g_audio_device, sample, 2 * sizeof(int16_t)) != 0) {
-      fprintf(stderr, "Failed to queue audio: %s", SDL_GetError());
-    }
-
-    audio_remaining_time -= time_slice;
-
-    // If we are taking longer than the allocated time, abort
-    if ((SDL_GetTicks() / 1000.0) > max_time) {
-      break;
-    }
+    audio_ring_write(g_audio_ring, buffer, count);
   }
 }
 
@@ -71,6 +73,8 @@ int main() {
   SDL_Window *window = init_ui();
 
   // Init SDL audio
+  g_audio_ring = audio_ring_make();
+
   SDL_AudioSpec want, have;
 
   SDL_memset(&want, 0, sizeof(want));
@@ -78,7 +82,8 @@ int main() {
   want.format = AUDIO_S16;
   want.channels = 2;
   want.samples = 512;
-  want.callback = NULL; // Use SDL_QueueAudio instead
+  want.callback = audio_ring_callback;
+  want.userdata = g_audio_ring;
 
   g_audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
 
@@ -91,6 +96,7 @@ int main() {
 
   psg_initialize(&g_psg);
   ym2612_initialize(&g_ym2612);
+  g_sound = sound_make(&g_psg, &g_ym2612, (double)NTSC_MASTER_FREQUENCY / SAMPLE_RATE);
 
   // Main loop
   bool done = false;
@@ -124,6 +130,12 @@ int main() {
       igText("PSG:    %d", g_psg.remaining_master_cycles);
       igText("YM2612: %d", g_ym2612.remaining_master_cycles);
 
+      igTextColored(color_title, "Audio ring");
+      igText("Fill:      %u/%u", audio_ring_fill(g_audio_ring), AUDIO_RING_LENGTH);
+      igText("Underruns: %d", SDL_AtomicGet(&g_audio_ring->underruns));
+      igText("Overruns:  %d (%d samples dropped)", SDL_AtomicGet(&g_audio_ring->overruns),
+             SDL_AtomicGet(&g_audio_ring->dropped_samples));
+
       igEnd();
     }
 
@@ -196,6 +208,7 @@ int main() {
       YM2612* y = &g_ym2612;
       int v;
       bool bv;
+      bool changed = false; // Registers changed by the sliders
 
       igColumns(7, NULL, false);
 
@@ -236,26 +249,26 @@ int main() {
         if (igSmallButton("Key on")) {
           y->channels[i].enabled = true;
           for (int j=0; j < 4; ++j) {
-            Operator* op = &y->channels[i].operators[j];
-            ym2612_key_on(op, &y->channels[i]);
+            ym2612_key_on(y, i, j);
           }
         }
 
         if (igSmallButton("Key off")) {
           for (int j=0; j < 4; ++j) {
-            Operator* op = &y->channels[i].operators[j];
-            ym2612_key_off(op, &y->channels[i]);
+            ym2612_key_off(y, i, j);
           }
         }
 
         v = y->channels[i].frequency.block;
         if (igSliderInt("##freq.block", &v, 0, 0x7, NULL)) {
           y->channels[i].frequency.block = v;
+          changed = true;
         }
 
         v = y->channels[i].frequency.freq;
         if (igSliderInt("##freq.number", &v, 0, 0x7FF, NULL)) {
           y->channels[i].frequency.freq = v;
+          changed = true;
         }
 
         igText("%.2fHz", channel_frequency_in_hertz(&y->channels[i], NTSC_MASTER_FREQUENCY));
@@ -263,6 +276,7 @@ int main() {
         v = y->channels[i].algorithm;
         if (igSliderInt("##algorithm", &v, 0, 0x7, NULL)) {
           y->channels[i].algorithm = v;
+          changed = true;
         }
 
         igNextColumn();
@@ -299,8 +313,8 @@ int main() {
             igTextColored(color_title, "%d", j + 1);
             Operator *op = &y->channels[i].operators[j];
 
-            igText("attenuation: %d", op->attenuation);
-            switch (op->adsr_phase) {
+            igText("attenuation: %d", y->operator_state.attenuation[i * 4 + j]);
+            switch (y->operator_state.adsr_phase[i * 4 + j]) {
             case ATTACK:  igText("attack"); break;
             case DECAY:   igText("decay"); break;
             case SUSTAIN: igText("sustain"); break;
@@ -310,51 +324,61 @@ int main() {
             v = op->detune;
             if (igSliderInt("##detune", &v, 0, 0x7, NULL)) {
               op->detune = v;
+              changed = true;
             }
 
             v = op->multiple;
             if (igSliderInt("##multiple", &v, 0, 0xF, NULL)) {
               op->multiple = v;
+              changed = true;
             }
 
             v = op->total_level;
             if (igSliderInt("##total_level", &v, 0, 0x7F, NULL)) {
               op->total_level = v;
+              changed = true;
             }
 
             v = op->attack_rate;
             if (igSliderInt("##attack_rate", &v, 0, 0x1F, NULL)) {
               op->attack_rate = v;
+              changed = true;
             }
 
             v = op->decay_rate;
             if (igSliderInt("##decay_rate", &v, 0, 0x1F, NULL)) {
               op->decay_rate = v;
+              changed = true;
             }
 
             v = op->sustain_level;
             if (igSliderInt("##sustain_level", &v, 0, 0xF, NULL)) {
               op->sustain_level = v;
+              changed = true;
             }
 
             v = op->sustain_rate;
             if (igSliderInt("##sustain_rate", &v, 0, 0x1F, NULL)) {
               op->sustain_rate = v;
+              changed = true;
             }
 
             v = op->release_rate;
             if (igSliderInt("##release_rate", &v, 0, 0xF, NULL)) {
               op->release_rate = v;
+              changed = true;
             }
 
             v = op->rate_scaling;
             if (igSliderInt("##rate_scaling", &v, 0, 0x3, NULL)) {
               op->rate_scaling = v;
+              changed = true;
             }
 
             bv = op->amplitude_modulation_enabled;
             if (igCheckbox("##amplitude_modulation_enabled", &bv)) {
               op->amplitude_modulation_enabled = bv;
+              changed = true;
             }
 
             igNextColumn();
@@ -366,6 +390,11 @@ int main() {
         igPopId();
       }
 
+      // The sliders bypass ym2612_write_register, the phase increments and
+      // envelope rates derived from the registers have to be recomputed
+      if (changed)
+        ym2612_update_cache(y);
+
       igEnd();
     }
 
@@ -373,6 +402,9 @@ int main() {
     SDL_GL_SwapWindow(window);
   }
 
+  SDL_CloseAudioDevice(g_audio_device);
+  audio_ring_free(g_audio_ring);
+  sound_free(g_sound);
   destroy_ui(window);
   SDL_Quit();
 
@@ -0,0 +1,170 @@
+// Runs many Genesis instances at the same time, one per thread, to check that
+// they do not interfere with each other.
+//
+// Usage: stress-test ROM [INSTANCES] [FRAMES] [MOVIE]
+//
+// A reference run is made first on the main thread, then all the instances run
+// the same game concurrently: their video output and memories must match the
+// reference at every frame. With a movie, the game is played with its inputs
+// instead of left to its attract mode.
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "megado/genesis.h"
+#include "megado/m68k/m68k.h"
+#include "megado/movie.h"
+#include "megado/serializer.h"
+#include "megado/settings.h"
+#include "megado/vdp.h"
+#include "megado/z80.h"
+
+#define DEFAULT_INSTANCES 32
+#define DEFAULT_FRAMES 600
+
+typedef struct Instance
+{
+    Genesis* genesis;
+    SDL_Thread* thread;
+
+    const uint32_t* reference; // Expected hashes, one per frame
+    uint32_t* hashes;
+    int frames;
+
+    int first_mismatch; // -1 if none
+} Instance;
+
+static double now()
+{
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+// Everything the game can see or show
+static uint32_t hash_frame(Genesis* g)
+{
+    uint32_t hashes[] = {
+        checksum(g->vdp->output_buffer, BUFFER_SIZE),
+        checksum(g->ram, 0x10000),
+        checksum(g->vdp->vram, 0x10000),
+        checksum(g->z80->ram, Z80_RAM_LENGTH)
+    };
+
+    return checksum((uint8_t*)hashes, sizeof(hashes));
+}
+
+static Genesis* make_instance(const char* rom, const char* movie)
+{
+    Genesis* g = genesis_make_headless();
+    g->settings->rewinding_enabled = false; // Would take a lot of memory with many instances
+    genesis_load_rom_file(g, rom);
+
+    if (movie != NULL && (!movie_load(g->movie, movie) || !movie_play(g->movie, g)))
+        exit(1);
+
+    return g;
+}
+
+static void run(Genesis* g, uint32_t* hashes, int frames)
+{
+    for (int f = 0; f < frames && g->status == Status_Running; ++f)
+    {
+        genesis_run_frame(g);
+        hashes[f] = hash_frame(g);
+    }
+}
+
+static int instance_thread(void* data)
+{
+    Instance* instance = data;
+
+    run(instance->genesis, instance->hashes, instance->frames);
+
+    instance->first_mismatch = -1;
+    for (int f = 0; f < instance->frames; ++f)
+        if (instance->hashes[f] != instance->reference[f])
+        {
+            instance->first_mismatch = f;
+            break;
+        }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: stress-test ROM [INSTANCES] [FRAMES] [MOVIE]\n");
+        return 1;
+    }
+
+    const char* rom = argv[1];
+    int instance_count = argc > 2 ? atoi(argv[2]) : DEFAULT_INSTANCES;
+    int frames = argc > 3 ? atoi(argv[3]) : DEFAULT_FRAMES;
+    const char* movie = argc > 4 ? argv[4] : NULL;
+
+    m68k_generate_opcode_table();
+
+    // Reference run, alone
+    uint32_t* reference = calloc(frames, sizeof(uint32_t));
+    Genesis* g = make_instance(rom, movie);
+
+    double start = now();
+    run(g, reference, frames);
+    double reference_time = now() - start;
+
+    genesis_free(g);
+
+    // All the instances at the same time
+    Instance* instances = calloc(instance_count, sizeof(Instance));
+    for (int i = 0; i < instance_count; ++i)
+    {
+        instances[i].genesis = make_instance(rom, movie);
+        instances[i].reference = reference;
+        instances[i].hashes = calloc(frames, sizeof(uint32_t));
+        instances[i].frames = frames;
+    }
+
+    start = now();
+
+    for (int i = 0; i < instance_count; ++i)
+    {
+        char name[32];
+        sprintf(name, "Genesis %d", i);
+        instances[i].thread = SDL_CreateThread(instance_thread, name, &instances[i]);
+    }
+
+    for (int i = 0; i < instance_count; ++i)
+        SDL_WaitThread(instances[i].thread, NULL);
+
+    double concurrent_time = now() - start;
+
+    // Report
+    int failures = 0;
+    for (int i = 0; i < instance_count; ++i)
+        if (instances[i].first_mismatch >= 0)
+        {
+            printf("Instance %d differs from the reference from frame %d\n", i, instances[i].first_mismatch);
+            ++failures;
+        }
+
+    printf("\n%d instances, %d frames each\n", instance_count, frames);
+    printf("Reference:  %8.1f frames/s\n", frames / reference_time);
+    printf("Concurrent: %8.1f frames/s (%.1f per instance)\n",
+        instance_count * frames / concurrent_time, frames / concurrent_time);
+    printf("%s\n", failures == 0 ? "OK" : "FAILED");
+
+    for (int i = 0; i < instance_count; ++i)
+    {
+        genesis_free(instances[i].genesis);
+        free(instances[i].hashes);
+    }
+    free(instances);
+    free(reference);
+
+    m68k_free_opcode_table();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Script to build and launch stress-test (see ../tools.sh)
+
+exec ../tools.sh stress-test 'ROM [INSTANCES] [FRAMES] [MOVIE]' "$@"
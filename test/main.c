@@ -1,19 +1,47 @@
 #include <GLFW/glfw3.h>
+#include <SDL.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <megado/desktop.h>
+#include <megado/emulation_thread.h>
 #include <megado/genesis.h>
+#include <megado/movie.h>
 #include <megado/psg.h>
 #include <megado/settings.h>
 #include <megado/ym2612.h>
-#include <megado/m68k/instruction.h>
 #include <megado/m68k/m68k.h>
 
-void run(Genesis* g, char* path)
+// Record the inputs into a movie until quitting, or play one back
+static bool start_movie(Genesis* g, const char* option, const char* path)
+{
+    bool ok = true;
+
+    emulation_thread_stop(g->emulation);
+
+    if (strcmp(option, "--record") == 0)
+        ok = movie_record(g->movie, g, true);
+    else if (strcmp(option, "--play") == 0)
+        ok = movie_load(g->movie, path) && movie_play(g->movie, g);
+    else {
+        printf("Unknown option %s\n", option);
+        ok = false;
+    }
+
+    emulation_thread_start(g->emulation);
+
+    return ok;
+}
+
+void run(Genesis* g, char* path, char* movie_option, char* movie_path)
 {
     genesis_load_rom_file(g, path);
 
+    if (movie_option != NULL && !start_movie(g, movie_option, movie_path))
+        return;
+
 // Enable debug windows on CI to catch more bugs
 #ifdef TRAVIS
     g->settings->vsync = true;
@@ -48,8 +76,9 @@ void run(Genesis* g, char* path)
     double start = glfwGetTime();
 #endif
 
-    while (g->status != Status_Quitting) {
-        genesis_update(g);
+    // The game runs on the emulation thread, this one only presents it
+    while (emulation_thread_view(g->emulation)->status != Status_Quitting) {
+        desktop_update(g);
 
 // Automatically exit after 5 minutes on continuous integration
 #ifdef TRAVIS
@@ -59,30 +88,39 @@ void run(Genesis* g, char* path)
         }
 #endif
     }
+
+    // The emulation thread is not restarted, the front-end is about to be freed
+    emulation_thread_stop(g->emulation);
+
+    if (g->movie->mode == MovieMode_Recording) {
+        movie_stop(g->movie);
+        movie_save(g->movie, movie_path);
+    }
 }
 
 int main(int argc, char **argv)
 {
-    // Generate the instruction table
-    opcode_table = calloc(0x10000, sizeof(Instruction*));
-    for (int opcode = 0; opcode < 0x10000; ++opcode)
-        opcode_table[opcode] = instruction_generate(opcode);
+    // Process-wide setup, shared by all the Genesis instances
+    SDL_Init(SDL_INIT_AUDIO);
+    m68k_generate_opcode_table();
 
-    Genesis* g = genesis_make();
+    Genesis* g = desktop_make();
 
     if (argc < 2) {
         printf("No ROM specified, using default\n");
-        run(g, "../browser/test.bin");
+        run(g, "../browser/test.bin", NULL, NULL);
+    }
+    else if (argc == 3) {
+        printf("Usage: megado-bin [ROM [--record|--play MOVIE]]\n");
     }
     else {
-        run(g, argv[1]);
+        run(g, argv[1], argc > 3 ? argv[2] : NULL, argc > 3 ? argv[3] : NULL);
     }
 
-    genesis_free(g);
+    desktop_free(g);
 
-    for (int opcode = 0; opcode < 0x10000; ++opcode)
-        instruction_free(opcode_table[opcode]);
-    free(opcode_table);
+    m68k_free_opcode_table();
+    SDL_Quit();
 
     return 0;
 }
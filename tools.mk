@@ -0,0 +1,66 @@
+# Makefile of the headless tools (stress-test/, regression/, etc)
+#
+# A tool's Makefile sets BIN and includes this file. The C files of the tool
+# are built into its BUILD_DIR, and linked against the core built by the
+# Makefile of this folder, with the same BUILD_DIR and flags: the static core
+# (`make core`) by default, or the shared library with LINK := shared.
+
+# Configurables
+CC := clang
+# Disable unused parameter warning since not everything is implemented yet
+CFLAGS := -std=gnu11 -Wall -Wextra -Wno-unused-parameter -Wno-unused-variable -Wno-unused-function
+BUILD_DIR := build
+LINK ?= core
+
+# For release and debug flags inserted by ./run.sh
+CFLAGS += $(USER_FLAGS)
+
+# The tools are one folder down
+ROOT := ..
+
+# Submodule dependencies
+INCLUDES := -I$(ROOT)/ -I$(ROOT)/deps/json-c/include/json-c\
+	    -D_REENTRANT -I$(ROOT)/deps/sdl2/install/include/SDL2
+LIBS := -lm -L$(ROOT)/deps/json-c/lib -ljson-c -L$(ROOT)/deps/sdl2/install/lib -lSDL2
+
+ifeq ($(LINK),shared)
+CORE := $(ROOT)/$(BUILD_DIR)/libmegado.so
+CORE_LIBS := -L$(ROOT)/$(BUILD_DIR) -lmegado
+else
+CORE := $(ROOT)/$(BUILD_DIR)/libmegado-core.a
+CORE_LIBS := $(CORE)
+endif
+
+#~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+SRC := $(wildcard *.c)
+# Put all objects into the build dir
+OBJ := $(SRC:%.c=$(BUILD_DIR)/%.o)
+# The .d files are generated by CC, used to rebuild objs whenever any dependency
+# changes
+DEP := $(OBJ:%.o=%.d)
+
+# Default target: the tool
+$(BUILD_DIR)/$(BIN): $(OBJ) $(CORE)
+# Create build directories on the way
+	@mkdir -p $(@D)
+	$(CC) $(OBJ) $(CFLAGS) $(CORE_LIBS) $(LIBS) -o $@
+
+# The Makefile of the root folder knows what the core depends on, ask it every time
+$(CORE): FORCE
+	$(MAKE) -C $(ROOT) BUILD_DIR=$(BUILD_DIR) USER_FLAGS="$(USER_FLAGS)" $(LINK)
+
+.PHONY: FORCE
+FORCE:
+
+# Include .d files built by the next rule
+-include $(DEP)
+
+$(BUILD_DIR)/%.o: %.c
+	@mkdir -p $(@D)
+# -MMD generates the .d dependencies on the go
+	$(CC) $< $(CFLAGS) $(INCLUDES) -MMD -c -o $@
+
+.PHONY: clean
+clean:
+	-rm --force $(BUILD_DIR)/$(BIN) $(OBJ) $(DEP)
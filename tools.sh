@@ -0,0 +1,67 @@
+#!/bin/sh
+
+# Script to build and launch one of the headless tools (see tools.mk) with the
+# dynamic libraries set up. Each tool's run.sh calls it from the tool's folder:
+#
+#   ../tools.sh TOOL USAGE [-gv -j NUM -f FLAGS -r RUNNER] debug|release|clean ARGS...
+#
+# where USAGE describes the tool's own ARGS.
+
+TOOL=$1
+USAGE=$2
+shift 2
+
+OPTIND=1 # Reset getopts (see https://stackoverflow.com/a/14203146 )
+
+# The core's shared library is built in the parent folder
+ENV='LD_LIBRARY_PATH=../deps/json-c/lib:../deps/sdl2/install/lib'
+
+DEBUG_DIR='build/debug'
+RELEASE_DIR='build/release'
+
+# Parse arguments
+JOBS=4
+RUNNER=
+FLAGS=
+
+while getopts "gvf:j:r:" opt; do
+    case "$opt" in
+        g) FLAGS="$FLAGS -g"
+           ;;
+        v) FLAGS="$FLAGS -DDEBUG"
+           ;;
+        f) FLAGS="$FLAGS $OPTARG"
+           ;;
+        j) JOBS=$OPTARG
+           ;;
+        r) RUNNER=$OPTARG
+           ;;
+    esac
+done
+
+shift $((OPTIND-1))
+
+# Parse command
+case $1 in
+    debug)
+        BUILD_DIR=$DEBUG_DIR
+        FLAGS="-g $FLAGS"
+        ;;
+    release)
+        BUILD_DIR=$RELEASE_DIR
+        FLAGS="-O3 -march=native $FLAGS"
+        ;;
+    clean)
+        make BUILD_DIR=$DEBUG_DIR clean
+        make BUILD_DIR=$RELEASE_DIR clean
+        exit 0
+        ;;
+    *)
+        echo "./run.sh [-gv -j NUM -f FLAGS -r RUNNER] debug|release|clean $USAGE"
+        exit 1
+        ;;
+esac
+shift
+
+make -j $JOBS BUILD_DIR="$BUILD_DIR" USER_FLAGS="$FLAGS" \
+    && env $ENV:../$BUILD_DIR $RUNNER $BUILD_DIR/$TOOL "$@"